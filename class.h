@@ -12,14 +12,21 @@ typedef int16_t I2;
 typedef int32_t I4;
 typedef int64_t I8;
 
-/* heap object structure */
+/* heap object header, followed by the elements of the object in the same block */
 typedef struct Heap {
-	struct Heap *prev, *next;
-	void  *obj;
-	int32_t nmemb;
-	size_t count;
+	int32_t nmemb;                  /* number of elements of an array */
+	U1      flags;                  /* state of the object for the garbage collector */
+	U1      mark;                   /* whether the object was reached by the collector */
+	U1      size;                   /* size of each element of an array */
+	struct ClassFile *class;        /* class of the object, NULL for arrays and strings */
 } Heap;
 
+/* size of an object header, rounded so that the elements following it are aligned */
+#define HEAP_HEADER     ((sizeof (Heap) + sizeof (int64_t) - 1) / sizeof (int64_t) * sizeof (int64_t))
+
+/* elements of object h */
+#define HEAP_DATA(h)    ((void *)((char *)(h) + HEAP_HEADER))
+
 /* local variable or operand structure */
 typedef union Value {
 	int32_t i;
@@ -29,6 +36,21 @@ typedef union Value {
 	Heap   *v;
 } Value;
 
+typedef struct Instr {
+	U2      op;                     /* instruction */
+	U2      u;                      /* index into local variables or constant pool */
+	I4      i;                      /* immediate operand or index of branch target */
+	Value   v;                      /* pre-decoded constant or switch key */
+	void   *p;                      /* resolved operand of a quickened instruction */
+} Instr;
+
+typedef struct Rinstr {
+	U2      op;                     /* register-based instruction */
+	U2      a, b, c;                /* registers: usually destination, then sources */
+	I4      i;                      /* immediate operand or index of branch target */
+	Instr  *ins;                    /* decoded instruction it was translated from */
+} Rinstr;
+
 typedef enum TypeCode {
 	T_BOOLEAN       = 4,
 	T_CHAR          = 5,
@@ -389,16 +411,19 @@ typedef struct CONSTANT_Double_info {
 
 typedef struct CONSTANT_Class_info {
 	U2      name_index;
+	struct ClassFile *class;        /* loaded class, set at the first resolution */
 } CONSTANT_Class_info;
 
 typedef struct CONSTANT_String_info {
 	U2      string_index;
 	char   *string;
+	struct Heap *obj;               /* string object, created at the first resolution */
 } CONSTANT_String_info;
 
 typedef struct CONSTANT_Fieldref_info {
 	U2      class_index;
 	U2      name_and_type_index;
+	union Value value;              /* value of a static field of a native class, set at the first resolution */
 } CONSTANT_Fieldref_info;
 
 typedef struct CONSTANT_Methodref_info {
@@ -434,6 +459,8 @@ typedef struct ConstantValue_attribute {
 	U2      constantvalue_index;
 } ConstantValue_attribute;
 
+struct Frame;
+
 typedef struct Code_attribute {
 	U2                      max_stack;
 	U2                      max_locals;
@@ -443,6 +470,13 @@ typedef struct Code_attribute {
 	struct Exception      **exception_table;
 	U2                      attributes_count;
 	struct Attribute      **attributes;
+	struct Instr           *instr;          /* decoded code, filled by the interpreter */
+	struct Rinstr          *rinstr;         /* register-based code, if translated */
+	U4                      ninstr;         /* number of decoded instructions */
+	U4                      ncalls;         /* number of calls, for finding hot methods */
+	int                     verified;       /* whether the decoded code was proven type-safe */
+	U1                     *refmap;         /* slots holding references at each instruction, if verified */
+	int                   (*jitcode)(struct Frame *);       /* machine code, if compiled */
 } Code_attribute;
 
 typedef struct Exceptions_attribute {
@@ -508,14 +542,26 @@ typedef struct Field {
 	U2                      descriptor_index;
 	U2                      attributes_count;
 	struct Attribute      **attributes;
+	U4                      offset;         /* offset of an instance field in the data of its object, or index of a static field in the statics of its class */
 } Field;
 
+/* method descriptor, parsed when the class is read */
+typedef struct Signature {
+	U2                      nargs;          /* number of arguments */
+	U2                      nslots;         /* local variable slots taken by the arguments, including this */
+	U1                     *args;           /* type of each argument (TYPE_INT, TYPE_ARRAY, etc) */
+	U1                      ret;            /* return type, TYPE_VOID for none */
+	U1                      nret;           /* operand stack slots taken by the return value */
+} Signature;
+
 typedef struct Method {
 	U2                      access_flags;
 	U2                      name_index;
 	U2                      descriptor_index;
 	U2                      attributes_count;
 	struct Attribute      **attributes;
+	struct Signature        sig;            /* parsed descriptor */
+	struct Code_attribute  *code;           /* code, NULL for native and abstract methods */
 } Method;
 
 typedef struct Exception {
@@ -563,9 +609,19 @@ typedef struct ClassFile {
 	struct Method    **methods;
 	U2                 attributes_count;
 	struct Attribute **attributes;
+	U2                *fieldhash;   /* hash index of fields, holding index + 1, 0 if empty */
+	U2                *methodhash;  /* hash index of methods, holding index + 1, 0 if empty */
+	U4                 fieldmask;   /* size of fieldhash minus 1 */
+	U4                 methodmask;  /* size of methodhash minus 1 */
+	U4                 instsize;    /* size in bytes of the instance fields, counting inherited ones */
+	U4                *refs;        /* offsets of the instance fields holding references */
+	U4                 nrefs;       /* number of offsets in refs */
+	union Value       *statics;     /* values of the static fields, those holding references first */
+	U2                 nstaticrefs; /* number of static fields holding references */
 } ClassFile;
 
 int class_getnoperands(U1 instruction);
+char *class_getmnemonic(U1 instruction);
 Attribute *class_getattr(Attribute **attrs, U2 count, AttributeTag tag);
 char *class_getutf8(ClassFile *class, U2 index);
 char *class_getclassname(ClassFile *class, U2 index);
@@ -575,6 +631,9 @@ float class_getfloat(ClassFile *class, U2 index);
 int64_t class_getlong(ClassFile *class, U2 index);
 double class_getdouble(ClassFile *class, U2 index);
 void class_getnameandtype(ClassFile *class, U2 index, char **name, char **type);
+U4 class_hash(const char *name, const char *descr);
 Method *class_getmethod(ClassFile *class, char *name, char *descr);
 Field *class_getfield(ClassFile *class, char *name, char *descr);
+Method *class_lookupmethod(ClassFile *class, char *name, char *descr, ClassFile **owner);
+Field *class_lookupfield(ClassFile *class, char *name, char *descr, ClassFile **owner);
 int class_istopclass(ClassFile *class);
@@ -330,13 +330,16 @@ readcp(FILE *fp, CP ***cp, U2 count)
 			break;
 		case CONSTANT_Class:
 			TRY(readu(fp, &(*cp)[i]->info.class_info.name_index, 2));
+			(*cp)[i]->info.class_info.class = NULL;
 			break;
 		case CONSTANT_String:
 			TRY(readu(fp, &(*cp)[i]->info.string_info.string_index, 2));
+			(*cp)[i]->info.string_info.obj = NULL;
 			break;
 		case CONSTANT_Fieldref:
 			TRY(readu(fp, &(*cp)[i]->info.fieldref_info.class_index, 2));
 			TRY(readu(fp, &(*cp)[i]->info.fieldref_info.name_and_type_index, 2));
+			(*cp)[i]->info.fieldref_info.value.v = NULL;
 			break;
 		case CONSTANT_Methodref:
 			TRY(readu(fp, &(*cp)[i]->info.methodref_info.class_index, 2));
@@ -780,10 +783,56 @@ error:
 	return -1;
 }
 
+/* skip field type in descriptor, return pointer to next character */
+static char *
+typeskip(char *s)
+{
+	while (*s == TYPE_ARRAY)
+		s++;
+	if (*s == TYPE_REFERENCE)
+		while (*s != TYPE_TERMINAL)
+			s++;
+	return s + 1;
+}
+
+/* parse the (already checked) descriptor of method into its signature */
+static int
+readsignature(Method *method, ClassFile *class)
+{
+	Signature *sig;
+	char *s, *descr;
+	U2 n;
+
+	sig = &method->sig;
+	descr = class_getutf8(class, method->descriptor_index);
+	sig->nargs = 0;
+	for (s = descr + 1; *s != ')'; s = typeskip(s))
+		sig->nargs++;
+	sig->args = NULL;
+	if (sig->nargs > 0)
+		TRY(fmalloc((void **)&sig->args, sig->nargs));
+	sig->nslots = (method->access_flags & ACC_STATIC) ? 0 : 1;
+	for (n = 0, s = descr + 1; *s != ')'; s = typeskip(s)) {
+		sig->args[n++] = *s;
+		sig->nslots += (*s == TYPE_LONG || *s == TYPE_DOUBLE) ? 2 : 1;
+	}
+	sig->ret = *++s;
+	if (sig->ret == TYPE_VOID)
+		sig->nret = 0;
+	else if (sig->ret == TYPE_LONG || sig->ret == TYPE_DOUBLE)
+		sig->nret = 2;
+	else
+		sig->nret = 1;
+	return 0;
+error:
+	return -1;
+}
+
 /* read methods into *p */
 static int
 readmethods(FILE *fp, Method ***p, ClassFile *class, U2 count)
 {
+	Attribute *cattr;
 	U2 i;
 
 	if (count == 0) {
@@ -798,12 +847,66 @@ readmethods(FILE *fp, Method ***p, ClassFile *class, U2 count)
 		TRY(readdescriptor(fp, &(*p)[i]->descriptor_index, class));
 		TRY(readu(fp, &(*p)[i]->attributes_count, 2));
 		TRY(readattributes(fp, &(*p)[i]->attributes, class, (*p)[i]->attributes_count));
+		TRY(readsignature((*p)[i], class));
+		if ((cattr = class_getattr((*p)[i]->attributes, (*p)[i]->attributes_count, Code)) != NULL)
+			(*p)[i]->code = &cattr->info.code;
 	}
 	return 0;
 error:
 	return -1;
 }
 
+/* allocate empty hash index for count members; set *mask to its size minus 1 */
+static int
+hashalloc(U2 **table, U4 *mask, U2 count)
+{
+	U4 size;
+
+	*table = NULL;
+	*mask = 0;
+	if (count == 0)
+		return 0;
+	for (size = 1; size < 2 * (U4)count; size <<= 1)
+		;
+	TRY(fcalloc((void **)table, size, sizeof **table));
+	*mask = size - 1;
+	return 0;
+error:
+	return -1;
+}
+
+/* insert member index into hash index, with linear probing */
+static void
+hashinsert(U2 *table, U4 mask, U4 hash, U2 index)
+{
+	U4 i;
+
+	for (i = hash & mask; table[i] != 0; i = (i + 1) & mask)
+		;
+	table[i] = index + 1;
+}
+
+/* build hash indices of the fields and methods of class, by name and descriptor */
+static int
+readhashes(ClassFile *class)
+{
+	U2 i;
+
+	TRY(hashalloc(&class->fieldhash, &class->fieldmask, class->fields_count));
+	for (i = 0; i < class->fields_count; i++)
+		hashinsert(class->fieldhash, class->fieldmask,
+		           class_hash(class_getutf8(class, class->fields[i]->name_index),
+		                      class_getutf8(class, class->fields[i]->descriptor_index)), i);
+	TRY(hashalloc(&class->methodhash, &class->methodmask, class->methods_count));
+	for (i = 0; i < class->methods_count; i++)
+		hashinsert(class->methodhash, class->methodmask,
+		           class_hash(class_getutf8(class, class->methods[i]->name_index),
+		                      class_getutf8(class, class->methods[i]->descriptor_index)), i);
+	return 0;
+error:
+	return -1;
+}
+
 /* free attribute */
 static void
 attributefree(Attribute **attr, U2 count)
@@ -822,6 +925,9 @@ attributefree(Attribute **attr, U2 count)
 			break;
 		case Code:
 			free(attr[i]->info.code.code);
+			free(attr[i]->info.code.instr);
+			free(attr[i]->info.code.rinstr);
+			free(attr[i]->info.code.refmap);
 			free(attr[i]->info.code.exception_table);
 			attributefree(attr[i]->info.code.attributes, attr[i]->info.code.attributes_count);
 			break;
@@ -881,10 +987,16 @@ file_free(ClassFile *class)
 			attributefree(class->fields[i]->attributes, class->fields[i]->attributes_count);
 	free(class->fields);
 	if (class->methods)
-		for (i = 0; i < class->methods_count; i++)
+		for (i = 0; i < class->methods_count; i++) {
 			attributefree(class->methods[i]->attributes, class->methods[i]->attributes_count);
+			free(class->methods[i]->sig.args);
+		}
 	free(class->methods);
 	attributefree(class->attributes, class->attributes_count);
+	free(class->fieldhash);
+	free(class->methodhash);
+	free(class->refs);
+	free(class->statics);
 }
 
 /* read class file */
@@ -901,6 +1013,13 @@ file_read(FILE *fp, ClassFile *class)
 	class->init = 0;
 	class->next = NULL;
 	class->super = NULL;
+	class->fieldhash = NULL;
+	class->methodhash = NULL;
+	class->instsize = 0;
+	class->refs = NULL;
+	class->nrefs = 0;
+	class->statics = NULL;
+	class->nstaticrefs = 0;
 	TRY(readu(fp, &class->minor_version, 2));
 	TRY(readu(fp, &class->major_version, 2));
 	TRY(readu(fp, &class->constant_pool_count, 2));
@@ -916,6 +1035,7 @@ file_read(FILE *fp, ClassFile *class)
 	TRY(readmethods(fp, &class->methods, class, class->methods_count));
 	TRY(readu(fp, &class->attributes_count, 2));
 	TRY(readattributes(fp, &class->attributes, class, class->attributes_count));
+	TRY(readhashes(class));
 	return ERR_NONE;
 error:
 	file_free(class);
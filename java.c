@@ -1,4 +1,6 @@
 #include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,6 +8,8 @@
 #ifdef _WIN32
 #include <direct.h>
 #else
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 #include "util.h"
@@ -30,31 +34,263 @@ enum {
 	RETURN_ERROR = 3
 };
 
+/* instructions that occur only in decoded code */
+enum {
+	LDC_STRING = CODE_LAST,         /* ldc of a string constant */
+	SWITCH_CASE,                    /* entry of the jump table of a switch */
+	INVOKESTATIC_QUICK,             /* invokestatic or invokespecial of a resolved method */
+	INVOKEVIRTUAL_QUICK,            /* invokevirtual of a resolved method */
+	INVOKESTATIC_NATIVE,            /* invokestatic or invokespecial of a native method */
+	INVOKEVIRTUAL_NATIVE,           /* invokevirtual of a native method */
+	NEW_QUICK,                      /* new of a resolved class */
+	GETFIELD_BYTE,                  /* getfield of a byte or boolean at a resolved offset */
+	GETFIELD_CHAR,                  /* getfield of a char at a resolved offset */
+	GETFIELD_SHORT,                 /* getfield of a short at a resolved offset */
+	GETFIELD_INT,                   /* getfield of an int or float at a resolved offset */
+	GETFIELD_LONG,                  /* getfield of a long or double at a resolved offset */
+	GETFIELD_REF,                   /* getfield of a reference at a resolved offset */
+	PUTFIELD_BYTE,                  /* putfield of a byte or boolean at a resolved offset */
+	PUTFIELD_SHORT,                 /* putfield of a char or short at a resolved offset */
+	PUTFIELD_INT,                   /* putfield of an int or float at a resolved offset */
+	PUTFIELD_LONG,                  /* putfield of a long or double at a resolved offset */
+	PUTFIELD_REF,                   /* putfield of a reference at a resolved offset */
+	GETSTATIC_QUICK,                /* getstatic of a one-slot value at a resolved address */
+	GETSTATIC_WIDE,                 /* getstatic of a long or double at a resolved address */
+	PUTSTATIC_QUICK,                /* putstatic of a one-slot value at a resolved address */
+	PUTSTATIC_WIDE,                 /* putstatic of a long or double at a resolved address */
+
+	/* superinstructions */
+	ILOAD_ILOAD,
+	ILOAD_ILOAD_IADD_ISTORE,
+	ILOAD_BIPUSH_IF_ICMPLT,
+	ILOAD_BIPUSH_IF_ICMPGE,
+	ILOAD_ILOAD_IF_ICMPLT,
+	ILOAD_ILOAD_IF_ICMPGE,
+	ALOAD_ILOAD_IALOAD,
+	IINC_GOTO,
+
+	INSTR_LAST
+};
+
+#define VMSTACK         (1 << 20)       /* default size in bytes of the frame stack */
+#define VMHEAP          ((size_t)1 << 30)       /* default maximum size in bytes of the heap */
+#define VMNURSERY       ((size_t)1 << 19)       /* default size in bytes of the young generation */
+#define CLASSTAB        64      /* initial size of the hash table of loaded classes */
+#define NCACHE  4               /* receiver classes in a polymorphic inline cache */
+#define JITTHRESHOLD    1000    /* calls after which a method is compiled */
+#define JITCACHE        (4 << 20)       /* size in bytes of the cache of compiled code */
+#define TRACETHRESHOLD  500     /* times a backward branch is taken before its loop is recorded */
+#define TRACETRIES      4       /* recordings of a loop before giving up on it */
+#define TRACEMAX        1024    /* instructions in a recorded trace */
+
+/* field of the given type at offset off of instance h */
+#define FIELD(type, h, off)     (*(type *)((char *)HEAP_DATA(h) + (off)))
+
+/* types of values tracked by the verifier */
+enum {
+	VT_TOP = 0,                     /* unusable value */
+	VT_INT,
+	VT_FLOAT,
+	VT_LONG,
+	VT_DOUBLE,
+	VT_REF,
+	VT_HIGH,                        /* second slot of a long or double */
+};
+
+/* instructions of the register-based code */
+enum {
+	R_MOVE = 0, R_ICONST, R_LCONST, R_FCONST, R_DCONST, R_LDC, R_NULL,
+	R_IADD, R_LADD, R_FADD, R_DADD, R_ISUB, R_LSUB, R_FSUB, R_DSUB,
+	R_IMUL, R_LMUL, R_FMUL, R_DMUL, R_IDIV, R_LDIV, R_FDIV, R_DDIV,
+	R_IREM, R_LREM, R_FREM, R_DREM, R_INEG, R_LNEG, R_FNEG, R_DNEG,
+	R_ISHL, R_LSHL, R_ISHR, R_LSHR, R_IUSHR, R_LUSHR, R_IAND, R_LAND,
+	R_IOR, R_LOR, R_IXOR, R_LXOR, R_IINC, R_I2L, R_I2F, R_I2D, R_L2I,
+	R_L2F, R_L2D, R_F2I, R_F2L, R_F2D, R_D2I, R_D2L, R_D2F, R_I2B, R_I2C,
+	R_I2S, R_LCMP, R_FCMPL, R_FCMPG, R_DCMPL, R_DCMPG, R_IFEQ, R_IFNE,
+	R_IFLT, R_IFGE, R_IFGT, R_IFLE, R_IF_ICMPEQ, R_IF_ICMPNE,
+	R_IF_ICMPLT, R_IF_ICMPGE, R_IF_ICMPGT, R_IF_ICMPLE, R_IF_ACMPEQ,
+	R_IF_ACMPNE, R_IFNULL, R_IFNONNULL, R_GOTO, R_TABLESWITCH,
+	R_LOOKUPSWITCH, R_CASE, R_IALOAD, R_LALOAD, R_FALOAD, R_DALOAD,
+	R_AALOAD, R_IASTORE, R_LASTORE, R_FASTORE, R_DASTORE, R_AASTORE,
+	R_ARRAYLENGTH, R_CALL, R_RETURN, R_RETURN1, R_RETURN2,
+	R_LAST
+};
+
+/* method resolved by the first execution of an invoke instruction */
+typedef struct Callsite {
+	struct Callsite *next;
+	ClassFile      *class;          /* class declaring the method */
+	Code_attribute *code;           /* code of the method, if not native */
+	NativeMethod   *native;         /* native function, if native */
+	char           *name;           /* method name */
+	char           *descriptor;     /* method descriptor */
+	U2              nargs;          /* operand stack slots taken by the arguments */
+	U2              nret;           /* operand stack slots taken by the return value */
+
+	/* inline cache of invokevirtual */
+	struct {
+		ClassFile      *receiver;       /* class of the receiver */
+		ClassFile      *class;          /* class declaring the selected method */
+		Code_attribute *code;           /* code of the selected method */
+	} cache[NCACHE];
+	U2              ncache;         /* entries in use, NCACHE + 1 once megamorphic */
+	unsigned long   hits;           /* calls whose receiver class was in the cache */
+	unsigned long   misses;         /* calls that needed a method lookup */
+	ClassFile      *caller;         /* class containing the call site */
+	Code_attribute *callercode;     /* code containing the call site */
+	U4              callerpc;       /* instruction index of the call site */
+} Callsite;
+
+/* entry of the hash table of loaded classes */
+typedef struct Classentry {
+	struct Classentry *next;
+	char           *name;           /* interned name, the class' own this_class string */
+	U4              hash;
+	ClassFile      *class;
+} Classentry;
+
+/* loop closed by a backward branch, recorded and compiled once it gets hot */
+typedef struct Trace {
+	struct Trace   *next;
+	U4              head;           /* instruction index of the loop header */
+	U4              count;          /* times the backward branch was taken */
+	int           (*jitcode)(Frame *);      /* compiled trace, if any */
+} Trace;
+
+/* instruction run while recording a trace */
+typedef struct Traceentry {
+	Instr          *ins;
+	int             inlined;        /* whether it was run by a method called from the loop */
+	ClassFile      *receiver;       /* class of the receiver of an invokevirtual */
+} Traceentry;
+
 int methodcall(ClassFile *class, Frame *frame, char *name, char *descr, U2 flags);
+static void codecount(Code_attribute *code);
+static int coderun(ClassFile *class, Frame *frame, Code_attribute *code, U2 nargs, U2 nret);
+static int codecall(ClassFile *class, Frame *frame, Code_attribute *code, U2 nargs, U2 nret);
+static void classdecode(ClassFile *class);
+static ClassFile *classresolve(ClassFile *class, U2 index);
+static Value resolveconstant(ClassFile *class, U2 index);
+static void tracecompile(Trace *trace, Frame *frame, Traceentry *entries, size_t n);
 
 static char **classpath = NULL;         /* NULL-terminated array of path strings */
 static ClassFile *classes = NULL;       /* list of loaded classes */
+static struct {
+	Classentry    **tab;            /* buckets, chained through Classentry.next */
+	U4              size;           /* number of buckets, a power of two */
+	U4              n;              /* number of entries */
+} dictionary;
+static Callsite *callsites = NULL;      /* list of resolved call sites */
+static Trace *traces = NULL;            /* list of loops whose backward branch was taken */
+static struct {
+	Trace          *trace;          /* loop being recorded, NULL if none */
+	Frame          *frame;          /* frame of the method containing the loop */
+	Traceentry     *entries;        /* instructions run since the loop header */
+	size_t          n;
+} recorder;
+static int icstats = 0;                 /* whether to report inline cache statistics */
+static unsigned long (*oppairs)[CODE_LAST] = NULL;      /* histogram of instruction pairs */
+static int regtier = 0;                 /* whether to run methods as register-based code */
+static int tos = 0;                     /* whether to cache the top of the operand stack */
+static int interponly = 0;              /* whether to interpret every method, never compiling it */
+static size_t stacksize = VMSTACK;      /* size in bytes of the frame stack */
+static size_t heapsize = VMHEAP;        /* maximum size in bytes of the heap */
+static size_t nurserysize = VMNURSERY;  /* size in bytes of the young generation */
+static int gcmode = GC_SERIAL;          /* how the old generation is marked */
+static int gcthreads = 0;               /* number of marker threads, 0 for one per processor */
+static int compressedrefs = 0;          /* whether references in the heap are compressed */
 
 /* show usage */
 static void
 usage(void)
 {
-	(void)fprintf(stderr, "usage: java [-cp classpath] class\n");
+	(void)fprintf(stderr, "usage: java [-Xcompressedrefs] [-Xconcurrentgc] [-Xgcthreadsn] [-Xicstats] [-Xint] [-Xmnsize] [-Xmxsize] [-Xoppairs] [-Xparallelgc] [-Xreg] [-Xsssize] [-Xtos] [-cp classpath] class\n");
 	exit(EXIT_FAILURE);
 }
 
+/* hash class name (FNV-1a) */
+static U4
+namehash(char *name)
+{
+	U4 h;
+
+	h = 2166136261u;
+	for (; *name != '\0'; name++)
+		h = (h ^ (U1)*name) * 16777619u;
+	return h;
+}
+
+/* parse size in bytes with optional k, m or g suffix; return 0 on error */
+static size_t
+getsize(char *s)
+{
+	unsigned long n;
+	char *ep;
+
+	n = strtoul(s, &ep, 10);
+	switch (*ep) {
+	case 'g': case 'G':
+		n <<= 10;
+		/* FALLTHROUGH */
+	case 'm': case 'M':
+		n <<= 10;
+		/* FALLTHROUGH */
+	case 'k': case 'K':
+		n <<= 10;
+		ep++;
+		break;
+	}
+	if (ep == s || *ep != '\0')
+		return 0;
+	return n;
+}
+
 /* check if a class with the given name is loaded */
 static ClassFile *
 getclass(char *classname)
 {
-	ClassFile *class;
+	Classentry *entry;
+	U4 h;
 
-	for (class = classes; class; class = class->next)
-		if (strcmp(classname, class_getclassname(class, class->this_class)) == 0)
-			return class;
+	if (dictionary.tab == NULL)
+		return NULL;
+	h = namehash(classname);
+	for (entry = dictionary.tab[h & (dictionary.size - 1)]; entry != NULL; entry = entry->next)
+		if (entry->hash == h && strcmp(classname, entry->name) == 0)
+			return entry->class;
 	return NULL;
 }
 
+/* add class to the hash table of loaded classes, growing it when too full */
+static void
+classadd(ClassFile *class)
+{
+	Classentry *entry, *next, **tab;
+	U4 i, size;
+
+	if (dictionary.n >= dictionary.size / 4 * 3) {
+		size = dictionary.size == 0 ? CLASSTAB : dictionary.size * 2;
+		tab = ecalloc(size, sizeof *tab);
+		for (i = 0; i < dictionary.size; i++) {
+			for (entry = dictionary.tab[i]; entry != NULL; entry = next) {
+				next = entry->next;
+				entry->next = tab[entry->hash & (size - 1)];
+				tab[entry->hash & (size - 1)] = entry;
+			}
+		}
+		free(dictionary.tab);
+		dictionary.tab = tab;
+		dictionary.size = size;
+	}
+	entry = emalloc(sizeof *entry);
+	entry->name = class_getclassname(class, class->this_class);
+	entry->hash = namehash(entry->name);
+	entry->class = class;
+	entry->next = dictionary.tab[entry->hash & (dictionary.size - 1)];
+	dictionary.tab[entry->hash & (dictionary.size - 1)] = entry;
+	dictionary.n++;
+}
+
 /* break cpath into paths and set classpath global variable */
 static void
 setclasspath(char *cpath)
@@ -83,30 +319,152 @@ static void
 classfree(void)
 {
 	ClassFile *tmp;
-
+	Callsite *site;
+	Trace *trace;
+	Classentry *entry;
+	U4 i;
+
+	for (i = 0; i < dictionary.size; i++) {
+		while ((entry = dictionary.tab[i]) != NULL) {
+			dictionary.tab[i] = entry->next;
+			free(entry);
+		}
+	}
+	free(dictionary.tab);
+	dictionary.tab = NULL;
+	dictionary.size = dictionary.n = 0;
 	while (classes) {
 		tmp = classes;
 		classes = classes->next;
 		file_free(tmp);
 		free(tmp);
 	}
+	while (callsites) {
+		site = callsites;
+		callsites = callsites->next;
+		free(site);
+	}
+	while (traces) {
+		trace = traces;
+		traces = traces->next;
+		free(trace);
+	}
+	free(recorder.entries);
 }
 
-/* initialize class */
+/* initialize class, setting the static fields with a constant value before running its initialization method */
 static void
 classinit(ClassFile *class)
 {
 	Method *method;
+	Field *field;
+	Attribute *attr;
+	U2 i;
 
 	if (class->init)
 		return;
 	class->init = 1;
 	if (class->super)
 		classinit(class->super);
+	for (i = 0; i < class->fields_count; i++) {
+		field = class->fields[i];
+		if ((field->access_flags & ACC_STATIC) &&
+		    (attr = class_getattr(field->attributes, field->attributes_count, ConstantValue)) != NULL) {
+			class->statics[field->offset] = resolveconstant(class, attr->info.constantvalue.constantvalue_index);
+		}
+	}
 	if ((method = class_getmethod(class, "<clinit>", "()V")) != NULL)
 	(void)methodcall(class, NULL, "<clinit>", "()V", (class->major_version >= 51 ? ACC_STATIC : ACC_NONE));
 }
 
+/* get size in bytes of a field of type descriptor type */
+static U4
+fieldsize(char *type)
+{
+	switch (*type) {
+	case TYPE_BYTE:
+	case TYPE_BOOLEAN:
+		return 1;
+	case TYPE_CHAR:
+	case TYPE_SHORT:
+		return 2;
+	case TYPE_INT:
+	case TYPE_FLOAT:
+		return 4;
+	case TYPE_LONG:
+	case TYPE_DOUBLE:
+		return 8;
+	default:
+		return HEAP_REFSIZE;
+	}
+}
+
+/*
+ * Lay out the instance fields of class after those of its superclass,
+ * the widest first, each aligned to its own size, so that padding is
+ * only needed before the first of them; and list the offsets of the
+ * fields holding references, inherited ones included, for the garbage
+ * collector.  Allocate a value for each static field of class, zeroed
+ * until the class is initialized; those holding references come first,
+ * for the garbage collector to find them.
+ */
+static void
+classlayout(ClassFile *class)
+{
+	Field *field;
+	char *type;
+	U4 offset, size, n;
+	U2 i, nstatics, nrefs;
+
+	offset = 0;
+	n = 0;
+	if (class->super != NULL) {
+		offset = class->super->instsize;
+		n = class->super->nrefs;
+	}
+	nstatics = 0;
+	for (i = 0; i < class->fields_count; i++) {
+		type = class_getutf8(class, class->fields[i]->descriptor_index);
+		if (class->fields[i]->access_flags & ACC_STATIC) {
+			nstatics++;
+			if (*type == TYPE_REFERENCE || *type == TYPE_ARRAY)
+				class->nstaticrefs++;
+		} else if (*type == TYPE_REFERENCE || *type == TYPE_ARRAY) {
+			n++;
+		}
+	}
+	if (nstatics > 0)
+		class->statics = ecalloc(nstatics, sizeof *class->statics);
+	nrefs = 0;
+	nstatics = class->nstaticrefs;
+	for (i = 0; i < class->fields_count; i++) {
+		field = class->fields[i];
+		type = class_getutf8(class, field->descriptor_index);
+		if (field->access_flags & ACC_STATIC)
+			field->offset = (*type == TYPE_REFERENCE || *type == TYPE_ARRAY) ? nrefs++ : nstatics++;
+	}
+	if (n > 0)
+		class->refs = ecalloc(n, sizeof *class->refs);
+	if (class->super != NULL && class->super->nrefs > 0)
+		memcpy(class->refs, class->super->refs, class->super->nrefs * sizeof *class->refs);
+	class->nrefs = (class->super != NULL) ? class->super->nrefs : 0;
+	for (size = sizeof (int64_t); size > 0; size /= 2) {
+		for (i = 0; i < class->fields_count; i++) {
+			field = class->fields[i];
+			type = class_getutf8(class, field->descriptor_index);
+			if ((field->access_flags & ACC_STATIC) || fieldsize(type) != size)
+				continue;
+			offset = (offset + size - 1) / size * size;
+			field->offset = offset;
+			offset += size;
+			if (*type == TYPE_REFERENCE || *type == TYPE_ARRAY) {
+				class->refs[class->nrefs++] = field->offset;
+			}
+		}
+	}
+	class->instsize = offset;
+}
+
 /* recursivelly load class and its superclasses from file matching class name */
 static ClassFile *
 classload(char *classname)
@@ -154,25 +512,53 @@ classload(char *classname)
 	class->next = classes;
 	class->super = NULL;
 	classes = class;
+	classadd(class);
 	if (!class_istopclass(class)) {
-		class->super = classload(class_getclassname(class, class->super_class));
+		class->super = classresolve(class, class->super_class);
 		for (tmp = class->super; tmp; tmp = tmp->super) {
-			if (strcmp(class_getclassname(class, class->this_class),
-			           class_getclassname(tmp, tmp->this_class)) == 0) {
+			if (tmp == class) {
 				errx(EXIT_FAILURE, "class circularity error");
 			}
 		}
 	}
+	classlayout(class);
+	classdecode(class);
 	classinit(class);
 	return class;
 }
 
+/* get class referred to by the CONSTANT_Class entry at index, loading it only at the first call */
+static ClassFile *
+classresolve(ClassFile *class, U2 index)
+{
+	CONSTANT_Class_info *info;
+
+	info = &class->constant_pool[index]->info.class_info;
+	if (info->class == NULL)
+		info->class = classload(class_getclassname(class, index));
+	return info->class;
+}
+
+/* get the object of a string constant, creating it at the first call */
+static Heap *
+stringobject(CONSTANT_String_info *info)
+{
+	size_t n;
+
+	if (info->obj == NULL) {
+		n = strlen(info->string) + 1;
+		if ((info->obj = heap_allocold(n, 1)) == NULL)
+			errx(EXIT_FAILURE, "out of memory");
+		memcpy(HEAP_DATA(info->obj), info->string, n);
+	}
+	return info->obj;
+}
+
 /* resolve constant reference */
 static Value
 resolveconstant(ClassFile *class, U2 index)
 {
 	Value v;
-	char *s;
 
 	v.i = 0;
 	switch (class->constant_pool[index]->tag) {
@@ -189,2603 +575,5307 @@ resolveconstant(ClassFile *class, U2 index)
 		v.d = class_getdouble(class, index);
 		break;
 	case CONSTANT_String:
-		s = class_getstring(class, index);
-		v.v = heap_alloc(0, 0);
-		v.v->obj = s;
+		v.v = stringobject(&class->constant_pool[index]->info.string_info);
 		break;
 	}
 	return v;
 }
 
-/* resolve field reference */
-static CP *
-resolvefield(ClassFile *class, CONSTANT_Fieldref_info *fieldref, Heap **p)
-{
-	Field *field;
-	enum JavaClass jclass;
-	U2 index, i;
-	char *classname, *name, *type;
+/* fetch big-endian operands from the instruction stream */
+#define I1OPERAND(p)    ((int8_t)(p)[0])
+#define U2OPERAND(p)    ((U2)((p)[0] << 8 | (p)[1]))
+#define I2OPERAND(p)    ((int16_t)U2OPERAND(p))
+#define I4OPERAND(p)    ((int32_t)((U4)(p)[0] << 24 | (U4)(p)[1] << 16 | (U4)(p)[2] << 8 | (U4)(p)[3]))
 
-	if (p != NULL)
-		*p = NULL;
-	classname = class_getclassname(class, fieldref->class_index);
-	class_getnameandtype(class, fieldref->name_and_type_index, &name, &type);
-	if ((jclass = native_javaclass(classname)) != NONE_CLASS) {
-		if (p != NULL) {
-			(*p) = heap_alloc(0, 0);
-			((Heap *)*p)->obj = native_javaobj(jclass, name, type);
+/* get number of local variable slots taken by the arguments in a method descriptor */
+static U2
+argslots(char *descriptor)
+{
+	char *s;
+	U2 n;
+
+	n = 0;
+	for (s = descriptor + 1; *s && *s != ')'; s++) {
+		switch (*s) {
+		case TYPE_DOUBLE:
+		case TYPE_LONG:
+			n += 2;
+			break;
+		case TYPE_ARRAY:
+			while (*s == TYPE_ARRAY)
+				s++;
+			if (*s == TYPE_REFERENCE)
+				while (*s && *s != TYPE_TERMINAL)
+					s++;
+			n++;
+			break;
+		case TYPE_REFERENCE:
+			while (*s && *s != TYPE_TERMINAL)
+				s++;
+			n++;
+			break;
+		default:
+			n++;
+			break;
 		}
-		return NULL;
-	} else if ((class = classload(classname)) &&
-	           (field = class_getfield(class, name, type))) {
-		index = 0;
-		for (i = 0; i < field->attributes_count; i++) {
-			if (field->attributes[i]->tag == ConstantValue) {
-				index = field->attributes[i]->info.constantvalue.constantvalue_index;
+	}
+	return n;
+}
+
+/* get number of jump table entries of the instruction at the given offset of the bytecode */
+static U4
+codecases(Code_attribute *code, U4 pc)
+{
+	I8 n;
+	U4 base;
+
+	base = (pc + 4) & ~3u;
+	switch (code->code[pc]) {
+	case TABLESWITCH:
+		if ((U8)base + 12 > code->code_length)
+			errx(EXIT_FAILURE, "invalid code");
+		n = (I8)I4OPERAND(code->code + base + 8) - I4OPERAND(code->code + base + 4) + 1;
+		if (n < 1)
+			errx(EXIT_FAILURE, "invalid code");
+		break;
+	case LOOKUPSWITCH:
+		if ((U8)base + 8 > code->code_length)
+			errx(EXIT_FAILURE, "invalid code");
+		n = I4OPERAND(code->code + base + 4);
+		if (n < 0)
+			errx(EXIT_FAILURE, "invalid code");
+		break;
+	default:
+		return 0;
+	}
+	if (n > UINT16_MAX)
+		errx(EXIT_FAILURE, "invalid code");
+	return n;
+}
+
+/* get size in bytes of the instruction at the given offset of the bytecode, which must fit in it */
+static U4
+codesize(Code_attribute *code, U4 pc)
+{
+	U8 size;
+	U4 base;
+
+	base = (pc + 4) & ~3u;
+	switch (code->code[pc]) {
+	case TABLESWITCH:
+		size = base - pc + 12 + 4 * (U8)codecases(code, pc);
+		break;
+	case LOOKUPSWITCH:
+		size = base - pc + 8 + 8 * (U8)codecases(code, pc);
+		break;
+	case WIDE:
+		if (pc + 1 >= code->code_length)
+			errx(EXIT_FAILURE, "invalid code");
+		size = (code->code[pc + 1] == IINC) ? 6 : 4;
+		break;
+	default:
+		size = 1 + class_getnoperands(code->code[pc]);
+		break;
+	}
+	if (pc + size > code->code_length)
+		errx(EXIT_FAILURE, "invalid code");
+	return size;
+}
+
+/* get index of the decoded instruction at the given offset of the bytecode */
+static I4
+codetarget(I4 *map, Code_attribute *code, I8 pc)
+{
+	if (pc < 0 || pc >= code->code_length || map[pc] < 0)
+		errx(EXIT_FAILURE, "invalid branch target");
+	return map[pc];
+}
+
+/*
+ * Superinstructions, each standing for a sequence of instructions.
+ * The sequences were chosen from the most frequent instruction pairs
+ * reported by the -Xoppairs option on loop-heavy programs; to tune
+ * the set for another workload, run it with -Xoppairs and edit this
+ * table along with the enum of instructions and the handlers in
+ * interpret().  Sequences are matched against the general form of
+ * each instruction (see opfold()), longest sequences first.
+ */
+static struct {
+	U2 op;                          /* superinstruction */
+	U2 len;                         /* length of the sequence */
+	U2 seq[4];                      /* sequence of instructions it replaces */
+} superinstrtab[] = {
+	{ILOAD_ILOAD_IADD_ISTORE, 4, {ILOAD, ILOAD, IADD, ISTORE}},
+	{ILOAD_BIPUSH_IF_ICMPLT,  3, {ILOAD, BIPUSH, IF_ICMPLT}},
+	{ILOAD_BIPUSH_IF_ICMPGE,  3, {ILOAD, BIPUSH, IF_ICMPGE}},
+	{ILOAD_ILOAD_IF_ICMPLT,   3, {ILOAD, ILOAD, IF_ICMPLT}},
+	{ILOAD_ILOAD_IF_ICMPGE,   3, {ILOAD, ILOAD, IF_ICMPGE}},
+	{ALOAD_ILOAD_IALOAD,      3, {ALOAD, ILOAD, IALOAD}},
+	{IINC_GOTO,               2, {IINC, GOTO}},
+	{ILOAD_ILOAD,             2, {ILOAD, ILOAD}},
+};
+
+/* get number of instructions run by an instruction, more than one for a superinstruction */
+static U2
+oplength(U2 op)
+{
+	size_t k;
+
+	for (k = 0; k < LEN(superinstrtab); k++)
+		if (superinstrtab[k].op == op)
+			return superinstrtab[k].len;
+	return 1;
+}
+
+/* get general form of an instruction, folding its short forms, internal variants and superinstructions */
+static U2
+opfold(U2 op)
+{
+	size_t k;
+
+	switch (op) {
+	case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2:
+	case ICONST_3: case ICONST_4: case ICONST_5: case SIPUSH:
+		return BIPUSH;
+	case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+	case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+	case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+	case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+	case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+		return ILOAD + (op - ILOAD_0) / 4;
+	case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+	case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+	case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+	case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+	case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+		return ISTORE + (op - ISTORE_0) / 4;
+	case LDC_STRING:
+		return LDC;
+	case INVOKESTATIC_QUICK:
+	case INVOKESTATIC_NATIVE:
+		return INVOKESTATIC;
+	case INVOKEVIRTUAL_QUICK:
+	case INVOKEVIRTUAL_NATIVE:
+		return INVOKEVIRTUAL;
+	case NEW_QUICK:
+		return NEW;
+	case GETFIELD_BYTE: case GETFIELD_CHAR: case GETFIELD_SHORT:
+	case GETFIELD_INT: case GETFIELD_LONG: case GETFIELD_REF:
+		return GETFIELD;
+	case PUTFIELD_BYTE: case PUTFIELD_SHORT: case PUTFIELD_INT:
+	case PUTFIELD_LONG: case PUTFIELD_REF:
+		return PUTFIELD;
+	case GETSTATIC_QUICK: case GETSTATIC_WIDE:
+		return GETSTATIC;
+	case PUTSTATIC_QUICK: case PUTSTATIC_WIDE:
+		return PUTSTATIC;
+	default:
+		/* a superinstruction keeps the operands of the first instruction of its sequence */
+		for (k = 0; k < LEN(superinstrtab); k++)
+			if (superinstrtab[k].op == op)
+				return superinstrtab[k].seq[0];
+		return op;
+	}
+}
+
+/*
+ * Replace the first instruction of each sequence that has a
+ * superinstruction.  The other instructions of the sequence are left
+ * in place, both as operands of the superinstruction and as targets of
+ * branches into the middle of the sequence.
+ */
+static void
+codefuse(Instr *instr, U4 n)
+{
+	size_t k;
+	U4 pc;
+	U2 j;
+
+	for (pc = 0; pc < n; pc++) {
+		for (k = 0; k < LEN(superinstrtab); k++) {
+			if (pc + superinstrtab[k].len > n)
+				continue;
+			for (j = 0; j < superinstrtab[k].len; j++)
+				if (opfold(instr[pc + j].op) != superinstrtab[k].seq[j])
+					break;
+			if (j == superinstrtab[k].len) {
+				instr[pc].op = superinstrtab[k].op;
 				break;
 			}
 		}
-		if (index != 0) {
-			return class->constant_pool[index];
-		}
 	}
-	errx(EXIT_FAILURE, "could not resolve field");
-	return NULL;
 }
 
-/* aconst_null: push null */
+/* check whether instruction branches to the instruction in its operand */
 static int
-opaconst_null(Frame *frame)
+isbranch(U2 op)
 {
-	Value v;
-
-	v.v = heap_alloc(0, 0);
-	v.v->obj = NULL;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	return (op >= IFEQ && op <= JSR) || op == IFNULL || op == IFNONNULL;
 }
 
-/* aaload: load reference from array */
+/* get operand stack slots taken by a value of the given type */
 static int
-opaaload(Frame *frame)
+typeslots(char *type)
 {
-	Value va, vi, v;
-
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
+	switch (*type) {
+	case TYPE_VOID:
+		return 0;
+	case TYPE_LONG:
+	case TYPE_DOUBLE:
+		return 2;
+	default:
+		return 1;
 	}
-	v.v = ((void **)va.v->obj)[vi.i];
-	frame_stackpush(frame, v);
-	return NO_RETURN;
 }
 
-/* aastore: store into reference array */
-static int
-opaastore(Frame *frame)
+/*
+ * Translate the decoded code of a method into register-based code, in
+ * which each instruction names the registers it reads and writes.  The
+ * registers are the local variables followed by the operand stack
+ * slots, which the frame lays out contiguously.
+ *
+ * A load of a local variable produces no instruction; the stack slot
+ * it pushes is recorded as an alias of the variable, and the
+ * instruction consuming the slot reads the variable directly.  A store
+ * into a local variable is folded into the instruction that computed
+ * the value, when that is the previous instruction.  Aliases are
+ * materialized into their stack slots before branches, at branch
+ * targets, and before calls into the stack-based handlers, which get
+ * the operand stack as they expect it.
+ *
+ * Return -1 if the method uses an instruction with no register-based
+ * form or a stack layout this translation does not follow; the method
+ * is then run by the stack-based interpreter.
+ */
+static int
+regdecode(ClassFile *class, Code_attribute *code, U4 n)
 {
-	Value va, vi, vv;
+	CONSTANT_Methodref_info *methodref;
+	CONSTANT_Fieldref_info *fieldref;
+	Rinstr *rcode, *r;
+	Instr *ins;
+	I4 *depth, *rmap;
+	U2 *sym;
+	U1 *target;
+	U4 pc, j, nr;
+	I4 d, lastdef, pop, push;
+	char *name, *type;
+	int fallthrough, ret;
+
+#define S(k)            ((U2)(code->max_locals + (k)))
+#define EMIT(o, x, y, z, imm) \
+	(r = &rcode[nr++], r->op = (o), r->a = (x), r->b = (y), r->c = (z), r->i = (imm), r->ins = ins)
+#define NEED(k)         do { if (d < (k)) goto done; } while (0)
+#define JUMP(t)         do { if (depth[t] < 0) depth[t] = d; else if (depth[t] != d) goto done; } while (0)
+#define MATERIALIZE(k) \
+	for (j = 0; j < (U4)(k); j++) \
+		if (sym[j] != S(j)) { EMIT(R_MOVE, S(j), sym[j], 0, 0); sym[j] = S(j); }
+#define UNALIAS(v) \
+	for (j = 0; j < (U4)d; j++) \
+		if (sym[j] == (v)) { EMIT(R_MOVE, S(j), sym[j], 0, 0); sym[j] = S(j); }
+#define DEF(o, in, out, c) \
+	do { NEED(in); d -= (in); EMIT((o), S(d), sym[d], (c), 0); \
+	     sym[d] = S(d); sym[d + 1] = S(d + 1); lastdef = nr - 1; d += (out); } while (0)
+#define BIN(o, in, out)         DEF(o, in, out, sym[d + (in) / 2])
+#define UN(o, in, out)          DEF(o, in, out, 0)
+#define CONST(o, out, imm) \
+	do { EMIT((o), S(d), 0, 0, (imm)); sym[d] = S(d); sym[d + 1] = S(d + 1); \
+	     lastdef = nr - 1; d += (out); } while (0)
+#define LOADLOCAL(out) \
+	do { if (ins->u >= code->max_locals) goto done; \
+	     sym[d] = ins->u; sym[d + 1] = S(d + 1); d += (out); } while (0)
+#define STORELOCAL(in) \
+	do { NEED(in); d -= (in); if (ins->u >= code->max_locals) goto done; UNALIAS(ins->u); \
+	     if (sym[d] == S(d) && lastdef >= 0 && (U4)lastdef == nr - 1 && rcode[lastdef].a == S(d)) \
+	             rcode[lastdef].a = ins->u; \
+	     else if (sym[d] != ins->u) \
+	             EMIT(R_MOVE, ins->u, sym[d], 0, 0); \
+	     lastdef = -1; } while (0)
+#define ARRAYSTORE(o, in) \
+	do { NEED(in); d -= (in); EMIT((o), sym[d], sym[d + 1], sym[d + 2], 0); } while (0)
+#define IF(o, in) \
+	do { NEED(in); d -= (in); MATERIALIZE(d); \
+	     EMIT((o), 0, sym[d], (in) > 1 ? sym[d + 1] : 0, ins->i); JUMP(ins->i); } while (0)
+
+	if ((U4)code->max_locals + code->max_stack > 0xFFFF)
+		return -1;
+	ret = -1;
+	rcode = ecalloc((size_t)n * (2 * code->max_stack + 2), sizeof *rcode);
+	depth = emalloc(n * sizeof *depth);
+	rmap = ecalloc(n, sizeof *rmap);
+	target = ecalloc(n, sizeof *target);
+	sym = ecalloc(code->max_stack + 4, sizeof *sym);
+	for (pc = 0; pc < n; pc++) {
+		depth[pc] = -1;
+		ins = &code->instr[pc];
+		if (isbranch(ins->op)) {
+			target[ins->i] = 1;
+		} else if (ins->op == TABLESWITCH || ins->op == LOOKUPSWITCH) {
+			target[ins->i] = 1;
+			for (j = 1; j <= ins->u; j++)
+				target[ins[j].i] = 1;
+			pc += ins->u;
+		}
+	}
+	d = 0;
+	nr = 0;
+	lastdef = -1;
+	fallthrough = 1;
+	for (pc = 0; pc < n; pc++) {
+		ins = &code->instr[pc];
+		if (fallthrough) {
+			if (depth[pc] >= 0 && depth[pc] != d)
+				goto done;
+			if (target[pc]) {
+				MATERIALIZE(d);
+			}
+		} else {
+			d = (depth[pc] >= 0) ? depth[pc] : 0;
+			for (j = 0; j < (U4)d; j++) {
+				sym[j] = S(j);
+			}
+		}
+		if (target[pc] || !fallthrough)
+			lastdef = -1;
+		depth[pc] = d;
+		rmap[pc] = nr;
+		fallthrough = 1;
+		switch (ins->op) {
+		case NOP:
+			break;
+
+		/* constants */
+		case ACONST_NULL:
+			CONST(R_NULL, 1, 0);
+			break;
+		case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2:
+		case ICONST_3: case ICONST_4: case ICONST_5:
+		case BIPUSH: case SIPUSH:
+			CONST(R_ICONST, 1, ins->i);
+			break;
+		case LCONST_0: case LCONST_1:
+			CONST(R_LCONST, 2, ins->op - LCONST_0);
+			break;
+		case FCONST_0: case FCONST_1: case FCONST_2:
+			CONST(R_FCONST, 1, ins->op - FCONST_0);
+			break;
+		case DCONST_0: case DCONST_1:
+			CONST(R_DCONST, 2, ins->op - DCONST_0);
+			break;
+		case LDC: case LDC_W:
+			CONST(R_LDC, 1, 0);
+			break;
+		case LDC2_W:
+			CONST(R_LDC, 2, 0);
+			break;
+
+		/* loads and stores */
+		case ILOAD: case FLOAD: case ALOAD:
+		case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+		case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+		case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+			LOADLOCAL(1);
+			break;
+		case LLOAD: case DLOAD:
+		case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+		case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+			LOADLOCAL(2);
+			break;
+		case ISTORE: case FSTORE: case ASTORE:
+		case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+		case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+		case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+			STORELOCAL(1);
+			break;
+		case LSTORE: case DSTORE:
+		case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+		case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+			STORELOCAL(2);
+			break;
+		case IINC:
+			if (ins->u >= code->max_locals)
+				goto done;
+			UNALIAS(ins->u);
+			EMIT(R_IINC, ins->u, 0, 0, ins->i);
+			lastdef = -1;
+			break;
+
+		/* arrays */
+		case IALOAD: case BALOAD: case CALOAD: case SALOAD:
+			BIN(R_IALOAD, 2, 1);
+			break;
+		case LALOAD:  BIN(R_LALOAD, 2, 2); break;
+		case FALOAD:  BIN(R_FALOAD, 2, 1); break;
+		case DALOAD:  BIN(R_DALOAD, 2, 2); break;
+		case AALOAD:  BIN(R_AALOAD, 2, 1); break;
+		case IASTORE: case BASTORE: case CASTORE: case SASTORE:
+			ARRAYSTORE(R_IASTORE, 3);
+			break;
+		case LASTORE: ARRAYSTORE(R_LASTORE, 4); break;
+		case FASTORE: ARRAYSTORE(R_FASTORE, 3); break;
+		case DASTORE: ARRAYSTORE(R_DASTORE, 4); break;
+		case AASTORE: ARRAYSTORE(R_AASTORE, 3); break;
+		case ARRAYLENGTH:
+			UN(R_ARRAYLENGTH, 1, 1);
+			break;
+
+		/* stack */
+		case POP:
+			NEED(1);
+			d -= 1;
+			break;
+		case POP2:
+			NEED(2);
+			d -= 2;
+			break;
+		case DUP:
+			NEED(1);
+			sym[d] = sym[d - 1];
+			d += 1;
+			break;
+		case DUP2:
+			NEED(2);
+			sym[d] = sym[d - 2];
+			sym[d + 1] = sym[d - 1];
+			d += 2;
+			break;
+
+		/* math */
+		case IADD: BIN(R_IADD, 2, 1); break;
+		case LADD: BIN(R_LADD, 4, 2); break;
+		case FADD: BIN(R_FADD, 2, 1); break;
+		case DADD: BIN(R_DADD, 4, 2); break;
+		case ISUB: BIN(R_ISUB, 2, 1); break;
+		case LSUB: BIN(R_LSUB, 4, 2); break;
+		case FSUB: BIN(R_FSUB, 2, 1); break;
+		case DSUB: BIN(R_DSUB, 4, 2); break;
+		case IMUL: BIN(R_IMUL, 2, 1); break;
+		case LMUL: BIN(R_LMUL, 4, 2); break;
+		case FMUL: BIN(R_FMUL, 2, 1); break;
+		case DMUL: BIN(R_DMUL, 4, 2); break;
+		case IDIV: BIN(R_IDIV, 2, 1); break;
+		case LDIV: BIN(R_LDIV, 4, 2); break;
+		case FDIV: BIN(R_FDIV, 2, 1); break;
+		case DDIV: BIN(R_DDIV, 4, 2); break;
+		case IREM: BIN(R_IREM, 2, 1); break;
+		case LREM: BIN(R_LREM, 4, 2); break;
+		case FREM: BIN(R_FREM, 2, 1); break;
+		case DREM: BIN(R_DREM, 4, 2); break;
+		case INEG: UN(R_INEG, 1, 1); break;
+		case LNEG: UN(R_LNEG, 2, 2); break;
+		case FNEG: UN(R_FNEG, 1, 1); break;
+		case DNEG: UN(R_DNEG, 2, 2); break;
+		case ISHL: BIN(R_ISHL, 2, 1); break;
+		case ISHR: BIN(R_ISHR, 2, 1); break;
+		case IUSHR: BIN(R_IUSHR, 2, 1); break;
+		case LSHL: DEF(R_LSHL, 3, 2, sym[d + 2]); break;
+		case LSHR: DEF(R_LSHR, 3, 2, sym[d + 2]); break;
+		case LUSHR: DEF(R_LUSHR, 3, 2, sym[d + 2]); break;
+		case IAND: BIN(R_IAND, 2, 1); break;
+		case LAND: BIN(R_LAND, 4, 2); break;
+		case IOR:  BIN(R_IOR, 2, 1); break;
+		case LOR:  BIN(R_LOR, 4, 2); break;
+		case IXOR: BIN(R_IXOR, 2, 1); break;
+		case LXOR: BIN(R_LXOR, 4, 2); break;
+
+		/* conversions */
+		case I2L: UN(R_I2L, 1, 2); break;
+		case I2F: UN(R_I2F, 1, 1); break;
+		case I2D: UN(R_I2D, 1, 2); break;
+		case L2I: UN(R_L2I, 2, 1); break;
+		case L2F: UN(R_L2F, 2, 1); break;
+		case L2D: UN(R_L2D, 2, 2); break;
+		case F2I: UN(R_F2I, 1, 1); break;
+		case F2L: UN(R_F2L, 1, 2); break;
+		case F2D: UN(R_F2D, 1, 2); break;
+		case D2I: UN(R_D2I, 2, 1); break;
+		case D2L: UN(R_D2L, 2, 2); break;
+		case D2F: UN(R_D2F, 2, 1); break;
+		case I2B: UN(R_I2B, 1, 1); break;
+		case I2C: UN(R_I2C, 1, 1); break;
+		case I2S: UN(R_I2S, 1, 1); break;
+
+		/* comparisons */
+		case LCMP:  BIN(R_LCMP, 4, 1); break;
+		case FCMPL: BIN(R_FCMPL, 2, 1); break;
+		case FCMPG: BIN(R_FCMPG, 2, 1); break;
+		case DCMPL: BIN(R_DCMPL, 4, 1); break;
+		case DCMPG: BIN(R_DCMPG, 4, 1); break;
+		case IFEQ: IF(R_IFEQ, 1); break;
+		case IFNE: IF(R_IFNE, 1); break;
+		case IFLT: IF(R_IFLT, 1); break;
+		case IFGE: IF(R_IFGE, 1); break;
+		case IFGT: IF(R_IFGT, 1); break;
+		case IFLE: IF(R_IFLE, 1); break;
+		case IF_ICMPEQ: IF(R_IF_ICMPEQ, 2); break;
+		case IF_ICMPNE: IF(R_IF_ICMPNE, 2); break;
+		case IF_ICMPLT: IF(R_IF_ICMPLT, 2); break;
+		case IF_ICMPGE: IF(R_IF_ICMPGE, 2); break;
+		case IF_ICMPGT: IF(R_IF_ICMPGT, 2); break;
+		case IF_ICMPLE: IF(R_IF_ICMPLE, 2); break;
+		case IF_ACMPEQ: IF(R_IF_ACMPEQ, 2); break;
+		case IF_ACMPNE: IF(R_IF_ACMPNE, 2); break;
+		case IFNULL: IF(R_IFNULL, 1); break;
+		case IFNONNULL: IF(R_IFNONNULL, 1); break;
+
+		/* control */
+		case GOTO:
+			MATERIALIZE(d);
+			EMIT(R_GOTO, 0, 0, 0, ins->i);
+			JUMP(ins->i);
+			fallthrough = 0;
+			break;
+		case TABLESWITCH:
+		case LOOKUPSWITCH:
+			NEED(1);
+			d -= 1;
+			MATERIALIZE(d);
+			EMIT(ins->op == TABLESWITCH ? R_TABLESWITCH : R_LOOKUPSWITCH, 0, sym[d], 0, ins->i);
+			JUMP(ins->i);
+			for (j = 1; j <= ins->u; j++) {
+				EMIT(R_CASE, 0, 0, 0, ins[j].i);
+				r->ins = &ins[j];
+				JUMP(ins[j].i);
+			}
+			pc += ins->u;
+			fallthrough = 0;
+			break;
+		case IRETURN: case FRETURN: case ARETURN:
+			NEED(1);
+			EMIT(R_RETURN1, 0, sym[d - 1], 0, 0);
+			fallthrough = 0;
+			break;
+		case LRETURN: case DRETURN:
+			NEED(2);
+			EMIT(R_RETURN2, 0, sym[d - 2], 0, 0);
+			fallthrough = 0;
+			break;
+		case RETURN:
+			EMIT(R_RETURN, 0, 0, 0, 0);
+			fallthrough = 0;
+			break;
 
-	vv = frame_stackpop(frame);
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
+		/* instructions run by the stack-based handlers */
+		case GETSTATIC:
+		case PUTSTATIC:
+			fieldref = &class->constant_pool[ins->u]->info.fieldref_info;
+			class_getnameandtype(class, fieldref->name_and_type_index, &name, &type);
+			pop = (ins->op == PUTSTATIC) ? typeslots(type) : 0;
+			push = (ins->op == GETSTATIC) ? typeslots(type) : 0;
+			goto call;
+		case GETFIELD:
+		case PUTFIELD:
+			fieldref = &class->constant_pool[ins->u]->info.fieldref_info;
+			class_getnameandtype(class, fieldref->name_and_type_index, &name, &type);
+			pop = (ins->op == PUTFIELD) ? typeslots(type) + 1 : 1;
+			push = (ins->op == GETFIELD) ? typeslots(type) : 0;
+			goto call;
+		case INVOKESTATIC:
+		case INVOKESPECIAL:
+		case INVOKEVIRTUAL:
+			methodref = &class->constant_pool[ins->u]->info.methodref_info;
+			class_getnameandtype(class, methodref->name_and_type_index, &name, &type);
+			pop = argslots(type) + (ins->op != INVOKESTATIC);
+			push = typeslots(strchr(type, ')') + 1);
+			goto call;
+		case NEW:
+			pop = 0;
+			push = 1;
+			goto call;
+		case NEWARRAY:
+			pop = push = 1;
+			goto call;
+		case MULTIANEWARRAY:
+			pop = ins->i;
+			push = 1;
+			goto call;
+		case LDC_STRING:
+			pop = 0;
+			push = 1;
+call:
+			NEED(pop);
+			MATERIALIZE(d);
+			EMIT(R_CALL, d, 0, 0, 0);
+			d += push - pop;
+			for (j = d - push; j < (U4)d; j++)
+				sym[j] = S(j);
+			lastdef = -1;
+			break;
+		default:
+			goto done;
+		}
+		if (d > code->max_stack)
+			goto done;
 	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
+	if (fallthrough)
+		goto done;
+	for (j = 0; j < nr; j++) {
+		switch (rcode[j].op) {
+		case R_IFEQ: case R_IFNE: case R_IFLT: case R_IFGE: case R_IFGT: case R_IFLE:
+		case R_IF_ICMPEQ: case R_IF_ICMPNE: case R_IF_ICMPLT: case R_IF_ICMPGE:
+		case R_IF_ICMPGT: case R_IF_ICMPLE: case R_IF_ACMPEQ: case R_IF_ACMPNE:
+		case R_IFNULL: case R_IFNONNULL: case R_GOTO:
+		case R_TABLESWITCH: case R_LOOKUPSWITCH: case R_CASE:
+			rcode[j].i = rmap[rcode[j].i];
+			break;
+		}
 	}
-	((void **)va.v->obj)[vi.i] = vv.v;
-	return NO_RETURN;
-}
+	code->rinstr = emalloc(nr * sizeof *code->rinstr);
+	memcpy(code->rinstr, rcode, nr * sizeof *code->rinstr);
+	ret = 0;
+done:
+	free(rcode);
+	free(depth);
+	free(rmap);
+	free(target);
+	free(sym);
+	return ret;
+#undef S
+#undef EMIT
+#undef NEED
+#undef JUMP
+#undef MATERIALIZE
+#undef UNALIAS
+#undef DEF
+#undef BIN
+#undef UN
+#undef CONST
+#undef LOADLOCAL
+#undef STORELOCAL
+#undef ARRAYSTORE
+#undef IF
+}
+
+/* compare keys of lookupswitch cases, for sorting them */
+static int
+casecmp(const void *a, const void *b)
+{
+	I4 x, y;
+
+	x = ((const Instr *)a)->v.i;
+	y = ((const Instr *)b)->v.i;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Map each offset into the bytecode of code to the index of the decoded
+ * instruction starting there, or -1; set *n to the number of decoded
+ * instructions, including the entries of the jump tables of switches.
+ */
+static I4 *
+codemap(Code_attribute *code, U4 *n)
+{
+	I4 *map;
+	U4 pc;
+
+	map = emalloc(code->code_length * sizeof *map);
+	for (pc = 0; pc < code->code_length; pc++)
+		map[pc] = -1;
+	for (*n = pc = 0; pc < code->code_length; pc += codesize(code, pc)) {
+		map[pc] = (*n)++;
+		*n += codecases(code, pc);
+	}
+	return map;
+}
+
+/*
+ * Decode the bytecode of a method into an array of fixed-size
+ * instructions, with the operands already in native byte order,
+ * constants fetched from the constant pool and branch offsets
+ * translated into instruction indices.  The jump table of a
+ * tableswitch or lookupswitch is stored in the SWITCH_CASE entries
+ * that follow it, sorted by key for a lookupswitch, which becomes a
+ * tableswitch when its keys are contiguous.  The bytecode itself is
+ * kept untouched.
+ */
+static void
+codedecode(ClassFile *class, Code_attribute *code)
+{
+	Instr *ins;
+	I4 *map;
+	U1 *p;
+	U4 pc, base, n, j;
+
+	map = codemap(code, &n);
+	code->instr = ecalloc(n, sizeof *code->instr);
+	for (pc = 0; pc < code->code_length; pc += codesize(code, pc)) {
+		p = code->code + pc;
+		ins = &code->instr[map[pc]];
+		ins->op = p[0];
+		switch (p[0]) {
+		case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2:
+		case ICONST_3: case ICONST_4: case ICONST_5:
+			ins->i = p[0] - ICONST_0;
+			break;
+		case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+		case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+		case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+		case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+		case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+			ins->u = (p[0] - ILOAD_0) % 4;
+			break;
+		case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+		case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+		case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+		case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+		case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+			ins->u = (p[0] - ISTORE_0) % 4;
+			break;
+		case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+		case ISTORE: case LSTORE: case FSTORE: case DSTORE: case ASTORE:
+		case RET: case NEWARRAY:
+			ins->u = p[1];
+			break;
+		case IINC:
+			ins->u = p[1];
+			ins->i = I1OPERAND(p + 2);
+			break;
+		case WIDE:
+			ins->op = p[1];
+			ins->u = U2OPERAND(p + 2);
+			if (p[1] == IINC)
+				ins->i = I2OPERAND(p + 4);
+			break;
+		case BIPUSH:
+			ins->i = I1OPERAND(p + 1);
+			break;
+		case SIPUSH:
+			ins->i = I2OPERAND(p + 1);
+			break;
+		case LDC:
+		case LDC_W:
+			ins->u = (p[0] == LDC) ? p[1] : U2OPERAND(p + 1);
+			if (class->constant_pool[ins->u]->tag == CONSTANT_String)
+				ins->op = LDC_STRING;
+			ins->v = resolveconstant(class, ins->u);
+			break;
+		case LDC2_W:
+			ins->u = U2OPERAND(p + 1);
+			ins->v = resolveconstant(class, ins->u);
+			break;
+		case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+		case IF_ICMPEQ: case IF_ICMPNE: case IF_ICMPLT: case IF_ICMPGE:
+		case IF_ICMPGT: case IF_ICMPLE: case IF_ACMPEQ: case IF_ACMPNE:
+		case IFNULL: case IFNONNULL: case GOTO: case JSR:
+			ins->i = codetarget(map, code, (I8)pc + I2OPERAND(p + 1));
+			break;
+		case GOTO_W:
+		case JSR_W:
+			ins->op = (p[0] == GOTO_W) ? GOTO : JSR;
+			ins->i = codetarget(map, code, (I8)pc + I4OPERAND(p + 1));
+			break;
+		case TABLESWITCH:
+			base = (pc + 4) & ~3u;
+			ins->i = codetarget(map, code, (I8)pc + I4OPERAND(code->code + base));
+			ins->v.i = I4OPERAND(code->code + base + 4);
+			ins->u = codecases(code, pc);
+			for (j = 0; j < ins->u; j++) {
+				ins[j + 1].op = SWITCH_CASE;
+				ins[j + 1].i = codetarget(map, code, (I8)pc + I4OPERAND(code->code + base + 12 + 4 * j));
+			}
+			break;
+		case LOOKUPSWITCH:
+			base = (pc + 4) & ~3u;
+			ins->i = codetarget(map, code, (I8)pc + I4OPERAND(code->code + base));
+			ins->u = codecases(code, pc);
+			for (j = 0; j < ins->u; j++) {
+				ins[j + 1].op = SWITCH_CASE;
+				ins[j + 1].v.i = I4OPERAND(code->code + base + 8 + 8 * j);
+				ins[j + 1].i = codetarget(map, code, (I8)pc + I4OPERAND(code->code + base + 12 + 8 * j));
+			}
+			qsort(ins + 1, ins->u, sizeof *ins, casecmp);
+			if (ins->u > 0 && (U4)ins[ins->u].v.i - (U4)ins[1].v.i == ins->u - 1u) {
+				/* contiguous keys make a jump table */
+				ins->op = TABLESWITCH;
+				ins->v.i = ins[1].v.i;
+			}
+			break;
+		case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+		case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+		case INVOKEINTERFACE: case INVOKEDYNAMIC:
+		case NEW: case ANEWARRAY: case CHECKCAST: case INSTANCEOF:
+			ins->u = U2OPERAND(p + 1);
+			break;
+		case MULTIANEWARRAY:
+			ins->u = U2OPERAND(p + 1);
+			ins->i = p[3];
+			break;
+		}
+	}
+	free(map);
+	code->ninstr = n;
+}
+
+/*
+ * Stack effect of the instructions whose effect depends only on their
+ * opcode: the types popped from the operand stack, the topmost last,
+ * then '>', then the types pushed.  I, J, F, D and A stand for int,
+ * long, float, double and reference values.
+ */
+static char *opeffect[CODE_LAST] = {
+	[NOP] = ">",
+	[ACONST_NULL] = ">A",
+	[ICONST_M1] = ">I", [ICONST_0] = ">I", [ICONST_1] = ">I", [ICONST_2] = ">I",
+	[ICONST_3] = ">I", [ICONST_4] = ">I", [ICONST_5] = ">I",
+	[LCONST_0] = ">J", [LCONST_1] = ">J",
+	[FCONST_0] = ">F", [FCONST_1] = ">F", [FCONST_2] = ">F",
+	[DCONST_0] = ">D", [DCONST_1] = ">D",
+	[BIPUSH] = ">I", [SIPUSH] = ">I",
+	[IALOAD] = "AI>I", [LALOAD] = "AI>J", [FALOAD] = "AI>F", [DALOAD] = "AI>D",
+	[AALOAD] = "AI>A", [BALOAD] = "AI>I", [CALOAD] = "AI>I", [SALOAD] = "AI>I",
+	[IASTORE] = "AII>", [LASTORE] = "AIJ>", [FASTORE] = "AIF>", [DASTORE] = "AID>",
+	[AASTORE] = "AIA>", [BASTORE] = "AII>", [CASTORE] = "AII>", [SASTORE] = "AII>",
+	[IADD] = "II>I", [LADD] = "JJ>J", [FADD] = "FF>F", [DADD] = "DD>D",
+	[ISUB] = "II>I", [LSUB] = "JJ>J", [FSUB] = "FF>F", [DSUB] = "DD>D",
+	[IMUL] = "II>I", [LMUL] = "JJ>J", [FMUL] = "FF>F", [DMUL] = "DD>D",
+	[IDIV] = "II>I", [LDIV] = "JJ>J", [FDIV] = "FF>F", [DDIV] = "DD>D",
+	[IREM] = "II>I", [LREM] = "JJ>J", [FREM] = "FF>F", [DREM] = "DD>D",
+	[INEG] = "I>I", [LNEG] = "J>J", [FNEG] = "F>F", [DNEG] = "D>D",
+	[ISHL] = "II>I", [LSHL] = "JI>J", [ISHR] = "II>I", [LSHR] = "JI>J",
+	[IUSHR] = "II>I", [LUSHR] = "JI>J",
+	[IAND] = "II>I", [LAND] = "JJ>J", [IOR] = "II>I", [LOR] = "JJ>J",
+	[IXOR] = "II>I", [LXOR] = "JJ>J",
+	[I2L] = "I>J", [I2F] = "I>F", [I2D] = "I>D",
+	[L2I] = "J>I", [L2F] = "J>F", [L2D] = "J>D",
+	[F2I] = "F>I", [F2L] = "F>J", [F2D] = "F>D",
+	[D2I] = "D>I", [D2L] = "D>J", [D2F] = "D>F",
+	[I2B] = "I>I", [I2C] = "I>I", [I2S] = "I>I",
+	[LCMP] = "JJ>I", [FCMPL] = "FF>I", [FCMPG] = "FF>I", [DCMPL] = "DD>I", [DCMPG] = "DD>I",
+	[IFEQ] = "I>", [IFNE] = "I>", [IFLT] = "I>", [IFGE] = "I>", [IFGT] = "I>", [IFLE] = "I>",
+	[IF_ICMPEQ] = "II>", [IF_ICMPNE] = "II>", [IF_ICMPLT] = "II>",
+	[IF_ICMPGE] = "II>", [IF_ICMPGT] = "II>", [IF_ICMPLE] = "II>",
+	[IF_ACMPEQ] = "AA>", [IF_ACMPNE] = "AA>",
+	[GOTO] = ">",
+	[TABLESWITCH] = "I>", [LOOKUPSWITCH] = "I>",
+	[IRETURN] = "I>", [LRETURN] = "J>", [FRETURN] = "F>", [DRETURN] = "D>",
+	[ARETURN] = "A>", [RETURN] = ">",
+	[NEW] = ">A", [NEWARRAY] = "I>A", [ANEWARRAY] = "I>A", [ARRAYLENGTH] = "A>I",
+	[ATHROW] = "A>", [CHECKCAST] = "A>A", [INSTANCEOF] = "A>I",
+	[MONITORENTER] = "A>", [MONITOREXIT] = "A>",
+	[IFNULL] = "A>", [IFNONNULL] = "A>",
+};
 
-/* arraylength: get length of array */
-static int
-oparraylength(Frame *frame)
+/* state of the verification of a method */
+typedef struct Verifier {
+	ClassFile      *class;
+	Method         *method;
+	Code_attribute *code;
+	U1             *types;          /* types of the local variables, then of the stack, at each instruction */
+	I4             *depth;          /* operand stack depth at each instruction, -1 if not reached yet */
+	U4             *work;           /* instructions whose state changed and must be checked again */
+	U1             *queued;         /* whether each instruction is in work */
+	U4              nwork;
+	U4              width;          /* max_locals + max_stack */
+	U1             *cur;            /* types of the local variables, then of the stack, being checked */
+	U4              sp;             /* operand stack depth being checked */
+	U4              pc;             /* instruction being checked */
+} Verifier;
+
+/* reject the method being verified */
+static void
+verifyfail(Verifier *vf, char *msg)
 {
-	Value v;
+	errx(EXIT_FAILURE, "%s.%s%s: instruction %lu: verify error: %s",
+	     class_getclassname(vf->class, vf->class->this_class),
+	     class_getutf8(vf->class, vf->method->name_index),
+	     class_getutf8(vf->class, vf->method->descriptor_index),
+	     (unsigned long)vf->pc, msg);
+}
 
-	v = frame_stackpop(frame);
-	v.i = v.v->nmemb;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+/* get verifier type of a field descriptor or of an opeffect letter */
+static U1
+vtype(int c)
+{
+	switch (c) {
+	case TYPE_BYTE: case TYPE_CHAR: case TYPE_SHORT: case TYPE_BOOLEAN: case TYPE_INT:
+		return VT_INT;
+	case TYPE_FLOAT:
+		return VT_FLOAT;
+	case TYPE_LONG:
+		return VT_LONG;
+	case TYPE_DOUBLE:
+		return VT_DOUBLE;
+	case TYPE_REFERENCE: case TYPE_ARRAY: case 'A':
+		return VT_REF;
+	default:
+		return VT_TOP;
+	}
 }
 
-/* bipush: push byte */
+/* check whether a value of the given verifier type takes two slots */
 static int
-opbipush(Frame *frame)
+vwide(U1 t)
 {
-	Value v;
-
-	v.i = (int8_t)frame->code->code[frame->pc++];
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	return t == VT_LONG || t == VT_DOUBLE;
 }
 
-/* d2f: convert double to float */
-static int
-opd2f(Frame *frame)
+/* pop value of type t from the operand stack being checked */
+static void
+vpop(Verifier *vf, U1 t)
 {
-	Value v;
+	U1 *stack;
 
-	v = frame_stackpop(frame);
-	v.f = v.d;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	stack = vf->cur + vf->code->max_locals;
+	if (vf->sp < (vwide(t) ? 2u : 1u))
+		verifyfail(vf, "operand stack underflow");
+	if (vwide(t)) {
+		if (stack[vf->sp - 1] != VT_HIGH || stack[vf->sp - 2] != t)
+			verifyfail(vf, "bad type on operand stack");
+		vf->sp -= 2;
+	} else {
+		if (stack[vf->sp - 1] != t)
+			verifyfail(vf, "bad type on operand stack");
+		vf->sp--;
+	}
 }
 
-/* d2i: convert double to int */
-static int
-opd2i(Frame *frame)
+/* push value of type t onto the operand stack being checked */
+static void
+vpush(Verifier *vf, U1 t)
 {
-	Value v;
+	U1 *stack;
 
-	v = frame_stackpop(frame);
-	v.i = v.d;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	stack = vf->cur + vf->code->max_locals;
+	if (vf->sp + (vwide(t) ? 2u : 1u) > vf->code->max_stack)
+		verifyfail(vf, "operand stack overflow");
+	stack[vf->sp++] = t;
+	if (vwide(t))
+		stack[vf->sp++] = VT_HIGH;
 }
 
-/* d2l: convert double to long */
-static int
-opd2l(Frame *frame)
+/* check that the top n slots of the operand stack being checked exist and do not split a long or double */
+static void
+vslots(Verifier *vf, U4 n)
 {
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.l = v.d;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	if (vf->sp < n)
+		verifyfail(vf, "operand stack underflow");
+	if (vf->sp > n && vf->cur[vf->code->max_locals + vf->sp - n] == VT_HIGH)
+		verifyfail(vf, "long or double split on operand stack");
 }
 
-/* dadd: add double */
-static int
-opdadd(Frame *frame)
+/* copy the top n slots of the operand stack being checked, inserting the copy below the next x slots */
+static void
+vdup(Verifier *vf, U4 n, U4 x)
 {
-	Value v1, v2;
+	U1 *stack, top[2];
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.d += v2.d;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	vslots(vf, n);
+	vslots(vf, n + x);
+	if (vf->sp + n > vf->code->max_stack)
+		verifyfail(vf, "operand stack overflow");
+	stack = vf->cur + vf->code->max_locals;
+	memcpy(top, stack + vf->sp - n, n);
+	memmove(stack + vf->sp - n - x + n, stack + vf->sp - n - x, n + x);
+	memcpy(stack + vf->sp - n - x, top, n);
+	vf->sp += n;
 }
 
-/* daload: load double from array */
-static int
-opdaload(Frame *frame)
+/* check that local variable i, of type t, exists */
+static void
+vlocal(Verifier *vf, U4 i, U1 t)
 {
-	Value va, vi, v;
-
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	v.d = ((double *)va.v->obj)[vi.i];
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	if (i + (vwide(t) ? 1u : 0u) >= vf->code->max_locals)
+		verifyfail(vf, "invalid local variable");
 }
 
-/* dastore: store into double array */
-static int
-opdastore(Frame *frame)
+/* load local variable i of type t onto the operand stack being checked */
+static void
+vload(Verifier *vf, U4 i, U1 t)
 {
-	Value va, vi, vv;
+	vlocal(vf, i, t);
+	if (vf->cur[i] != t || (vwide(t) && vf->cur[i + 1] != VT_HIGH))
+		verifyfail(vf, "bad type in local variable");
+	vpush(vf, t);
+}
 
-	vv = frame_stackpop(frame);
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
+/* store value of type t from the operand stack being checked into local variable i */
+static void
+vstore(Verifier *vf, U4 i, U1 t)
+{
+	vlocal(vf, i, t);
+	vpop(vf, t);
+	if (i > 0 && vf->cur[i] == VT_HIGH)
+		vf->cur[i - 1] = VT_TOP;
+	if (vwide(vf->cur[i]))
+		vf->cur[i + 1] = VT_TOP;
+	vf->cur[i] = t;
+	if (vwide(t)) {
+		if (vwide(vf->cur[i + 1]))
+			vf->cur[i + 2] = VT_TOP;
+		vf->cur[i + 1] = VT_HIGH;
 	}
-	((double *)va.v->obj)[vi.i] = vv.d;
-	return NO_RETURN;
 }
 
-/* dcmpg: compare double */
-static int
-opdcmpg(Frame *frame)
-{
-	Value v1, v2, v;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.d > v2.d)
-		v.i = 1;
-	else if (v1.d == v2.d)
-		v.i = 0;
-	else if (v1.d < v2.d)
-		v.i = -1;
-	else
-		v.i = 1;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
+/* pop the arguments of a method descriptor from the operand stack being checked, then push its return value */
+static void
+vcall(Verifier *vf, char *descr, int receiver)
+{
+	U1 args[256];
+	U4 n;
+	char *s;
 
-/* dcmpl: compare double */
-static int
-opdcmpl(Frame *frame)
-{
-	Value v1, v2, v;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.d > v2.d)
-		v.i = 1;
-	else if (v1.d == v2.d)
-		v.i = 0;
-	else if (v1.d < v2.d)
-		v.i = -1;
-	else
-		v.i = -1;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	for (n = 0, s = descr + 1; *s != '\0' && *s != ')'; s++) {
+		if (n == LEN(args))
+			verifyfail(vf, "too many arguments");
+		args[n++] = vtype(*s);
+		while (*s == TYPE_ARRAY)
+			s++;
+		if (*s == TYPE_REFERENCE)
+			while (*s != '\0' && *s != TYPE_TERMINAL)
+				s++;
+	}
+	if (*s != ')')
+		verifyfail(vf, "invalid method descriptor");
+	while (n > 0)
+		vpop(vf, args[--n]);
+	if (receiver)
+		vpop(vf, VT_REF);
+	if (s[1] != TYPE_VOID)
+		vpush(vf, vtype(s[1]));
 }
 
-/* dconst_0: push double 0 into stack */
-static int
-opdconst_0(Frame *frame)
-{
-	Value v;
-
-	v.d = 0.0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+/* merge the state being checked into the state at the entry of instruction target */
+static void
+vmerge(Verifier *vf, I4 target, U4 sp)
+{
+	U1 *types;
+	U4 i;
+	int changed;
+
+	if (target < 0 || (U4)target >= vf->code->ninstr || vf->code->instr[target].op == SWITCH_CASE)
+		verifyfail(vf, "invalid branch target");
+	types = vf->types + (size_t)target * vf->width;
+	if (vf->depth[target] < 0) {
+		memcpy(types, vf->cur, vf->code->max_locals + sp);
+		vf->depth[target] = sp;
+		changed = 1;
+	} else if ((U4)vf->depth[target] != sp) {
+		verifyfail(vf, "inconsistent operand stack depth");
+		return;
+	} else {
+		changed = 0;
+		for (i = 0; i < vf->code->max_locals + sp; i++) {
+			if (types[i] != vf->cur[i] && types[i] != VT_TOP) {
+				types[i] = VT_TOP;
+				changed = 1;
+			}
+		}
+	}
+	if (changed && !vf->queued[target]) {
+		vf->queued[target] = 1;
+		vf->work[vf->nwork++] = target;
+	}
 }
 
-/* dconst_1: push double 1 into stack */
+/*
+ * Check instruction vf->pc on the state at its entry, and merge the
+ * resulting state into its successors.  Return 0 if the instruction
+ * is one the verifier does not handle.
+ */
 static int
-opdconst_1(Frame *frame)
+verifyinstr(Verifier *vf)
 {
-	Value v;
-
-	v.d = 1.0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	CONSTANT_Fieldref_info *fieldref;
+	Instr *ins;
+	U1 t;
+	U4 i;
+	char *s, *name, *type;
+
+	ins = &vf->code->instr[vf->pc];
+	if (ins->op < CODE_LAST && opeffect[ins->op] != NULL) {
+		s = strchr(opeffect[ins->op], '>');
+		for (i = s - opeffect[ins->op]; i > 0; i--)
+			vpop(vf, vtype(opeffect[ins->op][i - 1]));
+		for (s++; *s != '\0'; s++)
+			vpush(vf, vtype(*s));
+	}
+	switch (ins->op) {
+	case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+		vload(vf, ins->u, vtype("IJFDA"[ins->op - ILOAD]));
+		break;
+	case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+	case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+	case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+	case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+	case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+		vload(vf, ins->u, vtype("IJFDA"[(ins->op - ILOAD_0) / 4]));
+		break;
+	case ISTORE: case LSTORE: case FSTORE: case DSTORE: case ASTORE:
+		vstore(vf, ins->u, vtype("IJFDA"[ins->op - ISTORE]));
+		break;
+	case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+	case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+	case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+	case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+	case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+		vstore(vf, ins->u, vtype("IJFDA"[(ins->op - ISTORE_0) / 4]));
+		break;
+	case IINC:
+		vlocal(vf, ins->u, VT_INT);
+		if (vf->cur[ins->u] != VT_INT)
+			verifyfail(vf, "bad type in local variable");
+		break;
+	case LDC_STRING:
+		vpush(vf, VT_REF);
+		break;
+	case LDC:
+	case LDC_W:
+	case LDC2_W:
+		switch (vf->class->constant_pool[ins->u]->tag) {
+		case CONSTANT_Integer:  t = VT_INT;     break;
+		case CONSTANT_Float:    t = VT_FLOAT;   break;
+		case CONSTANT_Long:     t = VT_LONG;    break;
+		case CONSTANT_Double:   t = VT_DOUBLE;  break;
+		default:                t = VT_REF;     break;
+		}
+		if ((ins->op == LDC2_W) != vwide(t))
+			verifyfail(vf, "bad constant");
+		vpush(vf, t);
+		break;
+	case POP:
+		vslots(vf, 1);
+		vf->sp--;
+		break;
+	case POP2:
+		vslots(vf, 2);
+		vf->sp -= 2;
+		break;
+	case DUP:       vdup(vf, 1, 0); break;
+	case DUP_X1:    vdup(vf, 1, 1); break;
+	case DUP_X2:    vdup(vf, 1, 2); break;
+	case DUP2:      vdup(vf, 2, 0); break;
+	case DUP2_X1:   vdup(vf, 2, 1); break;
+	case DUP2_X2:   vdup(vf, 2, 2); break;
+	case SWAP:
+		vslots(vf, 1);
+		vslots(vf, 2);
+		t = vf->cur[vf->code->max_locals + vf->sp - 1];
+		vf->cur[vf->code->max_locals + vf->sp - 1] = vf->cur[vf->code->max_locals + vf->sp - 2];
+		vf->cur[vf->code->max_locals + vf->sp - 2] = t;
+		break;
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN:
+		if (vtype(vf->method->sig.ret) != vtype("IJFDA"[ins->op - IRETURN]))
+			verifyfail(vf, "bad return type");
+		return 1;
+	case RETURN:
+		if (vf->method->sig.ret != TYPE_VOID)
+			verifyfail(vf, "bad return type");
+		return 1;
+	case ATHROW:
+		return 1;
+	case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+		fieldref = &vf->class->constant_pool[ins->u]->info.fieldref_info;
+		class_getnameandtype(vf->class, fieldref->name_and_type_index, &name, &type);
+		if (ins->op == PUTSTATIC || ins->op == PUTFIELD)
+			vpop(vf, vtype(*type));
+		if (ins->op == GETFIELD || ins->op == PUTFIELD)
+			vpop(vf, VT_REF);
+		if (ins->op == GETSTATIC || ins->op == GETFIELD)
+			vpush(vf, vtype(*type));
+		break;
+	case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+		class_getnameandtype(vf->class, vf->class->constant_pool[ins->u]->info.methodref_info.name_and_type_index, &name, &type);
+		vcall(vf, type, ins->op != INVOKESTATIC);
+		break;
+	case INVOKEINTERFACE:
+		class_getnameandtype(vf->class, vf->class->constant_pool[ins->u]->info.interfacemethodref_info.name_and_type_index, &name, &type);
+		vcall(vf, type, 1);
+		break;
+	case MULTIANEWARRAY:
+		if (ins->i < 1)
+			verifyfail(vf, "invalid array dimensions");
+		for (i = 0; i < (U4)ins->i; i++)
+			vpop(vf, VT_INT);
+		vpush(vf, VT_REF);
+		break;
+	case TABLESWITCH:
+	case LOOKUPSWITCH:
+		vmerge(vf, ins->i, vf->sp);
+		for (i = 1; i <= ins->u; i++)
+			vmerge(vf, ins[i].i, vf->sp);
+		return 1;
+	case GOTO:
+		vmerge(vf, ins->i, vf->sp);
+		return 1;
+	default:
+		if (ins->op >= CODE_LAST || opeffect[ins->op] == NULL)
+			return 0;
+		break;
+	}
+	if (isbranch(ins->op))
+		vmerge(vf, ins->i, vf->sp);
+	if (vf->pc + 1 >= vf->code->ninstr)
+		verifyfail(vf, "falling off the end of the code");
+	vmerge(vf, vf->pc + 1, vf->sp);
+	return 1;
+}
+
+/*
+ * Verify the decoded code of a method by dataflow type inference: the
+ * types of the local variables and operand stack slots at the entry of
+ * each instruction are inferred from those at its predecessors, until
+ * they no longer change, proving the operand stack depth never goes
+ * below zero nor above max_stack, that each instruction finds operands
+ * of the types it expects, that local variables exist and hold values
+ * of the types loaded from them, and that branches land on
+ * instructions.  StackMapTable attributes are not used.  A method that
+ * fails is rejected; the value returned is 1 if the method was proven
+ * type-safe, or 0 if it uses subroutines (jsr and ret) or invokedynamic,
+ * which are not verified, and must run with dynamic checks.  The
+ * slots holding references at each instruction of a verified method are
+ * kept in its reference map, for the garbage collector.
+ */
+static int
+codeverify(ClassFile *class, Method *method)
+{
+	Verifier vf;
+	Exception *handler;
+	I4 *map;
+	U4 *offset, pc, n, i, j;
+	U1 *bits, t;
+	int ok;
+
+	vf.class = class;
+	vf.method = method;
+	vf.code = method->code;
+	vf.width = vf.code->max_locals + vf.code->max_stack;
+	vf.types = ecalloc((size_t)vf.code->ninstr * vf.width + 1, 1);
+	vf.cur = ecalloc(vf.width + 1, 1);
+	vf.depth = emalloc(vf.code->ninstr * sizeof *vf.depth);
+	vf.work = emalloc(vf.code->ninstr * sizeof *vf.work);
+	vf.queued = ecalloc(vf.code->ninstr, 1);
+	vf.nwork = 0;
+	vf.pc = 0;
+	map = codemap(vf.code, &n);
+	offset = emalloc(n * sizeof *offset);
+	for (pc = 0; pc < vf.code->code_length; pc++)
+		if (map[pc] >= 0)
+			offset[map[pc]] = pc;
+	for (i = 0; i < vf.code->ninstr; i++)
+		vf.depth[i] = -1;
+	if (method->sig.nslots > vf.code->max_locals)
+		verifyfail(&vf, "arguments do not fit in local variables");
+	j = 0;
+	if (!(method->access_flags & ACC_STATIC))
+		vf.cur[j++] = VT_REF;
+	for (i = 0; i < method->sig.nargs; i++) {
+		vf.cur[j++] = vtype(method->sig.args[i]);
+		if (vwide(vf.cur[j - 1]))
+			vf.cur[j++] = VT_HIGH;
+	}
+	vmerge(&vf, 0, 0);
+	ok = 1;
+	while (ok && vf.nwork > 0) {
+		vf.pc = vf.work[--vf.nwork];
+		vf.queued[vf.pc] = 0;
+		vf.sp = vf.depth[vf.pc];
+		memcpy(vf.cur, vf.types + (size_t)vf.pc * vf.width, vf.code->max_locals + vf.sp);
+		/* an exception handler may be entered from any instruction it covers, with the exception on the stack */
+		for (i = 0; i < vf.code->exception_table_length; i++) {
+			handler = vf.code->exception_table[i];
+			if (offset[vf.pc] < handler->start_pc || offset[vf.pc] >= handler->end_pc)
+				continue;
+			if (handler->handler_pc >= vf.code->code_length || map[handler->handler_pc] < 0)
+				verifyfail(&vf, "invalid exception handler");
+			if (vf.code->max_stack < 1)
+				verifyfail(&vf, "operand stack overflow");
+			t = vf.cur[vf.code->max_locals];
+			vf.cur[vf.code->max_locals] = VT_REF;
+			vmerge(&vf, map[handler->handler_pc], 1);
+			vf.cur[vf.code->max_locals] = t;
+		}
+		ok = verifyinstr(&vf);
+	}
+	if (ok) {
+		n = REFMAPSIZE(vf.code);
+		vf.code->refmap = ecalloc((size_t)vf.code->ninstr * n + 1, 1);
+		for (pc = 0; pc < vf.code->ninstr; pc++) {
+			bits = vf.code->refmap + (size_t)pc * n;
+			for (i = 0; vf.depth[pc] >= 0 && i < vf.code->max_locals + (U4)vf.depth[pc]; i++) {
+				if (vf.types[(size_t)pc * vf.width + i] == VT_REF) {
+					bits[i / 8] |= 1 << i % 8;
+				}
+			}
+		}
+	}
+	free(map);
+	free(offset);
+	free(vf.types);
+	free(vf.cur);
+	free(vf.depth);
+	free(vf.work);
+	free(vf.queued);
+	return ok;
 }
 
-/* ddiv: divide double */
-static int
-opddiv(Frame *frame)
+/* decode and verify the code of each method of a class */
+static void
+classdecode(ClassFile *class)
 {
-	Value v1, v2;
+	Code_attribute *code;
+	U2 i;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.d /= v2.d;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	for (i = 0; i < class->methods_count; i++) {
+		if ((code = class->methods[i]->code) == NULL)
+			continue;
+		codedecode(class, code);
+		code->verified = codeverify(class, class->methods[i]);
+		if (regtier && code->verified)
+			(void)regdecode(class, code, code->ninstr);
+		if (oppairs == NULL && code->verified)
+			codefuse(code->instr, code->ninstr);
+	}
 }
 
-/* dmul: multiply double */
-static int
-opdmul(Frame *frame)
+/* resolve reference to static field at index into the address of its value; set *type to the descriptor of the field */
+static Value *
+resolvefield(ClassFile *class, U2 index, char **type)
 {
-	Value v1, v2;
+	CONSTANT_Fieldref_info *fieldref;
+	Field *field;
+	enum JavaClass jclass;
+	char *classname, *name;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.d *= v2.d;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	fieldref = &class->constant_pool[index]->info.fieldref_info;
+	classname = class_getclassname(class, fieldref->class_index);
+	class_getnameandtype(class, fieldref->name_and_type_index, &name, type);
+	if ((jclass = native_javaclass(classname)) != NONE_CLASS) {
+		if (fieldref->value.v == NULL) {
+			if ((fieldref->value.v = heap_allocold(1, sizeof (void *))) == NULL)
+				errx(EXIT_FAILURE, "out of memory");
+			*(void **)HEAP_DATA(fieldref->value.v) = native_javaobj(jclass, name, *type);
+		}
+		return &fieldref->value;
+	}
+	class = classresolve(class, fieldref->class_index);
+	if ((field = class_lookupfield(class, name, *type, &class)) == NULL || !(field->access_flags & ACC_STATIC))
+		errx(EXIT_FAILURE, "could not resolve field %s", name);
+	return &class->statics[field->offset];
 }
 
-/* dneg: negate double */
-static int
-opdneg(Frame *frame)
+/* resolve method reference into a call site */
+static Callsite *
+resolvemethod(ClassFile *class, U2 index, U2 flags)
 {
-	Value v;
+	CONSTANT_Methodref_info *methodref;
+	Callsite *site;
+	Method *method;
+	enum JavaClass jclass;
+	char *classname, *name, *type;
 
-	v = frame_stackpop(frame);
-	v.d = -v.d;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	methodref = &class->constant_pool[index]->info.methodref_info;
+	classname = class_getclassname(class, methodref->class_index);
+	class_getnameandtype(class, methodref->name_and_type_index, &name, &type);
+	site = ecalloc(1, sizeof *site);
+	site->name = name;
+	site->descriptor = type;
+	site->nargs = argslots(type) + (flags == ACC_STATIC ? 0 : 1);
+	if ((jclass = native_javaclass(classname)) != NONE_CLASS) {
+		if ((site->native = native_getmethod(jclass, name, type)) == NULL) {
+			errx(EXIT_FAILURE, "error invoking native method %s", name);
+		}
+	} else if ((class = classresolve(class, methodref->class_index)) != NULL) {
+		if ((method = class_lookupmethod(class, name, type, &class)) == NULL ||
+		    ((flags != ACC_NONE) && !(method->access_flags & flags))) {
+			errx(EXIT_FAILURE, "could not find method %s", name);
+		}
+		if (method->code == NULL)
+			errx(EXIT_FAILURE, "could not find code for method %s", name);
+		site->class = class;
+		site->code = method->code;
+		site->nargs = method->sig.nslots;
+		site->nret = method->sig.nret;
+	} else {
+		errx(EXIT_FAILURE, "could not load class %s", classname);
+	}
+	site->next = callsites;
+	callsites = site;
+	return site;
 }
 
-/* drem: remainder double */
-static int
-opdrem(Frame *frame)
+/* collect garbage before allocating size bytes, if the heap is full; frame must be in sync */
+static void
+gcpoint(size_t size)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.d = fmod(v1.d, v2.d);
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	if (heap_full(size)) {
+		heap_collect(size);
+	}
 }
 
-/* dsub: subtract double */
-static int
-opdsub(Frame *frame)
+/* mark the objects referred to from the loaded classes, by their static fields and constants */
+static void
+gcroots(void)
 {
-	Value v1, v2;
+	ClassFile *class;
+	U2 i;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.d -= v2.d;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	for (class = classes; class != NULL; class = class->next) {
+		for (i = 0; i < class->nstaticrefs; i++)
+			heap_root(&class->statics[i].v);
+		for (i = 1; i < class->constant_pool_count; i++) {
+			if (class->constant_pool[i] == NULL)
+				continue;
+			if (class->constant_pool[i]->tag == CONSTANT_String) {
+				heap_root(&class->constant_pool[i]->info.string_info.obj);
+			} else if (class->constant_pool[i]->tag == CONSTANT_Fieldref) {
+				heap_root(&class->constant_pool[i]->info.fieldref_info.value.v);
+			}
+		}
+	}
 }
 
-/* dup: duplicate the top operand stack value */
-static int
-opdup(Frame *frame)
+/* quicken getstatic or putstatic ins into an access of the value of its field, at the address it is resolved to */
+static void
+staticquicken(Frame *frame, Instr *ins)
 {
-	Value v;
-
-	v = frame_stackpop(frame);
-	frame_stackpush(frame, v);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	char *type;
+	int wide;
+
+	/* the object of a field of a native class is allocated at its resolution */
+	gcpoint(HEAP_HEADER + sizeof (void *));
+	ins->p = resolvefield(frame->class, ins->u, &type);
+	wide = (typeslots(type) == 2);
+	if (ins->op == GETSTATIC)
+		ins->op = wide ? GETSTATIC_WIDE : GETSTATIC_QUICK;
+	else
+		ins->op = wide ? PUTSTATIC_WIDE : PUTSTATIC_QUICK;
 }
 
-/* dup2: duplicate the top one or two operand stack values */
+/* get or set the value of a static field, at the resolved address of ins */
 static int
-opdup2(Frame *frame)
+opstaticquick(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
-
-	v1 = frame_stackpop(frame);
-	v2 = frame_stackpop(frame);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
+	Value *p;
 
-/* dup2_x1: duplicate the top one or two operand stack values and insert two or three values down */
-static int
-opdup2_x1(Frame *frame)
-{
-	Value v1, v2, v3;
-
-	v1 = frame_stackpop(frame);
-	v2 = frame_stackpop(frame);
-	v3 = frame_stackpop(frame);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
-	frame_stackpush(frame, v3);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
+	p = ins->p;
+	switch (ins->op) {
+	case GETSTATIC_WIDE:
+		frame_stackpush(frame, *p);
+		/* FALLTHROUGH */
+	case GETSTATIC_QUICK:
+		frame_stackpush(frame, *p);
+		break;
+	case PUTSTATIC_WIDE:
+		(void)frame_stackpop(frame);
+		/* FALLTHROUGH */
+	case PUTSTATIC_QUICK:
+		*p = frame_stackpop(frame);
+		break;
+	}
 	return NO_RETURN;
 }
 
-/* dup2_x2: duplicate the top one or two operand stack values and insert two, three or four values down */
+/* getstatic: get static field from class; quicken the instruction */
 static int
-opdup2_x2(Frame *frame)
+opgetstatic(Frame *frame, Instr *ins)
 {
-	Value v1, v2, v3, v4;
-
-	v1 = frame_stackpop(frame);
-	v2 = frame_stackpop(frame);
-	v3 = frame_stackpop(frame);
-	v4 = frame_stackpop(frame);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
-	frame_stackpush(frame, v4);
-	frame_stackpush(frame, v3);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	staticquicken(frame, ins);
+	return opstaticquick(frame, ins);
 }
 
-/* dup_x1: duplicate the top operand stack value and insert two values down */
+/* putstatic: set static field in class; quicken the instruction */
 static int
-opdup_x1(Frame *frame)
+opputstatic(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
-
-	v1 = frame_stackpop(frame);
-	v2 = frame_stackpop(frame);
-	frame_stackpush(frame, v1);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	staticquicken(frame, ins);
+	return opstaticquick(frame, ins);
 }
 
-/* dup_x2: duplicate the top operand stack value and insert two or three values down */
-static int
-opdup_x2(Frame *frame)
+/* resolve reference to instance field at index; set *type to the descriptor of the field */
+static Field *
+resolveinstfield(ClassFile *class, U2 index, char **type)
 {
-	Value v1, v2, v3;
+	CONSTANT_Fieldref_info *fieldref;
+	Field *field;
+	char *name;
 
-	v1 = frame_stackpop(frame);
-	v2 = frame_stackpop(frame);
-	v3 = frame_stackpop(frame);
-	frame_stackpush(frame, v1);
-	frame_stackpush(frame, v3);
-	frame_stackpush(frame, v2);
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	fieldref = &class->constant_pool[index]->info.fieldref_info;
+	class_getnameandtype(class, fieldref->name_and_type_index, &name, type);
+	class = classresolve(class, fieldref->class_index);
+	if ((field = class_lookupfield(class, name, *type, NULL)) == NULL || (field->access_flags & ACC_STATIC))
+		errx(EXIT_FAILURE, "could not resolve field %s", name);
+	return field;
 }
 
-/* swap: swap the top two operand stack values */
-static int
-opswap(Frame *frame)
+/* quicken getfield or putfield ins into an access, of the width of the field, at the offset of the field */
+static void
+fieldquicken(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
+	Field *field;
+	char *type;
+	int get;
 
-	v1 = frame_stackpop(frame);
-	v2 = frame_stackpop(frame);
-	frame_stackpush(frame, v1);
-	frame_stackpush(frame, v2);
-	return NO_RETURN;
+	get = (ins->op == GETFIELD);
+	field = resolveinstfield(frame->class, ins->u, &type);
+	ins->i = field->offset;
+	switch (*type) {
+	case TYPE_BYTE:
+	case TYPE_BOOLEAN:
+		ins->op = get ? GETFIELD_BYTE : PUTFIELD_BYTE;
+		break;
+	case TYPE_CHAR:
+		ins->op = get ? GETFIELD_CHAR : PUTFIELD_SHORT;
+		break;
+	case TYPE_SHORT:
+		ins->op = get ? GETFIELD_SHORT : PUTFIELD_SHORT;
+		break;
+	case TYPE_INT:
+	case TYPE_FLOAT:
+		ins->op = get ? GETFIELD_INT : PUTFIELD_INT;
+		break;
+	case TYPE_LONG:
+	case TYPE_DOUBLE:
+		ins->op = get ? GETFIELD_LONG : PUTFIELD_LONG;
+		break;
+	default:
+		ins->op = get ? GETFIELD_REF : PUTFIELD_REF;
+		break;
+	}
 }
 
-/* ishl: shift left int */
+/* get or set field at the resolved offset of ins, of the instance on the operand stack */
 static int
-opishl(Frame *frame)
+opfieldquick(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
+	Value v, obj;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i <<= v2.i;
-	frame_stackpush(frame, v1);
+	if (ins->op >= PUTFIELD_BYTE) {
+		v = frame_stackpop(frame);
+		if (ins->op == PUTFIELD_LONG)
+			v = frame_stackpop(frame);
+		obj = frame_stackpop(frame);
+		switch (ins->op) {
+		case PUTFIELD_BYTE:
+			FIELD(int8_t, obj.v, ins->i) = v.i;
+			break;
+		case PUTFIELD_SHORT:
+			FIELD(int16_t, obj.v, ins->i) = v.i;
+			break;
+		case PUTFIELD_INT:
+			FIELD(int32_t, obj.v, ins->i) = v.i;
+			break;
+		case PUTFIELD_LONG:
+			FIELD(int64_t, obj.v, ins->i) = v.l;
+			break;
+		case PUTFIELD_REF:
+			HEAP_FIELDBARRIER(obj.v, ins->i, v.v);
+			heap_putfield(obj.v, ins->i, v.v);
+			break;
+		}
+		return NO_RETURN;
+	}
+	obj = frame_stackpop(frame);
+	switch (ins->op) {
+	case GETFIELD_BYTE:
+		v.i = FIELD(int8_t, obj.v, ins->i);
+		break;
+	case GETFIELD_CHAR:
+		v.i = FIELD(uint16_t, obj.v, ins->i);
+		break;
+	case GETFIELD_SHORT:
+		v.i = FIELD(int16_t, obj.v, ins->i);
+		break;
+	case GETFIELD_INT:
+		v.i = FIELD(int32_t, obj.v, ins->i);
+		break;
+	case GETFIELD_LONG:
+		v.l = FIELD(int64_t, obj.v, ins->i);
+		frame_stackpush(frame, v);
+		break;
+	case GETFIELD_REF:
+		v.v = heap_getfield(obj.v, ins->i);
+		break;
+	}
+	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* lshl: shift left long */
+/* getfield: get field from object; quicken the instruction */
 static int
-oplshl(Frame *frame)
+opgetfield(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l <<= v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	fieldquicken(frame, ins);
+	return opfieldquick(frame, ins);
 }
 
-/* ishr: arithmetic shift right int */
+/* putfield: set field in object; quicken the instruction */
 static int
-opishr(Frame *frame)
+opputfield(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i >>= v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	fieldquicken(frame, ins);
+	return opfieldquick(frame, ins);
 }
 
-/* lshr: arithmetic shift right long */
+/* create instance of resolved class */
 static int
-oplshr(Frame *frame)
+opnewquick(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
+	ClassFile *class;
+	Value v;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l >>= v2.l;
-	frame_stackpush(frame, v1);
+	class = ins->p;
+	gcpoint(HEAP_HEADER + sizeof (int64_t) - 1 + class->instsize);
+	if ((v.v = object_new(class)) == NULL)
+		errx(EXIT_FAILURE, "out of memory");
+	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* iushr: logical shift right int */
+/* new: create new object; quicken the instruction */
 static int
-opiushr(Frame *frame)
+opnew(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i = (unsigned)v1.i >> v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	ins->p = classresolve(frame->class, ins->u);
+	ins->op = NEW_QUICK;
+	return opnewquick(frame, ins);
 }
 
-/* lushr: logical shift right long */
+/* invoke resolved method */
 static int
-oplushr(Frame *frame)
+opinvokequick(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
+	Callsite *site;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l = (unsigned)v1.l >> v2.l;
-	frame_stackpush(frame, v1);
+	site = ins->p;
+	(void)codecall(site->class, frame, site->code, site->nargs, site->nret);
 	return NO_RETURN;
 }
 
-/* iand: boolean AND int */
-static int
-opiand(Frame *frame)
+/* select the method a virtual call site invokes on an object of the given class */
+static void
+virtualselect(Callsite *site, ClassFile *receiver, ClassFile **class, Code_attribute **code)
 {
-	Value v1, v2;
+	Method *method;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i &= v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	for (; receiver != NULL; receiver = receiver->super) {
+		if ((method = class_getmethod(receiver, site->name, site->descriptor)) != NULL &&
+		    !(method->access_flags & ACC_STATIC) && method->code != NULL) {
+			*class = receiver;
+			*code = method->code;
+			return;
+		}
+	}
+	*class = site->class;
+	*code = site->code;
 }
 
-/* ior: boolean OR int */
-static int
-opior(Frame *frame)
+/* get the method a virtual call site invokes on the receiver obj, through the inline cache */
+static void
+virtualtarget(Callsite *site, Heap *obj, ClassFile **class, Code_attribute **code)
 {
-	Value v1, v2;
+	ClassFile *receiver;
+	U2 i;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i |= v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	receiver = (obj != NULL) ? obj->class : NULL;
+	if (site->ncache <= NCACHE) {
+		for (i = 0; i < site->ncache; i++) {
+			if (site->cache[i].receiver == receiver) {
+				site->hits++;
+				*class = site->cache[i].class;
+				*code = site->cache[i].code;
+				return;
+			}
+		}
+	}
+	site->misses++;
+	virtualselect(site, receiver, class, code);
+	if (site->ncache < NCACHE) {
+		site->cache[site->ncache].receiver = receiver;
+		site->cache[site->ncache].class = *class;
+		site->cache[site->ncache].code = *code;
+		site->ncache++;
+	} else {
+		site->ncache = NCACHE + 1;
+	}
 }
 
-/* ixor: boolean XOR int */
+/* invoke resolved instance method on the class of the receiver, through the inline cache */
 static int
-opixor(Frame *frame)
+opinvokevirtualquick(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
+	Callsite *site;
+	ClassFile *class;
+	Code_attribute *code;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i ^= v2.i;
-	frame_stackpush(frame, v1);
+	site = ins->p;
+	virtualtarget(site, frame->stack[frame->nstack - site->nargs].v, &class, &code);
+	(void)codecall(class, frame, code, site->nargs, site->nret);
 	return NO_RETURN;
 }
 
-/* f2d: convert float to double */
+/* invoke resolved native method */
 static int
-opf2d(Frame *frame)
+opinvokenative(Frame *frame, Instr *ins)
 {
-	Value v;
+	Callsite *site;
 
-	v = frame_stackpop(frame);
-	v.d = v.f;
-	frame_stackpush(frame, v);
+	site = ins->p;
+	site->native(frame);
 	return NO_RETURN;
 }
 
-/* f2i: convert float to int */
-static int
-opf2i(Frame *frame)
+/*
+ * resolve the method invoked by invokestatic, invokespecial or
+ * invokevirtual ins, and quicken ins into a call of it; the method of
+ * invokespecial is not selected by the receiver, so it is called as a
+ * static method is, with the receiver as its first argument
+ */
+static Callsite *
+invokeresolve(Frame *frame, Instr *ins)
 {
-	Value v;
+	Callsite *site;
 
-	v = frame_stackpop(frame);
-	v.i = v.f;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	// TODO: method must not be an instance initialization method,
+	//       or the class or interface initialization method.
+	if (ins->op == INVOKESTATIC || ins->op == INVOKESPECIAL) {
+		site = resolvemethod(frame->class, ins->u, (ins->op == INVOKESTATIC) ? ACC_STATIC : ACC_NONE);
+		ins->op = (site->native != NULL) ? INVOKESTATIC_NATIVE : INVOKESTATIC_QUICK;
+	} else {
+		site = resolvemethod(frame->class, ins->u, ACC_NONE);
+		ins->op = INVOKEVIRTUAL_NATIVE;
+		if (site->native == NULL) {
+			ins->op = INVOKEVIRTUAL_QUICK;
+			site->caller = frame->class;
+			site->callercode = frame->code;
+			site->callerpc = ins - frame->code->instr;
+		}
+	}
+	ins->p = site;
+	return site;
 }
 
-/* f2l: convert float to long */
+/* invokestatic or invokespecial: invoke a class (static) method, or an instance method of a known class; quicken the call site */
 static int
-opf2l(Frame *frame)
+opinvokestatic(Frame *frame, Instr *ins)
 {
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.l = v.f;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	if (invokeresolve(frame, ins)->native != NULL)
+		return opinvokenative(frame, ins);
+	return opinvokequick(frame, ins);
 }
 
-/* fadd: add float */
+/* invokevirtual: invoke instance method; quicken the call site */
 static int
-opfadd(Frame *frame)
+opinvokevirtual(Frame *frame, Instr *ins)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.f += v2.f;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	if (invokeresolve(frame, ins)->native != NULL)
+		return opinvokenative(frame, ins);
+	return opinvokevirtualquick(frame, ins);
 }
 
-/* faload: load float from array */
+/* multianewarray: create new multidimensional array */
 static int
-opfaload(Frame *frame)
+opmultianewarray(Frame *frame, Instr *ins)
 {
-	Value va, vi, v;
+	Value v;
+	Heap *h;
+	char *type;
+	int32_t *sizes;
+	U1 i, dimension;
+	size_t s, n, total;
 
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
+	dimension = ins->i;
+	sizes = ecalloc(dimension, sizeof *sizes);
+	type = class_getclassname(frame->class, ins->u);
+	switch (type[dimension]) {
+	case TYPE_REFERENCE:
+	case TYPE_ARRAY:
+		s = HEAP_REFSIZE;
+		break;
+	case TYPE_DOUBLE:
+	case TYPE_LONG:
+		s = sizeof (int64_t);
+		break;
+	default:
+		s = sizeof (int32_t);
+		break;
+	}
+	for (i = 0; i < dimension; i++) {
+		v = frame_stackpop(frame);
+		if (v.i < 0) {
+			// TODO: throw NegativeArraySizeException
+		}
+		if (v.i == 0) {
+			// TODO: handle zero size
+		}
+		sizes[dimension - i - 1] = v.i;
 	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
+	/* each array is a header and its elements, rounded to the alignment of objects */
+	for (n = 1, total = 0, i = 0; i < dimension; i++) {
+		total += n * (HEAP_HEADER + sizeof (int64_t) - 1);
+		if (sizes[i] <= 0)
+			break;
+		n *= sizes[i];
+		total += n * (i + 1 < dimension ? HEAP_REFSIZE : s);
 	}
-	v.f = ((float *)va.v->obj)[vi.i];
+	gcpoint(total);
+	h = array_new(sizes, dimension, s, type[dimension] == TYPE_REFERENCE || type[dimension] == TYPE_ARRAY);
+	free(sizes);
+	if (h == NULL)
+		errx(EXIT_FAILURE, "out of memory");
+	v.v = h;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* fastore: store into float array */
+/* newarray: create new array */
 static int
-opfastore(Frame *frame)
-{
-	Value va, vi, vv;
-
-	vv = frame_stackpop(frame);
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((float *)va.v->obj)[vi.i] = vv.f;
-	return NO_RETURN;
-}
-
-/* fcmpg: compare float */
-static int
-opfcmpg(Frame *frame)
-{
-	Value v1, v2, v;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.f > v2.f)
-		v.i = 1;
-	else if (v1.f == v2.f)
-		v.i = 0;
-	else if (v1.f < v2.f)
-		v.i = -1;
-	else
-		v.i = 1;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* fcmpl: compare float */
-static int
-opfcmpl(Frame *frame)
-{
-	Value v1, v2, v;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.f > v2.f)
-		v.i = 1;
-	else if (v1.f == v2.f)
-		v.i = 0;
-	else if (v1.f < v2.f)
-		v.i = -1;
-	else
-		v.i = -1;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* fconst_0: push float 0 into stack */
-static int
-opfconst_0(Frame *frame)
-{
-	Value v;
-
-	v.f = 0.0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* fconst_1: push float 1 into stack */
-static int
-opfconst_1(Frame *frame)
-{
-	Value v;
-
-	v.f = 1.0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* fconst_2: push float 2 into stack */
-static int
-opfconst_2(Frame *frame)
-{
-	Value v;
-
-	v.f = 2.0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* fdiv: divide float */
-static int
-opfdiv(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.f /= v2.f;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* fmul: multiply float */
-static int
-opfmul(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.f *= v2.f;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* fneg: negate float */
-static int
-opfneg(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.f = -v.f;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* frem: remainder float */
-static int
-opfrem(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.f = fmodf(v1.f, v2.f);
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* fsub: subtract float */
-static int
-opfsub(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.f -= v2.f;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* getstatic: get static field from class */
-static int
-opgetstatic(Frame *frame)
-{
-	CONSTANT_Fieldref_info *fieldref;
-	CP *cp;
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	fieldref = &frame->class->constant_pool[i]->info.fieldref_info;
-	cp = resolvefield(frame->class, fieldref, &v.v);
-	if (cp != NULL) {
-		switch (cp->tag) {
-		case CONSTANT_Integer:
-			v.i = getint(cp->info.integer_info.bytes);
-			break;
-		case CONSTANT_Long:
-			v.l = getlong(cp->info.long_info.high_bytes, cp->info.long_info.low_bytes);
-			break;
-		case CONSTANT_Float:
-			v.f = getfloat(cp->info.float_info.bytes);
-			break;
-		case CONSTANT_Double:
-			v.d = getdouble(cp->info.double_info.high_bytes, cp->info.double_info.low_bytes);
-			break;
-		case CONSTANT_String:
-			v.v = heap_alloc(0, 0);
-			v.v->obj = cp->info.string_info.string;
-			break;
-		}
-	}
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* goto: branch always */
-static int
-opgoto(Frame *frame)
-{
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	memcpy(&off, &i, sizeof(off));
-	frame->pc = base + off;
-	return NO_RETURN;
-}
-
-/* goto: branch always (wide intex) */
-static int
-opgoto_w(Frame *frame)
-{
-	int16_t off = 0;
-	U4 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 24;
-	i |= frame->code->code[frame->pc++] << 16;
-	i |= frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	memcpy(&off, &i, sizeof(off));
-	frame->pc = base + off;
-	return NO_RETURN;
-}
-
-/* i2b: convert int to byte */
-static int
-opi2b(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.i = v.i & UINT8_MAX;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* i2s: convert int to short */
-static int
-opi2s(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.i = v.i & UINT16_MAX;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* i2l: convert int to long */
-static int
-opi2l(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.l = v.i;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* i2f: convert int to float */
-static int
-opi2f(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.f = v.i;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* i2c: convert int to char */
-static int
-opi2c(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.i = v.i & UINT8_MAX;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* i2d: convert int to double */
-static int
-opi2d(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.d = v.i;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iadd: add int */
-static int
-opiadd(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i += v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* iaload: load int from array */
-static int
-opiaload(Frame *frame)
-{
-	Value va, vi, v;
-
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	v.i = ((int *)va.v->obj)[vi.i];
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iastore: store into int array */
-static int
-opiastore(Frame *frame)
-{
-	Value va, vi, vv;
-
-	vv = frame_stackpop(frame);
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
-	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
-	}
-	((int *)va.v->obj)[vi.i] = vv.i;
-	return NO_RETURN;
-}
-
-/* iconst_0: push int 0 into stack */
-static int
-opiconst_0(Frame *frame)
-{
-	Value v;
-
-	v.i = 0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iconst_1: push int 1 into stack */
-static int
-opiconst_1(Frame *frame)
-{
-	Value v;
-
-	v.i = 1;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iconst_2: push int 2 into stack */
-static int
-opiconst_2(Frame *frame)
-{
-	Value v;
-
-	v.i = 2;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iconst_3: push int 3 into stack */
-static int
-opiconst_3(Frame *frame)
-{
-	Value v;
-
-	v.i = 3;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iconst_4: push int 4 into stack */
-static int
-opiconst_4(Frame *frame)
-{
-	Value v;
-
-	v.i = 4;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iconst_5: push int 5 into stack */
-static int
-opiconst_5(Frame *frame)
-{
-	Value v;
-
-	v.i = 5;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iconst_m1: push int -1 into stack */
-static int
-opiconst_m1(Frame *frame)
-{
-	Value v;
-
-	v.i = -1;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* idiv: divide int */
-static int
-opidiv(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i /= v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* if_acmpeq: branch if reference comparison succeeds */
-static int
-opif_acmpeq(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.v == v2.v) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* if_acmpne: branch if reference comparison succeeds */
-static int
-opif_acmpne(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.v != v2.v) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* if_icmpeq: branch if int comparison succeeds */
-static int
-opif_icmpeq(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.i == v2.i) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* if_icmpge: branch if int comparison succeeds */
-static int
-opif_icmpge(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.i >= v2.i) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* if_icmpgt: branch if int comparison succeeds */
-static int
-opif_icmpgt(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.i > v2.i) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* if_icmple: branch if int comparison succeeds */
-static int
-opif_icmple(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.i <= v2.i) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* if_icmplt: branch if int comparison succeeds */
-static int
-opif_icmplt(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.i < v2.i) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* if_icmpne: branch if int comparison succeeds */
-static int
-opif_icmpne(Frame *frame)
-{
-	Value v1, v2;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.i != v2.i) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* ifeq: branch if int comparison with zero succeeds */
-static int
-opifeq(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.i == 0) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* ifne: branch if int comparison with zero succeeds */
-static int
-opifne(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.i != 0) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* ifge: branch if int comparison with zero succeeds */
-static int
-opifge(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.i >= 0) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* ifgt: branch if int comparison with zero succeeds */
-static int
-opifgt(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.i > 0) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* ifle: branch if int comparison with zero succeeds */
-static int
-opifle(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.i <= 0) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* iflt: branch if int comparison with zero succeeds */
-static int
-opiflt(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.i < 0) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* iinc: increment local variable by constant */
-static int
-opiinc(Frame *frame)
-{
-	Value v;
-	U1 i;
-	int8_t c;
-
-	i = frame->code->code[frame->pc++];
-	c = (int8_t)frame->code->code[frame->pc++];
-	v = frame_localload(frame, i);
-	v.i += c;
-	frame_localstore(frame, i, v);
-	return NO_RETURN;
-}
-
-/* iload: load int from local variable */
-static int
-opiload(Frame *frame)
-{
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++];
-	v = frame_localload(frame, i);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iload_0: load int from local variable */
-static int
-opiload_0(Frame *frame)
-{
-	Value v;
-
-	v = frame_localload(frame, 0);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iload_1: load int from local variable */
-static int
-opiload_1(Frame *frame)
-{
-	Value v;
-
-	v = frame_localload(frame, 1);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iload_2: load int from local variable */
-static int
-opiload_2(Frame *frame)
-{
-	Value v;
-
-	v = frame_localload(frame, 2);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* iload_3: load int from local variable */
-static int
-opiload_3(Frame *frame)
-{
-	Value v;
-
-	v = frame_localload(frame, 3);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* imul: multiply int */
-static int
-opimul(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i *= v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* ineg: negate int */
-static int
-opineg(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.i = -v.i;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* ifnonnull: branch if reference is not null */
-static int
-opifnonnull(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.v != NULL) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* ifnull: branch if reference is null */
-static int
-opifnull(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	if (v.v == NULL) {
-		memcpy(&off, &i, sizeof off);
-		frame->pc = base + off;
-	}
-	return NO_RETURN;
-}
-
-/* invokestatic: invoke a class (static) method */
-static int
-opinvokestatic(Frame *frame)
-{
-	CONSTANT_Methodref_info *methodref;
-	ClassFile *class;
-	enum JavaClass jclass;
-	char *classname, *name, *type;
-	U2 i;
-
-	// TODO: method must not be an instance initialization method,
-	//       or the class or interface initialization method.
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	methodref = &frame->class->constant_pool[i]->info.methodref_info;
-	classname = class_getclassname(frame->class, methodref->class_index);
-	class_getnameandtype(frame->class, methodref->name_and_type_index, &name, &type);
-	if ((jclass = native_javaclass(classname)) != NONE_CLASS) {
-		native_javamethod(frame, jclass, name, type);
-	} else if ((class = classload(classname)) != NULL) {
-		if (methodcall(class, frame, name, type, ACC_STATIC) == -1) {
-			errx(EXIT_FAILURE, "could not find method %s", name);
-		}
-	} else {
-		errx(EXIT_FAILURE, "could not load class %s", classname);
-	}
-	return NO_RETURN;
-}
-
-/* invokevirtual: invoke instance method; dispatch based on class */
-static int
-opinvokevirtual(Frame *frame)
-{
-	CONSTANT_Methodref_info *methodref;
-	ClassFile *class;
-	enum JavaClass jclass;
-	char *classname, *name, *type;
-	U2 i;
-
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	methodref = &frame->class->constant_pool[i]->info.methodref_info;
-	classname = class_getclassname(frame->class, methodref->class_index);
-	class_getnameandtype(frame->class, methodref->name_and_type_index, &name, &type);
-	if ((jclass = native_javaclass(classname)) != NONE_CLASS) {
-		if (native_javamethod(frame, jclass, name, type) == -1) {
-			errx(EXIT_FAILURE, "error invoking native method %s", name);
-		}
-	} else if ((class = classload(classname)) != NULL) {
-		if (methodcall(class, NULL, name, type, ACC_STATIC) == -1) {
-			errx(EXIT_FAILURE, "could not find method %s", name);
-		}
-	} else {
-		errx(EXIT_FAILURE, "could not load class %s", classname);
-	}
-	return NO_RETURN;
-}
-
-/* irem: remainder int */
-static int
-opirem(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i = v1.i - (v1.i / v2.i) * v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* ireturn: return something from method */
-static int
-opireturn(Frame *frame)
-{
-	(void)frame;
-	return RETURN_OPERAND;
-}
-
-/* store: store into local variable */
-static int
-opistore(Frame *frame)
-{
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	frame_localstore(frame, i, v);
-	return NO_RETURN;
-}
-
-/* istore_0: store int into local variable */
-static int
-opistore_0(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 0, v);
-	return NO_RETURN;
-}
-
-/* istore_1: store int into local variable */
-static int
-opistore_1(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 1, v);
-	return NO_RETURN;
-}
-
-/* istore_2: store int into local variable */
-static int
-opistore_2(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 2, v);
-	return NO_RETURN;
-}
-
-/* istore_3: store int into local variable */
-static int
-opistore_3(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 3, v);
-	return NO_RETURN;
-}
-
-/* isub: subtract int */
-static int
-opisub(Frame *frame)
-{
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.i -= v2.i;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* jsr: jump subroutine */
-static int
-opjsr(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U2 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	memcpy(&off, &i, sizeof off);
-	frame->pc = base + off;
-	v.i = base + 2;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* jsr: jump subroutine (wide index) */
-static int
-opjsr_w(Frame *frame)
-{
-	Value v;
-	int16_t off = 0;
-	U4 base, i;
-
-	base = frame->pc - 1;
-	i = frame->code->code[frame->pc++] << 24;
-	i |= frame->code->code[frame->pc++] << 16;
-	i |= frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	memcpy(&off, &i, sizeof off);
-	frame->pc = base + off;
-	v.i = base + 4;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* l2d: convert long to double */
-static int
-opl2d(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.d = v.l;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* l2f: convert long to float */
-static int
-opl2f(Frame *frame)
+opnewarray(Frame *frame, Instr *ins)
 {
 	Value v;
+	Heap *h;
+	size_t s;
 
 	v = frame_stackpop(frame);
-	v.f = v.l;
+	switch (ins->u) {
+	case T_LONG:
+		s = sizeof (int64_t);
+		break;
+	case T_DOUBLE:
+		s = sizeof (double);
+		break;
+	case T_FLOAT:
+		s = sizeof (float);
+		break;
+	default:
+		s = sizeof (int32_t);
+		break;
+	}
+	if (v.i < 0) {
+		// TODO: throw NegativeArraySizeException
+	}
+	if (v.i == 0) {
+		// TODO: handle zero size
+	}
+	gcpoint(HEAP_HEADER + sizeof (int64_t) - 1 + (v.i > 0 ? (size_t)v.i * s : 0));
+	if ((h = array_new(&v.i, 1, s, 0)) == NULL)
+		errx(EXIT_FAILURE, "out of memory");
+	v.v = h;
 	frame_stackpush(frame, v);
 	return NO_RETURN;
 }
 
-/* l2i: convert long to int */
+/* run instruction of the decoded code on the operand stack of frame */
 static int
-opl2i(Frame *frame)
+opstack(Frame *frame, Instr *ins)
 {
 	Value v;
 
-	v = frame_stackpop(frame);
-	v.i = v.l;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	frame->pc = ins - frame->code->instr + 1;
+	switch (ins->op) {
+	case GETSTATIC:
+		return opgetstatic(frame, ins);
+	case PUTSTATIC:
+		return opputstatic(frame, ins);
+	case GETFIELD:
+		return opgetfield(frame, ins);
+	case PUTFIELD:
+		return opputfield(frame, ins);
+	case GETFIELD_BYTE: case GETFIELD_CHAR: case GETFIELD_SHORT:
+	case GETFIELD_INT: case GETFIELD_LONG: case GETFIELD_REF:
+	case PUTFIELD_BYTE: case PUTFIELD_SHORT: case PUTFIELD_INT:
+	case PUTFIELD_LONG: case PUTFIELD_REF:
+		return opfieldquick(frame, ins);
+	case GETSTATIC_QUICK: case GETSTATIC_WIDE:
+	case PUTSTATIC_QUICK: case PUTSTATIC_WIDE:
+		return opstaticquick(frame, ins);
+	case INVOKESTATIC:
+	case INVOKESPECIAL:
+		return opinvokestatic(frame, ins);
+	case INVOKEVIRTUAL:
+		return opinvokevirtual(frame, ins);
+	case INVOKESTATIC_QUICK:
+		return opinvokequick(frame, ins);
+	case INVOKEVIRTUAL_QUICK:
+		return opinvokevirtualquick(frame, ins);
+	case INVOKESTATIC_NATIVE:
+	case INVOKEVIRTUAL_NATIVE:
+		return opinvokenative(frame, ins);
+	case NEW:
+		return opnew(frame, ins);
+	case NEW_QUICK:
+		return opnewquick(frame, ins);
+	case NEWARRAY:
+		return opnewarray(frame, ins);
+	case MULTIANEWARRAY:
+		return opmultianewarray(frame, ins);
+	case LDC_STRING:
+		frame_stackpush(frame, resolveconstant(frame->class, ins->u));
+		return NO_RETURN;
+	case ACONST_NULL:
+		v.v = NULL;
+		frame_stackpush(frame, v);
+		return NO_RETURN;
+	}
+	errx(EXIT_FAILURE, "instruction %02x not implemented (yet)", ins->op);
+	return RETURN_ERROR;
+}
+
+/* get index of the case matching key among the n cases of a lookupswitch, sorted by key; or n if none matches */
+static U4
+switchcase(Instr *cases, U4 n, I4 key)
+{
+	U4 lo, hi, mid;
+
+	lo = 0;
+	hi = n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (cases[mid].v.i < key)
+			lo = mid + 1;
+		else if (cases[mid].v.i > key)
+			hi = mid;
+		else
+			return mid;
+	}
+	return n;
 }
 
-/* ladd: add long */
+/* check whether instruction returns from its method */
 static int
-opladd(Frame *frame)
+isreturn(U2 op)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l += v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	return op >= IRETURN && op <= RETURN;
 }
 
-/* laload: load long from array */
+/*
+ * Count the backward branch ins, just taken, and either run the
+ * compiled trace of its loop, leaving the frame where the trace exits,
+ * or start recording the loop once the branch gets hot.  Return whether
+ * a recording started.
+ */
 static int
-oplaload(Frame *frame)
+tracebranch(Frame *frame, Instr *ins)
 {
-	Value va, vi, v;
+	Trace *trace;
 
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
+	if (interponly || tos || oppairs != NULL || recorder.trace != NULL || !frame->code->verified)
+		return 0;
+	if ((trace = ins->p) == NULL) {
+		trace = ecalloc(1, sizeof *trace);
+		trace->head = frame->pc;
+		trace->next = traces;
+		traces = trace;
+		ins->p = trace;
 	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
+	if (trace->jitcode != NULL) {
+		(void)trace->jitcode(frame);
+		return 0;
 	}
-	v.l = ((long *)va.v->obj)[vi.i];
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	if (++trace->count % TRACETHRESHOLD != 0 || trace->count > TRACETHRESHOLD * TRACETRIES)
+		return 0;
+	if (recorder.entries == NULL)
+		recorder.entries = ecalloc(TRACEMAX, sizeof *recorder.entries);
+	recorder.trace = trace;
+	recorder.frame = frame;
+	recorder.n = 0;
+	return 1;
+}
+
+/*
+ * Record instruction ins, about to be run on frame with the operand
+ * stack top at sp.  The recording is over, and 0 is returned, when the
+ * loop header is reached again, when the method containing the loop
+ * returns or when the trace gets too long.
+ */
+static int
+tracerecord(Frame *frame, Instr *ins, Value *sp)
+{
+	Traceentry *entry;
+	Callsite *site;
+	Heap *obj;
+
+	if (recorder.trace == NULL)
+		return 0;
+	if (!frame->code->verified) {
+		recorder.trace = NULL;
+		return 0;
+	}
+	if (frame == recorder.frame) {
+		if (recorder.n > 0 && ins == frame->code->instr + recorder.trace->head) {
+			tracecompile(recorder.trace, frame, recorder.entries, recorder.n);
+			recorder.trace = NULL;
+			return 0;
+		}
+		if (isreturn(ins->op)) {
+			recorder.trace = NULL;
+			return 0;
+		}
+	}
+	if (recorder.n == TRACEMAX) {
+		recorder.trace = NULL;
+		return 0;
+	}
+	entry = &recorder.entries[recorder.n++];
+	entry->ins = ins;
+	entry->inlined = (frame != recorder.frame);
+	entry->receiver = NULL;
+	if (ins->op == INVOKEVIRTUAL_QUICK) {
+		site = ins->p;
+		obj = sp[-site->nargs].v;
+		entry->receiver = (obj != NULL) ? obj->class : NULL;
+	}
+	return 1;
 }
 
-/* land: boolean AND long */
-static int
-opland(Frame *frame)
+/*
+ * Check that instruction ins of unverified code, about to be run on
+ * frame with the operand stack top at sp, finds its operands on the
+ * operand stack and room there for its results, and that the local
+ * variable it uses exists.  Verified code needs none of these checks.
+ */
+static void
+checkinstr(Frame *frame, Instr *ins, Value *sp)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l &= v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
+	size_t depth, pops, pushes, wide;
+	char *s;
 
-/* lastore: store into long array */
-static int
-oplastore(Frame *frame)
-{
-	Value va, vi, vv;
+	depth = sp - frame->stack;
+	pops = pushes = wide = 0;
+	switch (ins->op) {
+	case LLOAD: case DLOAD:
+	case LLOAD_0: case LLOAD_1: case LLOAD_2: case LLOAD_3:
+	case DLOAD_0: case DLOAD_1: case DLOAD_2: case DLOAD_3:
+		pushes = wide = 1;
+		/* FALLTHROUGH */
+	case ILOAD: case FLOAD: case ALOAD:
+	case ILOAD_0: case ILOAD_1: case ILOAD_2: case ILOAD_3:
+	case FLOAD_0: case FLOAD_1: case FLOAD_2: case FLOAD_3:
+	case ALOAD_0: case ALOAD_1: case ALOAD_2: case ALOAD_3:
+		pushes++;
+		goto local;
+	case LSTORE: case DSTORE:
+	case LSTORE_0: case LSTORE_1: case LSTORE_2: case LSTORE_3:
+	case DSTORE_0: case DSTORE_1: case DSTORE_2: case DSTORE_3:
+		pops = wide = 1;
+		/* FALLTHROUGH */
+	case ISTORE: case FSTORE: case ASTORE:
+	case ISTORE_0: case ISTORE_1: case ISTORE_2: case ISTORE_3:
+	case FSTORE_0: case FSTORE_1: case FSTORE_2: case FSTORE_3:
+	case ASTORE_0: case ASTORE_1: case ASTORE_2: case ASTORE_3:
+		pops++;
+		/* FALLTHROUGH */
+	case IINC:
+	case RET:
+local:
+		if (ins->u + wide >= frame->max_locals)
+			errx(EXIT_FAILURE, "invalid local variable");
+		break;
+	case POP:       pops = 1; break;
+	case POP2:      pops = 2; break;
+	case DUP:       pops = 1; pushes = 2; break;
+	case DUP_X1:    pops = 2; pushes = 3; break;
+	case DUP_X2:    pops = 3; pushes = 4; break;
+	case DUP2:      pops = 2; pushes = 4; break;
+	case DUP2_X1:   pops = 3; pushes = 5; break;
+	case DUP2_X2:   pops = 4; pushes = 6; break;
+	case SWAP:      pops = 2; pushes = 2; break;
+	default:
+		if (ins->op >= CODE_LAST || (s = opeffect[ins->op]) == NULL)
+			break;
+		for (; *s != '>'; s++)
+			pops += (*s == 'J' || *s == 'D') ? 2 : 1;
+		for (s++; *s != '\0'; s++)
+			pushes += (*s == 'J' || *s == 'D') ? 2 : 1;
+		break;
+	}
+	if (pops > depth)
+		errx(EXIT_FAILURE, "operand stack underflow");
+	if (depth - pops + pushes > frame->max_stack)
+		errx(EXIT_FAILURE, "operand stack overflow");
+}
+
+/*
+ * The dispatch loop keeps the program counter, the operand stack
+ * pointer and the local variable array in local variables; they are
+ * written back to the frame (SAVE) only around the out-of-line
+ * handlers, which still operate on the frame, and read again (LOAD)
+ * after them.
+ *
+ * With GNU C, each handler jumps directly to the next one through a
+ * table of label addresses (threaded code); otherwise, the handlers
+ * are the cases of a plain switch.  When instruction pairs are being
+ * counted (-Xoppairs), every dispatch goes through the counting code
+ * first, and so does every dispatch while a trace is being recorded.
+ * Backward branches taken go through tracebranch(), by LOOPIF().
+ * Code the verifier could not prove type-safe has each instruction
+ * checked by checkinstr() first, through its own table of labels or
+ * in the counting and recording code, and never runs with the top of
+ * the stack cached (-Xtos); verified code runs unchecked.
+ *
+ * A call of a method run by this interpreter does not recurse: the
+ * loop pushes the frame of the called method, switches to it, and
+ * switches back to the calling frame when the method returns, so the
+ * depth of Java calls is bounded by the frame stack rather than by
+ * the C stack.  Only returning from the frame the loop was entered
+ * with leaves it.  Calls of compiled methods, of methods run as
+ * register-based code and of native methods are still C calls.
+ */
+#define SAVE()          (frame->pc = pc - code, frame->nstack = sp - frame->stack)
+#define LOAD()          (pc = code + frame->pc, sp = frame->stack + frame->nstack)
+#define CALL(f)         do { SAVE(); (void)f(frame, ins); LOAD(); } while (0)
+#define BRANCHIF(c)     do { if (c) pc = code + ins->i; } while (0)
+#define LOOPIF(c)       do { if (c) { pc = code + ins->i; if (pc <= ins) goto backedge; } } while (0)
+
+#ifdef __GNUC__
+#define TARGET(op)      case op: L_##op
+#define DISPATCH()      goto *table[(ins = pc++)->op]
+#define TOSDISPATCH(n)  goto *tos##n[(ins = pc++)->op]
+#define RETABLE()       (table = (recorder.trace != NULL) ? recordlabels : \
+                                 !frame->code->verified ? checklabels : \
+                                 tos ? tos0 : labels)
+#else
+#define TARGET(op)      case op
+#define DISPATCH()      goto dispatch
+#endif
 
-	vv = frame_stackpop(frame);
-	vi = frame_stackpop(frame);
-	va = frame_stackpop(frame);
-	if (va.v->obj == NULL) {
-		// TODO: throw NullPointerException
+/* run method on frame until it returns */
+static int
+interpret(Frame *frame)
+{
+#ifdef __GNUC__
+	static void *labels[INSTR_LAST] = {
+		[NOP]             = &&L_NOP,
+		[ACONST_NULL]     = &&L_ACONST_NULL,
+		[ICONST_M1]       = &&L_ICONST_M1,
+		[ICONST_0]        = &&L_ICONST_0,
+		[ICONST_1]        = &&L_ICONST_1,
+		[ICONST_2]        = &&L_ICONST_2,
+		[ICONST_3]        = &&L_ICONST_3,
+		[ICONST_4]        = &&L_ICONST_4,
+		[ICONST_5]        = &&L_ICONST_5,
+		[LCONST_0]        = &&L_LCONST_0,
+		[LCONST_1]        = &&L_LCONST_1,
+		[FCONST_0]        = &&L_FCONST_0,
+		[FCONST_1]        = &&L_FCONST_1,
+		[FCONST_2]        = &&L_FCONST_2,
+		[DCONST_0]        = &&L_DCONST_0,
+		[DCONST_1]        = &&L_DCONST_1,
+		[BIPUSH]          = &&L_BIPUSH,
+		[SIPUSH]          = &&L_SIPUSH,
+		[LDC]             = &&L_LDC,
+		[LDC_W]           = &&L_LDC_W,
+		[LDC2_W]          = &&L_LDC2_W,
+		[ILOAD]           = &&L_ILOAD,
+		[LLOAD]           = &&L_LLOAD,
+		[FLOAD]           = &&L_FLOAD,
+		[DLOAD]           = &&L_DLOAD,
+		[ALOAD]           = &&L_ALOAD,
+		[ILOAD_0]         = &&L_ILOAD_0,
+		[ILOAD_1]         = &&L_ILOAD_1,
+		[ILOAD_2]         = &&L_ILOAD_2,
+		[ILOAD_3]         = &&L_ILOAD_3,
+		[LLOAD_0]         = &&L_LLOAD_0,
+		[LLOAD_1]         = &&L_LLOAD_1,
+		[LLOAD_2]         = &&L_LLOAD_2,
+		[LLOAD_3]         = &&L_LLOAD_3,
+		[FLOAD_0]         = &&L_FLOAD_0,
+		[FLOAD_1]         = &&L_FLOAD_1,
+		[FLOAD_2]         = &&L_FLOAD_2,
+		[FLOAD_3]         = &&L_FLOAD_3,
+		[DLOAD_0]         = &&L_DLOAD_0,
+		[DLOAD_1]         = &&L_DLOAD_1,
+		[DLOAD_2]         = &&L_DLOAD_2,
+		[DLOAD_3]         = &&L_DLOAD_3,
+		[ALOAD_0]         = &&L_ALOAD_0,
+		[ALOAD_1]         = &&L_ALOAD_1,
+		[ALOAD_2]         = &&L_ALOAD_2,
+		[ALOAD_3]         = &&L_ALOAD_3,
+		[IALOAD]          = &&L_IALOAD,
+		[LALOAD]          = &&L_LALOAD,
+		[FALOAD]          = &&L_FALOAD,
+		[DALOAD]          = &&L_DALOAD,
+		[AALOAD]          = &&L_AALOAD,
+		[BALOAD]          = &&L_BALOAD,
+		[CALOAD]          = &&L_CALOAD,
+		[SALOAD]          = &&L_SALOAD,
+		[ISTORE]          = &&L_ISTORE,
+		[LSTORE]          = &&L_LSTORE,
+		[FSTORE]          = &&L_FSTORE,
+		[DSTORE]          = &&L_DSTORE,
+		[ASTORE]          = &&L_ASTORE,
+		[ISTORE_0]        = &&L_ISTORE_0,
+		[ISTORE_1]        = &&L_ISTORE_1,
+		[ISTORE_2]        = &&L_ISTORE_2,
+		[ISTORE_3]        = &&L_ISTORE_3,
+		[LSTORE_0]        = &&L_LSTORE_0,
+		[LSTORE_1]        = &&L_LSTORE_1,
+		[LSTORE_2]        = &&L_LSTORE_2,
+		[LSTORE_3]        = &&L_LSTORE_3,
+		[FSTORE_0]        = &&L_FSTORE_0,
+		[FSTORE_1]        = &&L_FSTORE_1,
+		[FSTORE_2]        = &&L_FSTORE_2,
+		[FSTORE_3]        = &&L_FSTORE_3,
+		[DSTORE_0]        = &&L_DSTORE_0,
+		[DSTORE_1]        = &&L_DSTORE_1,
+		[DSTORE_2]        = &&L_DSTORE_2,
+		[DSTORE_3]        = &&L_DSTORE_3,
+		[ASTORE_0]        = &&L_ASTORE_0,
+		[ASTORE_1]        = &&L_ASTORE_1,
+		[ASTORE_2]        = &&L_ASTORE_2,
+		[ASTORE_3]        = &&L_ASTORE_3,
+		[IASTORE]         = &&L_IASTORE,
+		[LASTORE]         = &&L_LASTORE,
+		[FASTORE]         = &&L_FASTORE,
+		[DASTORE]         = &&L_DASTORE,
+		[AASTORE]         = &&L_AASTORE,
+		[BASTORE]         = &&L_BASTORE,
+		[CASTORE]         = &&L_CASTORE,
+		[SASTORE]         = &&L_SASTORE,
+		[POP]             = &&L_POP,
+		[POP2]            = &&L_POP2,
+		[DUP]             = &&L_DUP,
+		[DUP_X1]          = &&L_DUP_X1,
+		[DUP_X2]          = &&L_DUP_X2,
+		[DUP2]            = &&L_DUP2,
+		[DUP2_X1]         = &&L_DUP2_X1,
+		[DUP2_X2]         = &&L_DUP2_X2,
+		[SWAP]            = &&L_SWAP,
+		[IADD]            = &&L_IADD,
+		[LADD]            = &&L_LADD,
+		[FADD]            = &&L_FADD,
+		[DADD]            = &&L_DADD,
+		[ISUB]            = &&L_ISUB,
+		[LSUB]            = &&L_LSUB,
+		[FSUB]            = &&L_FSUB,
+		[DSUB]            = &&L_DSUB,
+		[IMUL]            = &&L_IMUL,
+		[LMUL]            = &&L_LMUL,
+		[FMUL]            = &&L_FMUL,
+		[DMUL]            = &&L_DMUL,
+		[IDIV]            = &&L_IDIV,
+		[LDIV]            = &&L_LDIV,
+		[FDIV]            = &&L_FDIV,
+		[DDIV]            = &&L_DDIV,
+		[IREM]            = &&L_IREM,
+		[LREM]            = &&L_LREM,
+		[FREM]            = &&L_FREM,
+		[DREM]            = &&L_DREM,
+		[INEG]            = &&L_INEG,
+		[LNEG]            = &&L_LNEG,
+		[FNEG]            = &&L_FNEG,
+		[DNEG]            = &&L_DNEG,
+		[ISHL]            = &&L_ISHL,
+		[LSHL]            = &&L_LSHL,
+		[ISHR]            = &&L_ISHR,
+		[LSHR]            = &&L_LSHR,
+		[IUSHR]           = &&L_IUSHR,
+		[LUSHR]           = &&L_LUSHR,
+		[IAND]            = &&L_IAND,
+		[LAND]            = &&L_LAND,
+		[IOR]             = &&L_IOR,
+		[LOR]             = &&L_LOR,
+		[IXOR]            = &&L_IXOR,
+		[LXOR]            = &&L_LXOR,
+		[IINC]            = &&L_IINC,
+		[I2L]             = &&L_I2L,
+		[I2F]             = &&L_I2F,
+		[I2D]             = &&L_I2D,
+		[L2I]             = &&L_L2I,
+		[L2F]             = &&L_L2F,
+		[L2D]             = &&L_L2D,
+		[F2I]             = &&L_F2I,
+		[F2L]             = &&L_F2L,
+		[F2D]             = &&L_F2D,
+		[D2I]             = &&L_D2I,
+		[D2L]             = &&L_D2L,
+		[D2F]             = &&L_D2F,
+		[I2B]             = &&L_I2B,
+		[I2C]             = &&L_I2C,
+		[I2S]             = &&L_I2S,
+		[LCMP]            = &&L_LCMP,
+		[FCMPL]           = &&L_FCMPL,
+		[FCMPG]           = &&L_FCMPG,
+		[DCMPL]           = &&L_DCMPL,
+		[DCMPG]           = &&L_DCMPG,
+		[IFEQ]            = &&L_IFEQ,
+		[IFNE]            = &&L_IFNE,
+		[IFLT]            = &&L_IFLT,
+		[IFGE]            = &&L_IFGE,
+		[IFGT]            = &&L_IFGT,
+		[IFLE]            = &&L_IFLE,
+		[IF_ICMPEQ]       = &&L_IF_ICMPEQ,
+		[IF_ICMPNE]       = &&L_IF_ICMPNE,
+		[IF_ICMPLT]       = &&L_IF_ICMPLT,
+		[IF_ICMPGE]       = &&L_IF_ICMPGE,
+		[IF_ICMPGT]       = &&L_IF_ICMPGT,
+		[IF_ICMPLE]       = &&L_IF_ICMPLE,
+		[IF_ACMPEQ]       = &&L_IF_ACMPEQ,
+		[IF_ACMPNE]       = &&L_IF_ACMPNE,
+		[GOTO]            = &&L_GOTO,
+		[JSR]             = &&L_JSR,
+		[RET]             = &&L_RET,
+		[TABLESWITCH]     = &&L_TABLESWITCH,
+		[LOOKUPSWITCH]    = &&L_LOOKUPSWITCH,
+		[IRETURN]         = &&L_IRETURN,
+		[LRETURN]         = &&L_LRETURN,
+		[FRETURN]         = &&L_FRETURN,
+		[DRETURN]         = &&L_DRETURN,
+		[ARETURN]         = &&L_ARETURN,
+		[RETURN]          = &&L_RETURN,
+		[GETSTATIC]       = &&L_GETSTATIC,
+		[PUTSTATIC]       = &&L_PUTSTATIC,
+		[GETFIELD]        = &&L_GETFIELD,
+		[PUTFIELD]        = &&L_PUTFIELD,
+		[INVOKEVIRTUAL]   = &&L_INVOKEVIRTUAL,
+		[INVOKESPECIAL]   = &&L_INVOKESPECIAL,
+		[INVOKESTATIC]    = &&L_INVOKESTATIC,
+		[INVOKEINTERFACE] = &&unimplemented,
+		[INVOKEDYNAMIC]   = &&unimplemented,
+		[NEW]             = &&L_NEW,
+		[NEWARRAY]        = &&L_NEWARRAY,
+		[ANEWARRAY]       = &&unimplemented,
+		[ARRAYLENGTH]     = &&L_ARRAYLENGTH,
+		[ATHROW]          = &&unimplemented,
+		[CHECKCAST]       = &&unimplemented,
+		[INSTANCEOF]      = &&unimplemented,
+		[MONITORENTER]    = &&unimplemented,
+		[MONITOREXIT]     = &&unimplemented,
+		[WIDE]            = &&unimplemented,
+		[MULTIANEWARRAY]  = &&L_MULTIANEWARRAY,
+		[IFNULL]          = &&L_IFNULL,
+		[IFNONNULL]       = &&L_IFNONNULL,
+		[GOTO_W]          = &&L_GOTO_W,
+		[JSR_W]           = &&L_JSR_W,
+		[LDC_STRING]              = &&L_LDC_STRING,
+		[SWITCH_CASE]             = &&unimplemented,
+		[INVOKESTATIC_QUICK]      = &&L_INVOKESTATIC_QUICK,
+		[INVOKEVIRTUAL_QUICK]     = &&L_INVOKEVIRTUAL_QUICK,
+		[INVOKESTATIC_NATIVE]     = &&L_INVOKESTATIC_NATIVE,
+		[INVOKEVIRTUAL_NATIVE]    = &&L_INVOKEVIRTUAL_NATIVE,
+		[NEW_QUICK]               = &&L_NEW_QUICK,
+		[GETFIELD_BYTE]           = &&L_GETFIELD_BYTE,
+		[GETFIELD_CHAR]           = &&L_GETFIELD_CHAR,
+		[GETFIELD_SHORT]          = &&L_GETFIELD_SHORT,
+		[GETFIELD_INT]            = &&L_GETFIELD_INT,
+		[GETFIELD_LONG]           = &&L_GETFIELD_LONG,
+		[GETFIELD_REF]            = &&L_GETFIELD_REF,
+		[PUTFIELD_BYTE]           = &&L_PUTFIELD_BYTE,
+		[PUTFIELD_SHORT]          = &&L_PUTFIELD_SHORT,
+		[PUTFIELD_INT]            = &&L_PUTFIELD_INT,
+		[PUTFIELD_LONG]           = &&L_PUTFIELD_LONG,
+		[PUTFIELD_REF]            = &&L_PUTFIELD_REF,
+		[GETSTATIC_QUICK]         = &&L_GETSTATIC_QUICK,
+		[GETSTATIC_WIDE]          = &&L_GETSTATIC_WIDE,
+		[PUTSTATIC_QUICK]         = &&L_PUTSTATIC_QUICK,
+		[PUTSTATIC_WIDE]          = &&L_PUTSTATIC_WIDE,
+		[ILOAD_ILOAD]             = &&L_ILOAD_ILOAD,
+		[ILOAD_ILOAD_IADD_ISTORE] = &&L_ILOAD_ILOAD_IADD_ISTORE,
+		[ILOAD_BIPUSH_IF_ICMPLT]  = &&L_ILOAD_BIPUSH_IF_ICMPLT,
+		[ILOAD_BIPUSH_IF_ICMPGE]  = &&L_ILOAD_BIPUSH_IF_ICMPGE,
+		[ILOAD_ILOAD_IF_ICMPLT]   = &&L_ILOAD_ILOAD_IF_ICMPLT,
+		[ILOAD_ILOAD_IF_ICMPGE]   = &&L_ILOAD_ILOAD_IF_ICMPGE,
+		[ALOAD_ILOAD_IALOAD]      = &&L_ALOAD_ILOAD_IALOAD,
+		[IINC_GOTO]               = &&L_IINC_GOTO,
+	};
+	static void *tos0[INSTR_LAST] = {
+		[ILOAD]     = &&T0_ILOAD,
+		[ILOAD_0]   = &&T0_ILOAD,
+		[ILOAD_1]   = &&T0_ILOAD,
+		[ILOAD_2]   = &&T0_ILOAD,
+		[ILOAD_3]   = &&T0_ILOAD,
+		[FLOAD]     = &&T0_ILOAD,
+		[FLOAD_0]   = &&T0_ILOAD,
+		[FLOAD_1]   = &&T0_ILOAD,
+		[FLOAD_2]   = &&T0_ILOAD,
+		[FLOAD_3]   = &&T0_ILOAD,
+		[ALOAD]     = &&T0_ILOAD,
+		[ALOAD_0]   = &&T0_ILOAD,
+		[ALOAD_1]   = &&T0_ILOAD,
+		[ALOAD_2]   = &&T0_ILOAD,
+		[ALOAD_3]   = &&T0_ILOAD,
+		[LLOAD]     = &&T0_LLOAD,
+		[LLOAD_0]   = &&T0_LLOAD,
+		[LLOAD_1]   = &&T0_LLOAD,
+		[LLOAD_2]   = &&T0_LLOAD,
+		[LLOAD_3]   = &&T0_LLOAD,
+		[DLOAD]     = &&T0_LLOAD,
+		[DLOAD_0]   = &&T0_LLOAD,
+		[DLOAD_1]   = &&T0_LLOAD,
+		[DLOAD_2]   = &&T0_LLOAD,
+		[DLOAD_3]   = &&T0_LLOAD,
+		[ICONST_M1] = &&T0_ICONST_M1,
+		[ICONST_0]  = &&T0_ICONST_M1,
+		[ICONST_1]  = &&T0_ICONST_M1,
+		[ICONST_2]  = &&T0_ICONST_M1,
+		[ICONST_3]  = &&T0_ICONST_M1,
+		[ICONST_4]  = &&T0_ICONST_M1,
+		[ICONST_5]  = &&T0_ICONST_M1,
+		[BIPUSH]    = &&T0_ICONST_M1,
+		[SIPUSH]    = &&T0_ICONST_M1,
+		[LCONST_0]  = &&T0_LCONST_0,
+		[LCONST_1]  = &&T0_LCONST_0,
+		[FCONST_0]  = &&T0_FCONST_0,
+		[FCONST_1]  = &&T0_FCONST_0,
+		[FCONST_2]  = &&T0_FCONST_0,
+		[DCONST_0]  = &&T0_DCONST_0,
+		[DCONST_1]  = &&T0_DCONST_0,
+		[LDC]       = &&T0_LDC,
+		[LDC_W]     = &&T0_LDC,
+		[LDC2_W]    = &&T0_LDC2_W,
+		[IALOAD]    = &&T0_IALOAD,
+		[BALOAD]    = &&T0_IALOAD,
+		[CALOAD]    = &&T0_IALOAD,
+		[SALOAD]    = &&T0_IALOAD,
+		[FALOAD]    = &&T0_FALOAD,
+		[AALOAD]    = &&T0_AALOAD,
+		[LALOAD]    = &&T0_LALOAD,
+		[DALOAD]    = &&T0_DALOAD,
+	};
+	static void *tos1[INSTR_LAST] = {
+		[ISTORE]      = &&T1_ISTORE,
+		[ISTORE_0]    = &&T1_ISTORE,
+		[ISTORE_1]    = &&T1_ISTORE,
+		[ISTORE_2]    = &&T1_ISTORE,
+		[ISTORE_3]    = &&T1_ISTORE,
+		[FSTORE]      = &&T1_ISTORE,
+		[FSTORE_0]    = &&T1_ISTORE,
+		[FSTORE_1]    = &&T1_ISTORE,
+		[FSTORE_2]    = &&T1_ISTORE,
+		[FSTORE_3]    = &&T1_ISTORE,
+		[ASTORE]      = &&T1_ISTORE,
+		[ASTORE_0]    = &&T1_ISTORE,
+		[ASTORE_1]    = &&T1_ISTORE,
+		[ASTORE_2]    = &&T1_ISTORE,
+		[ASTORE_3]    = &&T1_ISTORE,
+		[IADD]        = &&T1_IADD,
+		[ISUB]        = &&T1_ISUB,
+		[IMUL]        = &&T1_IMUL,
+		[IDIV]        = &&T1_IDIV,
+		[IREM]        = &&T1_IREM,
+		[IAND]        = &&T1_IAND,
+		[IOR]         = &&T1_IOR,
+		[IXOR]        = &&T1_IXOR,
+		[ISHL]        = &&T1_ISHL,
+		[ISHR]        = &&T1_ISHR,
+		[IUSHR]       = &&T1_IUSHR,
+		[FADD]        = &&T1_FADD,
+		[FSUB]        = &&T1_FSUB,
+		[FMUL]        = &&T1_FMUL,
+		[FDIV]        = &&T1_FDIV,
+		[FREM]        = &&T1_FREM,
+		[INEG]        = &&T1_INEG,
+		[FNEG]        = &&T1_FNEG,
+		[I2L]         = &&T1_I2L,
+		[I2F]         = &&T1_I2F,
+		[I2D]         = &&T1_I2D,
+		[F2I]         = &&T1_F2I,
+		[F2L]         = &&T1_F2L,
+		[F2D]         = &&T1_F2D,
+		[I2B]         = &&T1_I2B,
+		[I2C]         = &&T1_I2C,
+		[I2S]         = &&T1_I2S,
+		[FCMPL]       = &&T1_FCMPL,
+		[FCMPG]       = &&T1_FCMPL,
+		[IFEQ]        = &&T1_IFEQ,
+		[IFNE]        = &&T1_IFNE,
+		[IFLT]        = &&T1_IFLT,
+		[IFGE]        = &&T1_IFGE,
+		[IFGT]        = &&T1_IFGT,
+		[IFLE]        = &&T1_IFLE,
+		[IF_ICMPEQ]   = &&T1_IF_ICMPEQ,
+		[IF_ICMPNE]   = &&T1_IF_ICMPNE,
+		[IF_ICMPLT]   = &&T1_IF_ICMPLT,
+		[IF_ICMPGE]   = &&T1_IF_ICMPGE,
+		[IF_ICMPGT]   = &&T1_IF_ICMPGT,
+		[IF_ICMPLE]   = &&T1_IF_ICMPLE,
+		[IF_ACMPEQ]   = &&T1_IF_ACMPEQ,
+		[IF_ACMPNE]   = &&T1_IF_ACMPNE,
+		[IFNULL]      = &&T1_IFNULL,
+		[IFNONNULL]   = &&T1_IFNONNULL,
+		[IALOAD]      = &&T1_IALOAD,
+		[BALOAD]      = &&T1_IALOAD,
+		[CALOAD]      = &&T1_IALOAD,
+		[SALOAD]      = &&T1_IALOAD,
+		[FALOAD]      = &&T1_FALOAD,
+		[AALOAD]      = &&T1_AALOAD,
+		[LALOAD]      = &&T1_LALOAD,
+		[DALOAD]      = &&T1_DALOAD,
+		[IASTORE]     = &&T1_IASTORE,
+		[BASTORE]     = &&T1_IASTORE,
+		[CASTORE]     = &&T1_IASTORE,
+		[SASTORE]     = &&T1_IASTORE,
+		[FASTORE]     = &&T1_FASTORE,
+		[AASTORE]     = &&T1_AASTORE,
+		[LSHL]        = &&T1_LSHL,
+		[LSHR]        = &&T1_LSHR,
+		[LUSHR]       = &&T1_LUSHR,
+		[ARRAYLENGTH] = &&T1_ARRAYLENGTH,
+		[IINC]        = &&T1_IINC,
+		[DUP]         = &&T1_DUP,
+		[POP]         = &&T1_POP,
+	};
+	static void *tos2[INSTR_LAST] = {
+		[LSTORE]   = &&T2_LSTORE,
+		[LSTORE_0] = &&T2_LSTORE,
+		[LSTORE_1] = &&T2_LSTORE,
+		[LSTORE_2] = &&T2_LSTORE,
+		[LSTORE_3] = &&T2_LSTORE,
+		[DSTORE]   = &&T2_LSTORE,
+		[DSTORE_0] = &&T2_LSTORE,
+		[DSTORE_1] = &&T2_LSTORE,
+		[DSTORE_2] = &&T2_LSTORE,
+		[DSTORE_3] = &&T2_LSTORE,
+		[LADD]     = &&T2_LADD,
+		[LSUB]     = &&T2_LSUB,
+		[LMUL]     = &&T2_LMUL,
+		[LDIV]     = &&T2_LDIV,
+		[LREM]     = &&T2_LREM,
+		[LAND]     = &&T2_LAND,
+		[LOR]      = &&T2_LOR,
+		[LXOR]     = &&T2_LXOR,
+		[DADD]     = &&T2_DADD,
+		[DSUB]     = &&T2_DSUB,
+		[DMUL]     = &&T2_DMUL,
+		[DDIV]     = &&T2_DDIV,
+		[DREM]     = &&T2_DREM,
+		[LNEG]     = &&T2_LNEG,
+		[DNEG]     = &&T2_DNEG,
+		[L2I]      = &&T2_L2I,
+		[L2F]      = &&T2_L2F,
+		[L2D]      = &&T2_L2D,
+		[D2I]      = &&T2_D2I,
+		[D2L]      = &&T2_D2L,
+		[D2F]      = &&T2_D2F,
+		[LCMP]     = &&T2_LCMP,
+		[DCMPL]    = &&T2_DCMPL,
+		[DCMPG]    = &&T2_DCMPL,
+		[LASTORE]  = &&T2_LASTORE,
+		[DASTORE]  = &&T2_DASTORE,
+		[IINC]     = &&T2_IINC,
+		[POP2]     = &&T2_POP2,
+	};
+	static void *countlabels[INSTR_LAST];
+	static void *recordlabels[INSTR_LAST];
+	static void *checklabels[INSTR_LAST];
+	static int tosready = 0;
+	void **table;
+	size_t k;
+	Value t0;                       /* cached top of stack */
+#endif
+	Value *sp, *local;
+	Value v1, v2, v3, v4;
+	Instr *code, *pc, *ins;
+	Frame *entry, *caller;
+	Callsite *site;
+	ClassFile *callclass;
+	Code_attribute *callcode;
+	U2 prev;
+	U4 n;
+
+	entry = frame;
+	code = frame->code->instr;
+	local = frame->local;
+	prev = INSTR_LAST;
+	LOAD();
+#ifdef __GNUC__
+	if (oppairs != NULL) {
+		for (k = 0; k < INSTR_LAST; k++)
+			countlabels[k] = &&count;
+	} else if (tos) {
+		if (!tosready) {
+			for (k = 0; k < INSTR_LAST; k++) {
+				if (tos0[k] == NULL)
+					tos0[k] = labels[k];
+				if (tos1[k] == NULL)
+					tos1[k] = &&spill1;
+				if (tos2[k] == NULL)
+					tos2[k] = &&spill2;
+			}
+			tosready = 1;
+		}
 	}
-	if (vi.i < 0 || vi.i >= va.v->nmemb) {
-		// TODO: throw ArrayIndexOutOfBoundsException
+	if (recordlabels[0] == NULL) {
+		for (k = 0; k < INSTR_LAST; k++) {
+			recordlabels[k] = &&record;
+			checklabels[k] = &&check;
+		}
 	}
-	((long *)va.v->obj)[vi.i] = vv.l;
-	return NO_RETURN;
-}
-
-/* lcmp: compare long */
-static int
-oplcmp(Frame *frame)
-{
-	Value v1, v2, v;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	if (v1.l > v2.l)
-		v.i = 1;
-	else if (v1.l < v2.l)
-		v.i = -1;
+	if (oppairs != NULL)
+		table = countlabels;
 	else
-		v.i = 0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* lconst_0: push long 0 into stack */
-static int
-oplconst_0(Frame *frame)
-{
-	Value v;
-
-	v.l = 0;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* lconst_1: push long 1 into stack */
-static int
-oplconst_1(Frame *frame)
-{
-	Value v;
-
-	v.l = 1;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* ldc: push item from run-time constant pool */
-static int
-opldc(Frame *frame)
-{
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++];
-	v = resolveconstant(frame->class, i);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* ldc2_w: push long or double from run-time constant pool (wide index) */
-static int
-opldc2_w(Frame *frame)
-{
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = resolveconstant(frame->class, i);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* ldc_w: push item from run-time constant pool (wide index) */
-static int
-opldc_w(Frame *frame)
-{
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	v = resolveconstant(frame->class, i);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
+		RETABLE();
+	DISPATCH();
+count:
+	if (prev < CODE_LAST)
+		oppairs[prev][opfold(ins->op)]++;
+	prev = opfold(ins->op);
+	if (!frame->code->verified)
+		checkinstr(frame, ins, sp);
+	goto *labels[ins->op];
+record:
+	if (!frame->code->verified)
+		checkinstr(frame, ins, sp);
+	if (!tracerecord(frame, ins, sp))
+		RETABLE();
+	goto *labels[ins->op];
+check:
+	checkinstr(frame, ins, sp);
+	goto *labels[ins->op];
+#else
+dispatch:
+	if (oppairs != NULL) {
+		if (prev < CODE_LAST)
+			oppairs[prev][opfold(pc->op)]++;
+		prev = opfold(pc->op);
+	}
+	if (!frame->code->verified)
+		checkinstr(frame, pc, sp);
+	if (recorder.trace != NULL)
+		(void)tracerecord(frame, pc, sp);
+#endif
+	switch ((ins = pc++)->op) {
+	TARGET(NOP):
+		DISPATCH();
+
+	/* constants */
+	TARGET(ACONST_NULL):
+		sp->v = NULL;
+		sp++;
+		DISPATCH();
+	TARGET(ICONST_M1):
+		(sp++)->i = -1;
+		DISPATCH();
+	TARGET(ICONST_0):
+		(sp++)->i = 0;
+		DISPATCH();
+	TARGET(ICONST_1):
+		(sp++)->i = 1;
+		DISPATCH();
+	TARGET(ICONST_2):
+		(sp++)->i = 2;
+		DISPATCH();
+	TARGET(ICONST_3):
+		(sp++)->i = 3;
+		DISPATCH();
+	TARGET(ICONST_4):
+		(sp++)->i = 4;
+		DISPATCH();
+	TARGET(ICONST_5):
+		(sp++)->i = 5;
+		DISPATCH();
+	TARGET(LCONST_0):
+		sp->l = 0;
+		sp += 2;
+		DISPATCH();
+	TARGET(LCONST_1):
+		sp->l = 1;
+		sp += 2;
+		DISPATCH();
+	TARGET(FCONST_0):
+		(sp++)->f = 0.0;
+		DISPATCH();
+	TARGET(FCONST_1):
+		(sp++)->f = 1.0;
+		DISPATCH();
+	TARGET(FCONST_2):
+		(sp++)->f = 2.0;
+		DISPATCH();
+	TARGET(DCONST_0):
+		sp->d = 0.0;
+		sp += 2;
+		DISPATCH();
+	TARGET(DCONST_1):
+		sp->d = 1.0;
+		sp += 2;
+		DISPATCH();
+	TARGET(BIPUSH):
+	TARGET(SIPUSH):
+		(sp++)->i = ins->i;
+		DISPATCH();
+	TARGET(LDC):
+	TARGET(LDC_W):
+		*sp++ = ins->v;
+		DISPATCH();
+	TARGET(LDC_STRING):
+		*sp++ = resolveconstant(frame->class, ins->u);
+		DISPATCH();
+	TARGET(LDC2_W):
+		*sp = ins->v;
+		sp += 2;
+		DISPATCH();
+
+	/* loads */
+	TARGET(ILOAD):
+	TARGET(FLOAD):
+	TARGET(ALOAD):
+		*sp++ = local[ins->u];
+		DISPATCH();
+	TARGET(LLOAD):
+	TARGET(DLOAD):
+		*sp = local[ins->u];
+		sp += 2;
+		DISPATCH();
+	TARGET(ILOAD_0):
+	TARGET(FLOAD_0):
+	TARGET(ALOAD_0):
+		*sp++ = local[0];
+		DISPATCH();
+	TARGET(ILOAD_1):
+	TARGET(FLOAD_1):
+	TARGET(ALOAD_1):
+		*sp++ = local[1];
+		DISPATCH();
+	TARGET(ILOAD_2):
+	TARGET(FLOAD_2):
+	TARGET(ALOAD_2):
+		*sp++ = local[2];
+		DISPATCH();
+	TARGET(ILOAD_3):
+	TARGET(FLOAD_3):
+	TARGET(ALOAD_3):
+		*sp++ = local[3];
+		DISPATCH();
+	TARGET(LLOAD_0):
+	TARGET(DLOAD_0):
+		*sp = local[0];
+		sp += 2;
+		DISPATCH();
+	TARGET(LLOAD_1):
+	TARGET(DLOAD_1):
+		*sp = local[1];
+		sp += 2;
+		DISPATCH();
+	TARGET(LLOAD_2):
+	TARGET(DLOAD_2):
+		*sp = local[2];
+		sp += 2;
+		DISPATCH();
+	TARGET(LLOAD_3):
+	TARGET(DLOAD_3):
+		*sp = local[3];
+		sp += 2;
+		DISPATCH();
+	TARGET(IALOAD):
+	TARGET(BALOAD):
+	TARGET(CALOAD):
+	TARGET(SALOAD):
+		// TODO: throw NullPointerException and ArrayIndexOutOfBoundsException
+		sp--;
+		sp[-1].i = ((int32_t *)HEAP_DATA(sp[-1].v))[sp[0].i];
+		DISPATCH();
+	TARGET(LALOAD):
+		sp[-2].l = ((int64_t *)HEAP_DATA(sp[-2].v))[sp[-1].i];
+		DISPATCH();
+	TARGET(FALOAD):
+		sp--;
+		sp[-1].f = ((float *)HEAP_DATA(sp[-1].v))[sp[0].i];
+		DISPATCH();
+	TARGET(DALOAD):
+		sp[-2].d = ((double *)HEAP_DATA(sp[-2].v))[sp[-1].i];
+		DISPATCH();
+	TARGET(AALOAD):
+		sp--;
+		sp[-1].v = heap_load(sp[-1].v, sp[0].i);
+		DISPATCH();
+
+	/* stores */
+	TARGET(ISTORE):
+	TARGET(FSTORE):
+	TARGET(ASTORE):
+		local[ins->u] = *--sp;
+		DISPATCH();
+	TARGET(LSTORE):
+	TARGET(DSTORE):
+		sp -= 2;
+		local[ins->u] = *sp;
+		DISPATCH();
+	TARGET(ISTORE_0):
+	TARGET(FSTORE_0):
+	TARGET(ASTORE_0):
+		local[0] = *--sp;
+		DISPATCH();
+	TARGET(ISTORE_1):
+	TARGET(FSTORE_1):
+	TARGET(ASTORE_1):
+		local[1] = *--sp;
+		DISPATCH();
+	TARGET(ISTORE_2):
+	TARGET(FSTORE_2):
+	TARGET(ASTORE_2):
+		local[2] = *--sp;
+		DISPATCH();
+	TARGET(ISTORE_3):
+	TARGET(FSTORE_3):
+	TARGET(ASTORE_3):
+		local[3] = *--sp;
+		DISPATCH();
+	TARGET(LSTORE_0):
+	TARGET(DSTORE_0):
+		sp -= 2;
+		local[0] = *sp;
+		DISPATCH();
+	TARGET(LSTORE_1):
+	TARGET(DSTORE_1):
+		sp -= 2;
+		local[1] = *sp;
+		DISPATCH();
+	TARGET(LSTORE_2):
+	TARGET(DSTORE_2):
+		sp -= 2;
+		local[2] = *sp;
+		DISPATCH();
+	TARGET(LSTORE_3):
+	TARGET(DSTORE_3):
+		sp -= 2;
+		local[3] = *sp;
+		DISPATCH();
+	TARGET(IASTORE):
+	TARGET(BASTORE):
+	TARGET(CASTORE):
+	TARGET(SASTORE):
+		// TODO: throw NullPointerException and ArrayIndexOutOfBoundsException
+		sp -= 3;
+		((int32_t *)HEAP_DATA(sp[0].v))[sp[1].i] = sp[2].i;
+		DISPATCH();
+	TARGET(LASTORE):
+		sp -= 4;
+		((int64_t *)HEAP_DATA(sp[0].v))[sp[1].i] = sp[2].l;
+		DISPATCH();
+	TARGET(FASTORE):
+		sp -= 3;
+		((float *)HEAP_DATA(sp[0].v))[sp[1].i] = sp[2].f;
+		DISPATCH();
+	TARGET(DASTORE):
+		sp -= 4;
+		((double *)HEAP_DATA(sp[0].v))[sp[1].i] = sp[2].d;
+		DISPATCH();
+	TARGET(AASTORE):
+		sp -= 3;
+		HEAP_BARRIER(sp[0].v, sp[1].i, sp[2].v);
+		heap_store(sp[0].v, sp[1].i, sp[2].v);
+		DISPATCH();
+
+	/* stack */
+	TARGET(POP):
+		sp--;
+		DISPATCH();
+	TARGET(POP2):
+		sp -= 2;
+		DISPATCH();
+	TARGET(DUP):
+		sp[0] = sp[-1];
+		sp++;
+		DISPATCH();
+	TARGET(DUP_X1):
+		v1 = sp[-1];
+		v2 = sp[-2];
+		sp[-2] = v1;
+		sp[-1] = v2;
+		sp[0] = v1;
+		sp++;
+		DISPATCH();
+	TARGET(DUP_X2):
+		v1 = sp[-1];
+		v2 = sp[-2];
+		v3 = sp[-3];
+		sp[-3] = v1;
+		sp[-2] = v3;
+		sp[-1] = v2;
+		sp[0] = v1;
+		sp++;
+		DISPATCH();
+	TARGET(DUP2):
+		sp[0] = sp[-2];
+		sp[1] = sp[-1];
+		sp += 2;
+		DISPATCH();
+	TARGET(DUP2_X1):
+		v1 = sp[-1];
+		v2 = sp[-2];
+		v3 = sp[-3];
+		sp[-3] = v2;
+		sp[-2] = v1;
+		sp[-1] = v3;
+		sp[0] = v2;
+		sp[1] = v1;
+		sp += 2;
+		DISPATCH();
+	TARGET(DUP2_X2):
+		v1 = sp[-1];
+		v2 = sp[-2];
+		v3 = sp[-3];
+		v4 = sp[-4];
+		sp[-4] = v2;
+		sp[-3] = v1;
+		sp[-2] = v4;
+		sp[-1] = v3;
+		sp[0] = v2;
+		sp[1] = v1;
+		sp += 2;
+		DISPATCH();
+	TARGET(SWAP):
+		v1 = sp[-1];
+		sp[-1] = sp[-2];
+		sp[-2] = v1;
+		DISPATCH();
+
+	/* math */
+	TARGET(IADD):
+		sp--;
+		sp[-1].i += sp[0].i;
+		DISPATCH();
+	TARGET(LADD):
+		sp -= 2;
+		sp[-2].l += sp[0].l;
+		DISPATCH();
+	TARGET(FADD):
+		sp--;
+		sp[-1].f += sp[0].f;
+		DISPATCH();
+	TARGET(DADD):
+		sp -= 2;
+		sp[-2].d += sp[0].d;
+		DISPATCH();
+	TARGET(ISUB):
+		sp--;
+		sp[-1].i -= sp[0].i;
+		DISPATCH();
+	TARGET(LSUB):
+		sp -= 2;
+		sp[-2].l -= sp[0].l;
+		DISPATCH();
+	TARGET(FSUB):
+		sp--;
+		sp[-1].f -= sp[0].f;
+		DISPATCH();
+	TARGET(DSUB):
+		sp -= 2;
+		sp[-2].d -= sp[0].d;
+		DISPATCH();
+	TARGET(IMUL):
+		sp--;
+		sp[-1].i *= sp[0].i;
+		DISPATCH();
+	TARGET(LMUL):
+		sp -= 2;
+		sp[-2].l *= sp[0].l;
+		DISPATCH();
+	TARGET(FMUL):
+		sp--;
+		sp[-1].f *= sp[0].f;
+		DISPATCH();
+	TARGET(DMUL):
+		sp -= 2;
+		sp[-2].d *= sp[0].d;
+		DISPATCH();
+	TARGET(IDIV):
+		sp--;
+		sp[-1].i /= sp[0].i;
+		DISPATCH();
+	TARGET(LDIV):
+		sp -= 2;
+		sp[-2].l /= sp[0].l;
+		DISPATCH();
+	TARGET(FDIV):
+		sp--;
+		sp[-1].f /= sp[0].f;
+		DISPATCH();
+	TARGET(DDIV):
+		sp -= 2;
+		sp[-2].d /= sp[0].d;
+		DISPATCH();
+	TARGET(IREM):
+		sp--;
+		sp[-1].i %= sp[0].i;
+		DISPATCH();
+	TARGET(LREM):
+		sp -= 2;
+		sp[-2].l %= sp[0].l;
+		DISPATCH();
+	TARGET(FREM):
+		sp--;
+		sp[-1].f = fmodf(sp[-1].f, sp[0].f);
+		DISPATCH();
+	TARGET(DREM):
+		sp -= 2;
+		sp[-2].d = fmod(sp[-2].d, sp[0].d);
+		DISPATCH();
+	TARGET(INEG):
+		sp[-1].i = -sp[-1].i;
+		DISPATCH();
+	TARGET(LNEG):
+		sp[-2].l = -sp[-2].l;
+		DISPATCH();
+	TARGET(FNEG):
+		sp[-1].f = -sp[-1].f;
+		DISPATCH();
+	TARGET(DNEG):
+		sp[-2].d = -sp[-2].d;
+		DISPATCH();
+	TARGET(ISHL):
+		sp--;
+		sp[-1].i <<= sp[0].i & 0x1F;
+		DISPATCH();
+	TARGET(LSHL):
+		sp--;
+		sp[-2].l <<= sp[0].i & 0x3F;
+		DISPATCH();
+	TARGET(ISHR):
+		sp--;
+		sp[-1].i >>= sp[0].i & 0x1F;
+		DISPATCH();
+	TARGET(LSHR):
+		sp--;
+		sp[-2].l >>= sp[0].i & 0x3F;
+		DISPATCH();
+	TARGET(IUSHR):
+		sp--;
+		sp[-1].i = (uint32_t)sp[-1].i >> (sp[0].i & 0x1F);
+		DISPATCH();
+	TARGET(LUSHR):
+		sp--;
+		sp[-2].l = (uint64_t)sp[-2].l >> (sp[0].i & 0x3F);
+		DISPATCH();
+	TARGET(IAND):
+		sp--;
+		sp[-1].i &= sp[0].i;
+		DISPATCH();
+	TARGET(LAND):
+		sp -= 2;
+		sp[-2].l &= sp[0].l;
+		DISPATCH();
+	TARGET(IOR):
+		sp--;
+		sp[-1].i |= sp[0].i;
+		DISPATCH();
+	TARGET(LOR):
+		sp -= 2;
+		sp[-2].l |= sp[0].l;
+		DISPATCH();
+	TARGET(IXOR):
+		sp--;
+		sp[-1].i ^= sp[0].i;
+		DISPATCH();
+	TARGET(LXOR):
+		sp -= 2;
+		sp[-2].l ^= sp[0].l;
+		DISPATCH();
+	TARGET(IINC):
+		local[ins->u].i += ins->i;
+		DISPATCH();
+
+	/* conversions */
+	TARGET(I2L):
+		sp[-1].l = sp[-1].i;
+		sp++;
+		DISPATCH();
+	TARGET(I2F):
+		sp[-1].f = sp[-1].i;
+		DISPATCH();
+	TARGET(I2D):
+		sp[-1].d = sp[-1].i;
+		sp++;
+		DISPATCH();
+	TARGET(L2I):
+		sp--;
+		sp[-1].i = sp[-1].l;
+		DISPATCH();
+	TARGET(L2F):
+		sp--;
+		sp[-1].f = sp[-1].l;
+		DISPATCH();
+	TARGET(L2D):
+		sp[-2].d = sp[-2].l;
+		DISPATCH();
+	TARGET(F2I):
+		sp[-1].i = sp[-1].f;
+		DISPATCH();
+	TARGET(F2L):
+		sp[-1].l = sp[-1].f;
+		sp++;
+		DISPATCH();
+	TARGET(F2D):
+		sp[-1].d = sp[-1].f;
+		sp++;
+		DISPATCH();
+	TARGET(D2I):
+		sp--;
+		sp[-1].i = sp[-1].d;
+		DISPATCH();
+	TARGET(D2L):
+		sp[-2].l = sp[-2].d;
+		DISPATCH();
+	TARGET(D2F):
+		sp--;
+		sp[-1].f = sp[-1].d;
+		DISPATCH();
+	TARGET(I2B):
+		sp[-1].i = (int8_t)sp[-1].i;
+		DISPATCH();
+	TARGET(I2C):
+		sp[-1].i = (uint16_t)sp[-1].i;
+		DISPATCH();
+	TARGET(I2S):
+		sp[-1].i = (int16_t)sp[-1].i;
+		DISPATCH();
+
+	/* comparisons */
+	TARGET(LCMP):
+		sp -= 3;
+		v1 = sp[-1];
+		v2 = sp[1];
+		sp[-1].i = (v1.l > v2.l) - (v1.l < v2.l);
+		DISPATCH();
+	TARGET(FCMPL):
+	TARGET(FCMPG):
+		sp--;
+		v1 = sp[-1];
+		v2 = sp[0];
+		if (v1.f > v2.f)
+			sp[-1].i = 1;
+		else if (v1.f == v2.f)
+			sp[-1].i = 0;
+		else if (v1.f < v2.f)
+			sp[-1].i = -1;
+		else
+			sp[-1].i = (ins->op == FCMPG) ? 1 : -1;
+		DISPATCH();
+	TARGET(DCMPL):
+	TARGET(DCMPG):
+		sp -= 3;
+		v1 = sp[-1];
+		v2 = sp[1];
+		if (v1.d > v2.d)
+			sp[-1].i = 1;
+		else if (v1.d == v2.d)
+			sp[-1].i = 0;
+		else if (v1.d < v2.d)
+			sp[-1].i = -1;
+		else
+			sp[-1].i = (ins->op == DCMPG) ? 1 : -1;
+		DISPATCH();
+	TARGET(IFEQ):
+		sp--;
+		LOOPIF(sp[0].i == 0);
+		DISPATCH();
+	TARGET(IFNE):
+		sp--;
+		LOOPIF(sp[0].i != 0);
+		DISPATCH();
+	TARGET(IFLT):
+		sp--;
+		LOOPIF(sp[0].i < 0);
+		DISPATCH();
+	TARGET(IFGE):
+		sp--;
+		LOOPIF(sp[0].i >= 0);
+		DISPATCH();
+	TARGET(IFGT):
+		sp--;
+		LOOPIF(sp[0].i > 0);
+		DISPATCH();
+	TARGET(IFLE):
+		sp--;
+		LOOPIF(sp[0].i <= 0);
+		DISPATCH();
+	TARGET(IF_ICMPEQ):
+		sp -= 2;
+		LOOPIF(sp[0].i == sp[1].i);
+		DISPATCH();
+	TARGET(IF_ICMPNE):
+		sp -= 2;
+		LOOPIF(sp[0].i != sp[1].i);
+		DISPATCH();
+	TARGET(IF_ICMPLT):
+		sp -= 2;
+		LOOPIF(sp[0].i < sp[1].i);
+		DISPATCH();
+	TARGET(IF_ICMPGE):
+		sp -= 2;
+		LOOPIF(sp[0].i >= sp[1].i);
+		DISPATCH();
+	TARGET(IF_ICMPGT):
+		sp -= 2;
+		LOOPIF(sp[0].i > sp[1].i);
+		DISPATCH();
+	TARGET(IF_ICMPLE):
+		sp -= 2;
+		LOOPIF(sp[0].i <= sp[1].i);
+		DISPATCH();
+	TARGET(IF_ACMPEQ):
+		sp -= 2;
+		LOOPIF(sp[0].v == sp[1].v);
+		DISPATCH();
+	TARGET(IF_ACMPNE):
+		sp -= 2;
+		LOOPIF(sp[0].v != sp[1].v);
+		DISPATCH();
+
+	/* control */
+	TARGET(GOTO):
+	TARGET(GOTO_W):
+		pc = code + ins->i;
+		if (pc <= ins)
+			goto backedge;
+		DISPATCH();
+	TARGET(JSR):
+	TARGET(JSR_W):
+		(sp++)->i = pc - code;
+		pc = code + ins->i;
+		DISPATCH();
+	TARGET(RET):
+		pc = code + local[ins->u].i;
+		DISPATCH();
+	TARGET(TABLESWITCH):
+		sp--;
+		n = (U4)sp[0].i - (U4)ins->v.i;
+		pc = code + (n < ins->u ? pc[n].i : ins->i);
+		DISPATCH();
+	TARGET(LOOKUPSWITCH):
+		sp--;
+		n = switchcase(pc, ins->u, sp[0].i);
+		pc = code + (n < ins->u ? pc[n].i : ins->i);
+		DISPATCH();
+	TARGET(IRETURN):
+	TARGET(FRETURN):
+	TARGET(ARETURN):
+		n = 1;
+		goto methodreturn;
+	TARGET(LRETURN):
+	TARGET(DRETURN):
+		n = 2;
+		goto methodreturn;
+	TARGET(RETURN):
+		n = 0;
+		goto methodreturn;
+
+	/* references */
+	TARGET(GETSTATIC):
+		CALL(opgetstatic);
+		DISPATCH();
+	TARGET(PUTSTATIC):
+		CALL(opputstatic);
+		DISPATCH();
+	TARGET(GETSTATIC_QUICK):
+		*sp++ = *(Value *)ins->p;
+		DISPATCH();
+	TARGET(GETSTATIC_WIDE):
+		sp[0] = *(Value *)ins->p;
+		sp += 2;
+		DISPATCH();
+	TARGET(PUTSTATIC_QUICK):
+		*(Value *)ins->p = *--sp;
+		DISPATCH();
+	TARGET(PUTSTATIC_WIDE):
+		sp -= 2;
+		*(Value *)ins->p = sp[0];
+		DISPATCH();
+	TARGET(GETFIELD):
+		CALL(opgetfield);
+		DISPATCH();
+	TARGET(PUTFIELD):
+		CALL(opputfield);
+		DISPATCH();
+	TARGET(GETFIELD_BYTE):
+		sp[-1].i = FIELD(int8_t, sp[-1].v, ins->i);
+		DISPATCH();
+	TARGET(GETFIELD_CHAR):
+		sp[-1].i = FIELD(uint16_t, sp[-1].v, ins->i);
+		DISPATCH();
+	TARGET(GETFIELD_SHORT):
+		sp[-1].i = FIELD(int16_t, sp[-1].v, ins->i);
+		DISPATCH();
+	TARGET(GETFIELD_INT):
+		sp[-1].i = FIELD(int32_t, sp[-1].v, ins->i);
+		DISPATCH();
+	TARGET(GETFIELD_LONG):
+		sp[-1].l = FIELD(int64_t, sp[-1].v, ins->i);
+		sp++;
+		DISPATCH();
+	TARGET(GETFIELD_REF):
+		sp[-1].v = heap_getfield(sp[-1].v, ins->i);
+		DISPATCH();
+	TARGET(PUTFIELD_BYTE):
+		sp -= 2;
+		FIELD(int8_t, sp[0].v, ins->i) = sp[1].i;
+		DISPATCH();
+	TARGET(PUTFIELD_SHORT):
+		sp -= 2;
+		FIELD(int16_t, sp[0].v, ins->i) = sp[1].i;
+		DISPATCH();
+	TARGET(PUTFIELD_INT):
+		sp -= 2;
+		FIELD(int32_t, sp[0].v, ins->i) = sp[1].i;
+		DISPATCH();
+	TARGET(PUTFIELD_LONG):
+		sp -= 3;
+		FIELD(int64_t, sp[0].v, ins->i) = sp[1].l;
+		DISPATCH();
+	TARGET(PUTFIELD_REF):
+		sp -= 2;
+		HEAP_FIELDBARRIER(sp[0].v, ins->i, sp[1].v);
+		heap_putfield(sp[0].v, ins->i, sp[1].v);
+		DISPATCH();
+	TARGET(INVOKEVIRTUAL):
+	TARGET(INVOKESPECIAL):
+	TARGET(INVOKESTATIC):
+		SAVE();
+		site = invokeresolve(frame, ins);
+		if (site->native != NULL) {
+			CALL(opinvokenative);
+			DISPATCH();
+		}
+		if (ins->op == INVOKEVIRTUAL_QUICK)
+			goto invokevirtual;
+		callclass = site->class;
+		callcode = site->code;
+		goto invoke;
+	TARGET(INVOKESTATIC_QUICK):
+		site = ins->p;
+		callclass = site->class;
+		callcode = site->code;
+		goto invoke;
+	TARGET(INVOKEVIRTUAL_QUICK):
+		site = ins->p;
+invokevirtual:
+		virtualtarget(site, sp[-site->nargs].v, &callclass, &callcode);
+		goto invoke;
+	TARGET(INVOKESTATIC_NATIVE):
+	TARGET(INVOKEVIRTUAL_NATIVE):
+		CALL(opinvokenative);
+		DISPATCH();
+	TARGET(NEW):
+		CALL(opnew);
+		DISPATCH();
+	TARGET(NEW_QUICK):
+		CALL(opnewquick);
+		DISPATCH();
+	TARGET(NEWARRAY):
+		CALL(opnewarray);
+		DISPATCH();
+	TARGET(ARRAYLENGTH):
+		sp[-1].i = sp[-1].v->nmemb;
+		DISPATCH();
+
+	/* extended */
+	TARGET(MULTIANEWARRAY):
+		CALL(opmultianewarray);
+		DISPATCH();
+	TARGET(IFNULL):
+		sp--;
+		LOOPIF(sp[0].v == NULL);
+		DISPATCH();
+	TARGET(IFNONNULL):
+		sp--;
+		LOOPIF(sp[0].v != NULL);
+		DISPATCH();
+
+	/* superinstructions; the instructions they replace follow them */
+	TARGET(ILOAD_ILOAD):
+		sp[0] = local[ins[0].u];
+		sp[1] = local[ins[1].u];
+		sp += 2;
+		pc += 1;
+		DISPATCH();
+	TARGET(ILOAD_ILOAD_IADD_ISTORE):
+		local[ins[3].u].i = local[ins[0].u].i + local[ins[1].u].i;
+		pc += 3;
+		DISPATCH();
+	TARGET(ILOAD_BIPUSH_IF_ICMPLT):
+		pc = (local[ins[0].u].i < ins[1].i) ? code + ins[2].i : pc + 2;
+		if (pc <= ins)
+			goto backedge;
+		DISPATCH();
+	TARGET(ILOAD_BIPUSH_IF_ICMPGE):
+		pc = (local[ins[0].u].i >= ins[1].i) ? code + ins[2].i : pc + 2;
+		if (pc <= ins)
+			goto backedge;
+		DISPATCH();
+	TARGET(ILOAD_ILOAD_IF_ICMPLT):
+		pc = (local[ins[0].u].i < local[ins[1].u].i) ? code + ins[2].i : pc + 2;
+		if (pc <= ins)
+			goto backedge;
+		DISPATCH();
+	TARGET(ILOAD_ILOAD_IF_ICMPGE):
+		pc = (local[ins[0].u].i >= local[ins[1].u].i) ? code + ins[2].i : pc + 2;
+		if (pc <= ins)
+			goto backedge;
+		DISPATCH();
+	TARGET(ALOAD_ILOAD_IALOAD):
+		(sp++)->i = ((int32_t *)HEAP_DATA(local[ins[0].u].v))[local[ins[1].u].i];
+		pc += 2;
+		DISPATCH();
+	TARGET(IINC_GOTO):
+		local[ins[0].u].i += ins[0].i;
+		pc = code + ins[1].i;
+		if (pc <= ins)
+			goto backedge;
+		DISPATCH();
+
+#ifdef __GNUC__
+	/*
+	 * Top-of-stack caching (-Xtos).  The handlers below run with the
+	 * value on top of the operand stack held in t0 instead of memory:
+	 * those dispatched through tos1 with a category 1 value cached,
+	 * those dispatched through tos2 with a category 2 value (taking
+	 * two stack slots) cached.  The handlers in tos0 run with nothing
+	 * cached; beyond the ones below, which leave their result in t0,
+	 * they are the regular handlers.  An instruction without a
+	 * handler for the current state spills t0 to the stack and runs
+	 * in the empty state.
+	 */
+spill1:
+		*sp++ = t0;
+		goto *tos0[ins->op];
+spill2:
+		*sp = t0;
+		sp += 2;
+		goto *tos0[ins->op];
+T0_ILOAD:
+		t0 = local[ins->u];
+		TOSDISPATCH(1);
+T0_LLOAD:
+		t0 = local[ins->u];
+		TOSDISPATCH(2);
+T0_ICONST_M1:
+		t0.i = ins->i;
+		TOSDISPATCH(1);
+T0_LCONST_0:
+		t0.l = ins->op - LCONST_0;
+		TOSDISPATCH(2);
+T0_FCONST_0:
+		t0.f = ins->op - FCONST_0;
+		TOSDISPATCH(1);
+T0_DCONST_0:
+		t0.d = ins->op - DCONST_0;
+		TOSDISPATCH(2);
+T0_LDC:
+		t0 = ins->v;
+		TOSDISPATCH(1);
+T0_LDC2_W:
+		t0 = ins->v;
+		TOSDISPATCH(2);
+T0_IALOAD:
+		sp -= 2;
+		t0.i = ((int32_t *)HEAP_DATA(sp[0].v))[sp[1].i];
+		TOSDISPATCH(1);
+T0_FALOAD:
+		sp -= 2;
+		t0.f = ((float *)HEAP_DATA(sp[0].v))[sp[1].i];
+		TOSDISPATCH(1);
+T0_AALOAD:
+		sp -= 2;
+		t0.v = heap_load(sp[0].v, sp[1].i);
+		TOSDISPATCH(1);
+T0_LALOAD:
+		sp -= 2;
+		t0.l = ((int64_t *)HEAP_DATA(sp[0].v))[sp[1].i];
+		TOSDISPATCH(2);
+T0_DALOAD:
+		sp -= 2;
+		t0.d = ((double *)HEAP_DATA(sp[0].v))[sp[1].i];
+		TOSDISPATCH(2);
+T1_ISTORE:
+		local[ins->u] = t0;
+		TOSDISPATCH(0);
+T1_IADD:
+		sp--;
+		t0.i = sp[0].i + t0.i;
+		TOSDISPATCH(1);
+T1_ISUB:
+		sp--;
+		t0.i = sp[0].i - t0.i;
+		TOSDISPATCH(1);
+T1_IMUL:
+		sp--;
+		t0.i = sp[0].i * t0.i;
+		TOSDISPATCH(1);
+T1_IDIV:
+		sp--;
+		t0.i = sp[0].i / t0.i;
+		TOSDISPATCH(1);
+T1_IREM:
+		sp--;
+		t0.i = sp[0].i % t0.i;
+		TOSDISPATCH(1);
+T1_IAND:
+		sp--;
+		t0.i = sp[0].i & t0.i;
+		TOSDISPATCH(1);
+T1_IOR:
+		sp--;
+		t0.i = sp[0].i | t0.i;
+		TOSDISPATCH(1);
+T1_IXOR:
+		sp--;
+		t0.i = sp[0].i ^ t0.i;
+		TOSDISPATCH(1);
+T1_ISHL:
+		sp--;
+		t0.i = sp[0].i << (t0.i & 0x1F);
+		TOSDISPATCH(1);
+T1_ISHR:
+		sp--;
+		t0.i = sp[0].i >> (t0.i & 0x1F);
+		TOSDISPATCH(1);
+T1_IUSHR:
+		sp--;
+		t0.i = (uint32_t)sp[0].i >> (t0.i & 0x1F);
+		TOSDISPATCH(1);
+T1_FADD:
+		sp--;
+		t0.f = sp[0].f + t0.f;
+		TOSDISPATCH(1);
+T1_FSUB:
+		sp--;
+		t0.f = sp[0].f - t0.f;
+		TOSDISPATCH(1);
+T1_FMUL:
+		sp--;
+		t0.f = sp[0].f * t0.f;
+		TOSDISPATCH(1);
+T1_FDIV:
+		sp--;
+		t0.f = sp[0].f / t0.f;
+		TOSDISPATCH(1);
+T1_FREM:
+		sp--;
+		t0.f = fmodf(sp[0].f, t0.f);
+		TOSDISPATCH(1);
+T1_INEG:
+		t0.i = -t0.i;
+		TOSDISPATCH(1);
+T1_FNEG:
+		t0.f = -t0.f;
+		TOSDISPATCH(1);
+T1_I2L:
+		t0.l = t0.i;
+		TOSDISPATCH(2);
+T1_I2F:
+		t0.f = t0.i;
+		TOSDISPATCH(1);
+T1_I2D:
+		t0.d = t0.i;
+		TOSDISPATCH(2);
+T1_F2I:
+		t0.i = t0.f;
+		TOSDISPATCH(1);
+T1_F2L:
+		t0.l = t0.f;
+		TOSDISPATCH(2);
+T1_F2D:
+		t0.d = t0.f;
+		TOSDISPATCH(2);
+T1_I2B:
+		t0.i = (int8_t)t0.i;
+		TOSDISPATCH(1);
+T1_I2C:
+		t0.i = (uint16_t)t0.i;
+		TOSDISPATCH(1);
+T1_I2S:
+		t0.i = (int16_t)t0.i;
+		TOSDISPATCH(1);
+T1_FCMPL:
+		sp--;
+		if (sp[0].f > t0.f)
+			t0.i = 1;
+		else if (sp[0].f == t0.f)
+			t0.i = 0;
+		else if (sp[0].f < t0.f)
+			t0.i = -1;
+		else
+			t0.i = (ins->op == FCMPG) ? 1 : -1;
+		TOSDISPATCH(1);
+T1_IFEQ:
+		BRANCHIF(t0.i == 0);
+		TOSDISPATCH(0);
+T1_IFNE:
+		BRANCHIF(t0.i != 0);
+		TOSDISPATCH(0);
+T1_IFLT:
+		BRANCHIF(t0.i < 0);
+		TOSDISPATCH(0);
+T1_IFGE:
+		BRANCHIF(t0.i >= 0);
+		TOSDISPATCH(0);
+T1_IFGT:
+		BRANCHIF(t0.i > 0);
+		TOSDISPATCH(0);
+T1_IFLE:
+		BRANCHIF(t0.i <= 0);
+		TOSDISPATCH(0);
+T1_IF_ICMPEQ:
+		sp--;
+		BRANCHIF(sp[0].i == t0.i);
+		TOSDISPATCH(0);
+T1_IF_ICMPNE:
+		sp--;
+		BRANCHIF(sp[0].i != t0.i);
+		TOSDISPATCH(0);
+T1_IF_ICMPLT:
+		sp--;
+		BRANCHIF(sp[0].i < t0.i);
+		TOSDISPATCH(0);
+T1_IF_ICMPGE:
+		sp--;
+		BRANCHIF(sp[0].i >= t0.i);
+		TOSDISPATCH(0);
+T1_IF_ICMPGT:
+		sp--;
+		BRANCHIF(sp[0].i > t0.i);
+		TOSDISPATCH(0);
+T1_IF_ICMPLE:
+		sp--;
+		BRANCHIF(sp[0].i <= t0.i);
+		TOSDISPATCH(0);
+T1_IF_ACMPEQ:
+		sp--;
+		BRANCHIF(sp[0].v == t0.v);
+		TOSDISPATCH(0);
+T1_IF_ACMPNE:
+		sp--;
+		BRANCHIF(sp[0].v != t0.v);
+		TOSDISPATCH(0);
+T1_IFNULL:
+		BRANCHIF(t0.v == NULL);
+		TOSDISPATCH(0);
+T1_IFNONNULL:
+		BRANCHIF(t0.v != NULL);
+		TOSDISPATCH(0);
+T1_IALOAD:
+		sp--;
+		t0.i = ((int32_t *)HEAP_DATA(sp[0].v))[t0.i];
+		TOSDISPATCH(1);
+T1_FALOAD:
+		sp--;
+		t0.f = ((float *)HEAP_DATA(sp[0].v))[t0.i];
+		TOSDISPATCH(1);
+T1_AALOAD:
+		sp--;
+		t0.v = heap_load(sp[0].v, t0.i);
+		TOSDISPATCH(1);
+T1_LALOAD:
+		sp--;
+		t0.l = ((int64_t *)HEAP_DATA(sp[0].v))[t0.i];
+		TOSDISPATCH(2);
+T1_DALOAD:
+		sp--;
+		t0.d = ((double *)HEAP_DATA(sp[0].v))[t0.i];
+		TOSDISPATCH(2);
+T1_IASTORE:
+		sp -= 2;
+		((int32_t *)HEAP_DATA(sp[0].v))[sp[1].i] = t0.i;
+		TOSDISPATCH(0);
+T1_FASTORE:
+		sp -= 2;
+		((float *)HEAP_DATA(sp[0].v))[sp[1].i] = t0.f;
+		TOSDISPATCH(0);
+T1_AASTORE:
+		sp -= 2;
+		HEAP_BARRIER(sp[0].v, sp[1].i, t0.v);
+		heap_store(sp[0].v, sp[1].i, t0.v);
+		TOSDISPATCH(0);
+T1_LSHL:
+		sp -= 2;
+		t0.l = sp[0].l << (t0.i & 0x3F);
+		TOSDISPATCH(2);
+T1_LSHR:
+		sp -= 2;
+		t0.l = sp[0].l >> (t0.i & 0x3F);
+		TOSDISPATCH(2);
+T1_LUSHR:
+		sp -= 2;
+		t0.l = (uint64_t)sp[0].l >> (t0.i & 0x3F);
+		TOSDISPATCH(2);
+T1_ARRAYLENGTH:
+		t0.i = t0.v->nmemb;
+		TOSDISPATCH(1);
+T1_IINC:
+		local[ins->u].i += ins->i;
+		TOSDISPATCH(1);
+T1_DUP:
+		*sp++ = t0;
+		TOSDISPATCH(1);
+T1_POP:
+		TOSDISPATCH(0);
+T2_LSTORE:
+		local[ins->u] = t0;
+		TOSDISPATCH(0);
+T2_LADD:
+		sp -= 2;
+		t0.l = sp[0].l + t0.l;
+		TOSDISPATCH(2);
+T2_LSUB:
+		sp -= 2;
+		t0.l = sp[0].l - t0.l;
+		TOSDISPATCH(2);
+T2_LMUL:
+		sp -= 2;
+		t0.l = sp[0].l * t0.l;
+		TOSDISPATCH(2);
+T2_LDIV:
+		sp -= 2;
+		t0.l = sp[0].l / t0.l;
+		TOSDISPATCH(2);
+T2_LREM:
+		sp -= 2;
+		t0.l = sp[0].l % t0.l;
+		TOSDISPATCH(2);
+T2_LAND:
+		sp -= 2;
+		t0.l = sp[0].l & t0.l;
+		TOSDISPATCH(2);
+T2_LOR:
+		sp -= 2;
+		t0.l = sp[0].l | t0.l;
+		TOSDISPATCH(2);
+T2_LXOR:
+		sp -= 2;
+		t0.l = sp[0].l ^ t0.l;
+		TOSDISPATCH(2);
+T2_DADD:
+		sp -= 2;
+		t0.d = sp[0].d + t0.d;
+		TOSDISPATCH(2);
+T2_DSUB:
+		sp -= 2;
+		t0.d = sp[0].d - t0.d;
+		TOSDISPATCH(2);
+T2_DMUL:
+		sp -= 2;
+		t0.d = sp[0].d * t0.d;
+		TOSDISPATCH(2);
+T2_DDIV:
+		sp -= 2;
+		t0.d = sp[0].d / t0.d;
+		TOSDISPATCH(2);
+T2_DREM:
+		sp -= 2;
+		t0.d = fmod(sp[0].d, t0.d);
+		TOSDISPATCH(2);
+T2_LNEG:
+		t0.l = -t0.l;
+		TOSDISPATCH(2);
+T2_DNEG:
+		t0.d = -t0.d;
+		TOSDISPATCH(2);
+T2_L2I:
+		t0.i = t0.l;
+		TOSDISPATCH(1);
+T2_L2F:
+		t0.f = t0.l;
+		TOSDISPATCH(1);
+T2_L2D:
+		t0.d = t0.l;
+		TOSDISPATCH(2);
+T2_D2I:
+		t0.i = t0.d;
+		TOSDISPATCH(1);
+T2_D2L:
+		t0.l = t0.d;
+		TOSDISPATCH(2);
+T2_D2F:
+		t0.f = t0.d;
+		TOSDISPATCH(1);
+T2_LCMP:
+		sp -= 2;
+		t0.i = (sp[0].l > t0.l) - (sp[0].l < t0.l);
+		TOSDISPATCH(1);
+T2_DCMPL:
+		sp -= 2;
+		if (sp[0].d > t0.d)
+			t0.i = 1;
+		else if (sp[0].d == t0.d)
+			t0.i = 0;
+		else if (sp[0].d < t0.d)
+			t0.i = -1;
+		else
+			t0.i = (ins->op == DCMPG) ? 1 : -1;
+		TOSDISPATCH(1);
+T2_LASTORE:
+		sp -= 2;
+		((int64_t *)HEAP_DATA(sp[0].v))[sp[1].i] = t0.l;
+		TOSDISPATCH(0);
+T2_DASTORE:
+		sp -= 2;
+		((double *)HEAP_DATA(sp[0].v))[sp[1].i] = t0.d;
+		TOSDISPATCH(0);
+T2_IINC:
+		local[ins->u].i += ins->i;
+		TOSDISPATCH(2);
+T2_POP2:
+		TOSDISPATCH(0);
+#endif
 
-/* ldiv: divide long */
-static int
-opldiv(Frame *frame)
-{
+	default:
+#ifdef __GNUC__
+unimplemented:
+#endif
+		errx(EXIT_FAILURE, "instruction %02x not implemented (yet)", ins->op);
+	}
+	return RETURN_ERROR;
+backedge:
+	SAVE();
+#ifdef __GNUC__
+	if (tracebranch(frame, ins))
+		table = recordlabels;
+#else
+	(void)tracebranch(frame, ins);
+#endif
+	LOAD();
+	DISPATCH();
+invoke:
+	SAVE();
+	codecount(callcode);
+	if (callcode->jitcode != NULL || callcode->rinstr != NULL) {
+		(void)coderun(callclass, frame, callcode, site->nargs, site->nret);
+		LOAD();
+		DISPATCH();
+	}
+	frame->nstack -= site->nargs;
+	frame = frame_push(callcode, callclass, frame->stack + frame->nstack, site->nargs,
+	                   callcode->max_locals, callcode->max_stack);
+	if (frame == NULL)
+		errx(EXIT_FAILURE, "stack overflow");
+	code = callcode->instr;
+	local = frame->local;
+	LOAD();
+#ifdef __GNUC__
+	if (oppairs == NULL)
+		RETABLE();
+#endif
+	DISPATCH();
+methodreturn:
+	SAVE();
+	if (frame == entry)
+		return (n > 0) ? RETURN_OPERAND : RETURN_VOID;
+	caller = frame->next;
+	memmove(caller->stack + caller->nstack, sp - n, n * sizeof *sp);
+	caller->nstack += n;
+	(void)frame_pop();
+	frame = caller;
+	code = frame->code->instr;
+	local = frame->local;
+	LOAD();
+#ifdef __GNUC__
+	if (oppairs == NULL)
+		RETABLE();
+#endif
+	DISPATCH();
+}
+
+/*
+ * Run register-based code of method on frame until it returns.  The
+ * registers are the local variables and operand stack slots of the
+ * frame, which lie in a single array.
+ */
+static int
+rinterpret(Frame *frame)
+{
+#ifdef __GNUC__
+	static void *labels[R_LAST] = {
+		[R_MOVE]         = &&L_R_MOVE,
+		[R_ICONST]       = &&L_R_ICONST,
+		[R_LCONST]       = &&L_R_LCONST,
+		[R_FCONST]       = &&L_R_FCONST,
+		[R_DCONST]       = &&L_R_DCONST,
+		[R_LDC]          = &&L_R_LDC,
+		[R_NULL]         = &&L_R_NULL,
+		[R_IADD]         = &&L_R_IADD,
+		[R_LADD]         = &&L_R_LADD,
+		[R_FADD]         = &&L_R_FADD,
+		[R_DADD]         = &&L_R_DADD,
+		[R_ISUB]         = &&L_R_ISUB,
+		[R_LSUB]         = &&L_R_LSUB,
+		[R_FSUB]         = &&L_R_FSUB,
+		[R_DSUB]         = &&L_R_DSUB,
+		[R_IMUL]         = &&L_R_IMUL,
+		[R_LMUL]         = &&L_R_LMUL,
+		[R_FMUL]         = &&L_R_FMUL,
+		[R_DMUL]         = &&L_R_DMUL,
+		[R_IDIV]         = &&L_R_IDIV,
+		[R_LDIV]         = &&L_R_LDIV,
+		[R_FDIV]         = &&L_R_FDIV,
+		[R_DDIV]         = &&L_R_DDIV,
+		[R_IREM]         = &&L_R_IREM,
+		[R_LREM]         = &&L_R_LREM,
+		[R_FREM]         = &&L_R_FREM,
+		[R_DREM]         = &&L_R_DREM,
+		[R_INEG]         = &&L_R_INEG,
+		[R_LNEG]         = &&L_R_LNEG,
+		[R_FNEG]         = &&L_R_FNEG,
+		[R_DNEG]         = &&L_R_DNEG,
+		[R_ISHL]         = &&L_R_ISHL,
+		[R_LSHL]         = &&L_R_LSHL,
+		[R_ISHR]         = &&L_R_ISHR,
+		[R_LSHR]         = &&L_R_LSHR,
+		[R_IUSHR]        = &&L_R_IUSHR,
+		[R_LUSHR]        = &&L_R_LUSHR,
+		[R_IAND]         = &&L_R_IAND,
+		[R_LAND]         = &&L_R_LAND,
+		[R_IOR]          = &&L_R_IOR,
+		[R_LOR]          = &&L_R_LOR,
+		[R_IXOR]         = &&L_R_IXOR,
+		[R_LXOR]         = &&L_R_LXOR,
+		[R_IINC]         = &&L_R_IINC,
+		[R_I2L]          = &&L_R_I2L,
+		[R_I2F]          = &&L_R_I2F,
+		[R_I2D]          = &&L_R_I2D,
+		[R_L2I]          = &&L_R_L2I,
+		[R_L2F]          = &&L_R_L2F,
+		[R_L2D]          = &&L_R_L2D,
+		[R_F2I]          = &&L_R_F2I,
+		[R_F2L]          = &&L_R_F2L,
+		[R_F2D]          = &&L_R_F2D,
+		[R_D2I]          = &&L_R_D2I,
+		[R_D2L]          = &&L_R_D2L,
+		[R_D2F]          = &&L_R_D2F,
+		[R_I2B]          = &&L_R_I2B,
+		[R_I2C]          = &&L_R_I2C,
+		[R_I2S]          = &&L_R_I2S,
+		[R_LCMP]         = &&L_R_LCMP,
+		[R_FCMPL]        = &&L_R_FCMPL,
+		[R_FCMPG]        = &&L_R_FCMPG,
+		[R_DCMPL]        = &&L_R_DCMPL,
+		[R_DCMPG]        = &&L_R_DCMPG,
+		[R_IFEQ]         = &&L_R_IFEQ,
+		[R_IFNE]         = &&L_R_IFNE,
+		[R_IFLT]         = &&L_R_IFLT,
+		[R_IFGE]         = &&L_R_IFGE,
+		[R_IFGT]         = &&L_R_IFGT,
+		[R_IFLE]         = &&L_R_IFLE,
+		[R_IF_ICMPEQ]    = &&L_R_IF_ICMPEQ,
+		[R_IF_ICMPNE]    = &&L_R_IF_ICMPNE,
+		[R_IF_ICMPLT]    = &&L_R_IF_ICMPLT,
+		[R_IF_ICMPGE]    = &&L_R_IF_ICMPGE,
+		[R_IF_ICMPGT]    = &&L_R_IF_ICMPGT,
+		[R_IF_ICMPLE]    = &&L_R_IF_ICMPLE,
+		[R_IF_ACMPEQ]    = &&L_R_IF_ACMPEQ,
+		[R_IF_ACMPNE]    = &&L_R_IF_ACMPNE,
+		[R_IFNULL]       = &&L_R_IFNULL,
+		[R_IFNONNULL]    = &&L_R_IFNONNULL,
+		[R_GOTO]         = &&L_R_GOTO,
+		[R_TABLESWITCH]  = &&L_R_TABLESWITCH,
+		[R_LOOKUPSWITCH] = &&L_R_LOOKUPSWITCH,
+		[R_CASE]         = &&unimplemented,
+		[R_IALOAD]       = &&L_R_IALOAD,
+		[R_LALOAD]       = &&L_R_LALOAD,
+		[R_FALOAD]       = &&L_R_FALOAD,
+		[R_DALOAD]       = &&L_R_DALOAD,
+		[R_AALOAD]       = &&L_R_AALOAD,
+		[R_IASTORE]      = &&L_R_IASTORE,
+		[R_LASTORE]      = &&L_R_LASTORE,
+		[R_FASTORE]      = &&L_R_FASTORE,
+		[R_DASTORE]      = &&L_R_DASTORE,
+		[R_AASTORE]      = &&L_R_AASTORE,
+		[R_ARRAYLENGTH]  = &&L_R_ARRAYLENGTH,
+		[R_CALL]         = &&L_R_CALL,
+		[R_RETURN]       = &&L_R_RETURN,
+		[R_RETURN1]      = &&L_R_RETURN1,
+		[R_RETURN2]      = &&L_R_RETURN2,
+	};
+	void **table;
+#endif
+	Value *r;
 	Value v1, v2;
+	Rinstr *code, *pc, *ins;
+	U4 n;
+
+	code = frame->code->rinstr;
+	r = frame->local;
+	pc = code;
+#ifdef __GNUC__
+	table = labels;
+	DISPATCH();
+#else
+dispatch:
+#endif
+	switch ((ins = pc++)->op) {
+	/* moves and constants */
+	TARGET(R_MOVE):
+		r[ins->a] = r[ins->b];
+		DISPATCH();
+	TARGET(R_ICONST):
+		r[ins->a].i = ins->i;
+		DISPATCH();
+	TARGET(R_LCONST):
+		r[ins->a].l = ins->i;
+		DISPATCH();
+	TARGET(R_FCONST):
+		r[ins->a].f = ins->i;
+		DISPATCH();
+	TARGET(R_DCONST):
+		r[ins->a].d = ins->i;
+		DISPATCH();
+	TARGET(R_LDC):
+		r[ins->a] = ins->ins->v;
+		DISPATCH();
+	TARGET(R_NULL):
+		r[ins->a].v = NULL;
+		DISPATCH();
+
+	/* math */
+	TARGET(R_IADD):
+		r[ins->a].i = r[ins->b].i + r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LADD):
+		r[ins->a].l = r[ins->b].l + r[ins->c].l;
+		DISPATCH();
+	TARGET(R_FADD):
+		r[ins->a].f = r[ins->b].f + r[ins->c].f;
+		DISPATCH();
+	TARGET(R_DADD):
+		r[ins->a].d = r[ins->b].d + r[ins->c].d;
+		DISPATCH();
+	TARGET(R_ISUB):
+		r[ins->a].i = r[ins->b].i - r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LSUB):
+		r[ins->a].l = r[ins->b].l - r[ins->c].l;
+		DISPATCH();
+	TARGET(R_FSUB):
+		r[ins->a].f = r[ins->b].f - r[ins->c].f;
+		DISPATCH();
+	TARGET(R_DSUB):
+		r[ins->a].d = r[ins->b].d - r[ins->c].d;
+		DISPATCH();
+	TARGET(R_IMUL):
+		r[ins->a].i = r[ins->b].i * r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LMUL):
+		r[ins->a].l = r[ins->b].l * r[ins->c].l;
+		DISPATCH();
+	TARGET(R_FMUL):
+		r[ins->a].f = r[ins->b].f * r[ins->c].f;
+		DISPATCH();
+	TARGET(R_DMUL):
+		r[ins->a].d = r[ins->b].d * r[ins->c].d;
+		DISPATCH();
+	TARGET(R_IDIV):
+		r[ins->a].i = r[ins->b].i / r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LDIV):
+		r[ins->a].l = r[ins->b].l / r[ins->c].l;
+		DISPATCH();
+	TARGET(R_FDIV):
+		r[ins->a].f = r[ins->b].f / r[ins->c].f;
+		DISPATCH();
+	TARGET(R_DDIV):
+		r[ins->a].d = r[ins->b].d / r[ins->c].d;
+		DISPATCH();
+	TARGET(R_IREM):
+		r[ins->a].i = r[ins->b].i % r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LREM):
+		r[ins->a].l = r[ins->b].l % r[ins->c].l;
+		DISPATCH();
+	TARGET(R_FREM):
+		r[ins->a].f = fmodf(r[ins->b].f, r[ins->c].f);
+		DISPATCH();
+	TARGET(R_DREM):
+		r[ins->a].d = fmod(r[ins->b].d, r[ins->c].d);
+		DISPATCH();
+	TARGET(R_INEG):
+		r[ins->a].i = -r[ins->b].i;
+		DISPATCH();
+	TARGET(R_LNEG):
+		r[ins->a].l = -r[ins->b].l;
+		DISPATCH();
+	TARGET(R_FNEG):
+		r[ins->a].f = -r[ins->b].f;
+		DISPATCH();
+	TARGET(R_DNEG):
+		r[ins->a].d = -r[ins->b].d;
+		DISPATCH();
+	TARGET(R_ISHL):
+		r[ins->a].i = r[ins->b].i << (r[ins->c].i & 0x1F);
+		DISPATCH();
+	TARGET(R_LSHL):
+		r[ins->a].l = r[ins->b].l << (r[ins->c].i & 0x3F);
+		DISPATCH();
+	TARGET(R_ISHR):
+		r[ins->a].i = r[ins->b].i >> (r[ins->c].i & 0x1F);
+		DISPATCH();
+	TARGET(R_LSHR):
+		r[ins->a].l = r[ins->b].l >> (r[ins->c].i & 0x3F);
+		DISPATCH();
+	TARGET(R_IUSHR):
+		r[ins->a].i = (uint32_t)r[ins->b].i >> (r[ins->c].i & 0x1F);
+		DISPATCH();
+	TARGET(R_LUSHR):
+		r[ins->a].l = (uint64_t)r[ins->b].l >> (r[ins->c].i & 0x3F);
+		DISPATCH();
+	TARGET(R_IAND):
+		r[ins->a].i = r[ins->b].i & r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LAND):
+		r[ins->a].l = r[ins->b].l & r[ins->c].l;
+		DISPATCH();
+	TARGET(R_IOR):
+		r[ins->a].i = r[ins->b].i | r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LOR):
+		r[ins->a].l = r[ins->b].l | r[ins->c].l;
+		DISPATCH();
+	TARGET(R_IXOR):
+		r[ins->a].i = r[ins->b].i ^ r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LXOR):
+		r[ins->a].l = r[ins->b].l ^ r[ins->c].l;
+		DISPATCH();
+	TARGET(R_IINC):
+		r[ins->a].i += ins->i;
+		DISPATCH();
+
+	/* conversions */
+	TARGET(R_I2L):
+		r[ins->a].l = r[ins->b].i;
+		DISPATCH();
+	TARGET(R_I2F):
+		r[ins->a].f = r[ins->b].i;
+		DISPATCH();
+	TARGET(R_I2D):
+		r[ins->a].d = r[ins->b].i;
+		DISPATCH();
+	TARGET(R_L2I):
+		r[ins->a].i = r[ins->b].l;
+		DISPATCH();
+	TARGET(R_L2F):
+		r[ins->a].f = r[ins->b].l;
+		DISPATCH();
+	TARGET(R_L2D):
+		r[ins->a].d = r[ins->b].l;
+		DISPATCH();
+	TARGET(R_F2I):
+		r[ins->a].i = r[ins->b].f;
+		DISPATCH();
+	TARGET(R_F2L):
+		r[ins->a].l = r[ins->b].f;
+		DISPATCH();
+	TARGET(R_F2D):
+		r[ins->a].d = r[ins->b].f;
+		DISPATCH();
+	TARGET(R_D2I):
+		r[ins->a].i = r[ins->b].d;
+		DISPATCH();
+	TARGET(R_D2L):
+		r[ins->a].l = r[ins->b].d;
+		DISPATCH();
+	TARGET(R_D2F):
+		r[ins->a].f = r[ins->b].d;
+		DISPATCH();
+	TARGET(R_I2B):
+		r[ins->a].i = (int8_t)r[ins->b].i;
+		DISPATCH();
+	TARGET(R_I2C):
+		r[ins->a].i = (uint16_t)r[ins->b].i;
+		DISPATCH();
+	TARGET(R_I2S):
+		r[ins->a].i = (int16_t)r[ins->b].i;
+		DISPATCH();
+
+	/* comparisons */
+	TARGET(R_LCMP):
+		r[ins->a].i = (r[ins->b].l > r[ins->c].l) - (r[ins->b].l < r[ins->c].l);
+		DISPATCH();
+	TARGET(R_FCMPL):
+	TARGET(R_FCMPG):
+		v1 = r[ins->b];
+		v2 = r[ins->c];
+		if (v1.f > v2.f)
+			r[ins->a].i = 1;
+		else if (v1.f == v2.f)
+			r[ins->a].i = 0;
+		else if (v1.f < v2.f)
+			r[ins->a].i = -1;
+		else
+			r[ins->a].i = (ins->op == R_FCMPG) ? 1 : -1;
+		DISPATCH();
+	TARGET(R_DCMPL):
+	TARGET(R_DCMPG):
+		v1 = r[ins->b];
+		v2 = r[ins->c];
+		if (v1.d > v2.d)
+			r[ins->a].i = 1;
+		else if (v1.d == v2.d)
+			r[ins->a].i = 0;
+		else if (v1.d < v2.d)
+			r[ins->a].i = -1;
+		else
+			r[ins->a].i = (ins->op == R_DCMPG) ? 1 : -1;
+		DISPATCH();
+	TARGET(R_IFEQ):
+		BRANCHIF(r[ins->b].i == 0);
+		DISPATCH();
+	TARGET(R_IFNE):
+		BRANCHIF(r[ins->b].i != 0);
+		DISPATCH();
+	TARGET(R_IFLT):
+		BRANCHIF(r[ins->b].i < 0);
+		DISPATCH();
+	TARGET(R_IFGE):
+		BRANCHIF(r[ins->b].i >= 0);
+		DISPATCH();
+	TARGET(R_IFGT):
+		BRANCHIF(r[ins->b].i > 0);
+		DISPATCH();
+	TARGET(R_IFLE):
+		BRANCHIF(r[ins->b].i <= 0);
+		DISPATCH();
+	TARGET(R_IF_ICMPEQ):
+		BRANCHIF(r[ins->b].i == r[ins->c].i);
+		DISPATCH();
+	TARGET(R_IF_ICMPNE):
+		BRANCHIF(r[ins->b].i != r[ins->c].i);
+		DISPATCH();
+	TARGET(R_IF_ICMPLT):
+		BRANCHIF(r[ins->b].i < r[ins->c].i);
+		DISPATCH();
+	TARGET(R_IF_ICMPGE):
+		BRANCHIF(r[ins->b].i >= r[ins->c].i);
+		DISPATCH();
+	TARGET(R_IF_ICMPGT):
+		BRANCHIF(r[ins->b].i > r[ins->c].i);
+		DISPATCH();
+	TARGET(R_IF_ICMPLE):
+		BRANCHIF(r[ins->b].i <= r[ins->c].i);
+		DISPATCH();
+	TARGET(R_IF_ACMPEQ):
+		BRANCHIF(r[ins->b].v == r[ins->c].v);
+		DISPATCH();
+	TARGET(R_IF_ACMPNE):
+		BRANCHIF(r[ins->b].v != r[ins->c].v);
+		DISPATCH();
+	TARGET(R_IFNULL):
+		BRANCHIF(r[ins->b].v == NULL);
+		DISPATCH();
+	TARGET(R_IFNONNULL):
+		BRANCHIF(r[ins->b].v != NULL);
+		DISPATCH();
+
+	/* control */
+	TARGET(R_GOTO):
+		pc = code + ins->i;
+		DISPATCH();
+	TARGET(R_TABLESWITCH):
+		n = (U4)r[ins->b].i - (U4)ins->ins->v.i;
+		pc = code + (n < ins->ins->u ? pc[n].i : ins->i);
+		DISPATCH();
+	TARGET(R_LOOKUPSWITCH):
+		n = switchcase(ins->ins + 1, ins->ins->u, r[ins->b].i);
+		pc = code + (n < ins->ins->u ? pc[n].i : ins->i);
+		DISPATCH();
+	TARGET(R_RETURN):
+		return RETURN_VOID;
+	TARGET(R_RETURN1):
+		frame->stack[0] = r[ins->b];
+		frame->nstack = 1;
+		return RETURN_OPERAND;
+	TARGET(R_RETURN2):
+		frame->stack[0] = r[ins->b];
+		frame->nstack = 2;
+		return RETURN_OPERAND;
+	TARGET(R_CALL):
+		frame->nstack = ins->a;
+		(void)opstack(frame, ins->ins);
+		DISPATCH();
+
+	/* arrays */
+	TARGET(R_IALOAD):
+		r[ins->a].i = ((int32_t *)HEAP_DATA(r[ins->b].v))[r[ins->c].i];
+		DISPATCH();
+	TARGET(R_LALOAD):
+		r[ins->a].l = ((int64_t *)HEAP_DATA(r[ins->b].v))[r[ins->c].i];
+		DISPATCH();
+	TARGET(R_FALOAD):
+		r[ins->a].f = ((float *)HEAP_DATA(r[ins->b].v))[r[ins->c].i];
+		DISPATCH();
+	TARGET(R_DALOAD):
+		r[ins->a].d = ((double *)HEAP_DATA(r[ins->b].v))[r[ins->c].i];
+		DISPATCH();
+	TARGET(R_AALOAD):
+		r[ins->a].v = heap_load(r[ins->b].v, r[ins->c].i);
+		DISPATCH();
+	TARGET(R_IASTORE):
+		((int32_t *)HEAP_DATA(r[ins->a].v))[r[ins->b].i] = r[ins->c].i;
+		DISPATCH();
+	TARGET(R_LASTORE):
+		((int64_t *)HEAP_DATA(r[ins->a].v))[r[ins->b].i] = r[ins->c].l;
+		DISPATCH();
+	TARGET(R_FASTORE):
+		((float *)HEAP_DATA(r[ins->a].v))[r[ins->b].i] = r[ins->c].f;
+		DISPATCH();
+	TARGET(R_DASTORE):
+		((double *)HEAP_DATA(r[ins->a].v))[r[ins->b].i] = r[ins->c].d;
+		DISPATCH();
+	TARGET(R_AASTORE):
+		HEAP_BARRIER(r[ins->a].v, r[ins->b].i, r[ins->c].v);
+		heap_store(r[ins->a].v, r[ins->b].i, r[ins->c].v);
+		DISPATCH();
+	TARGET(R_ARRAYLENGTH):
+		r[ins->a].i = r[ins->b].v->nmemb;
+		DISPATCH();
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l /= v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
-}
-
-/* lload: load long from local variable */
-static int
-oplload(Frame *frame)
-{
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++];
-	v = frame_localload(frame, i);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* lload_0: load long from local variable */
-static int
-oplload_0(Frame *frame)
-{
-	Value v;
-
-	v = frame_localload(frame, 0);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* lload_1: load long from local variable */
-static int
-oplload_1(Frame *frame)
-{
-	Value v;
-
-	v = frame_localload(frame, 1);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* lload_2: load long from local variable */
-static int
-oplload_2(Frame *frame)
-{
-	Value v;
-
-	v = frame_localload(frame, 2);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
+	default:
+#ifdef __GNUC__
+unimplemented:
+#endif
+		errx(EXIT_FAILURE, "register instruction %02x not implemented", ins->op);
+	}
+	return RETURN_ERROR;
+}
+
+/*
+ * Baseline compiler.  A method called JITTHRESHOLD times is compiled
+ * into x86-64 machine code by stitching together a fixed template for
+ * each of its instructions.  The templates keep the operand stack in
+ * memory, in the frame, with its top in rbx; the local variable array
+ * is in r12 and the frame in r13.  Instructions without a template of
+ * their own (invokes, static fields, array creation) call opstack(),
+ * so calls between compiled and interpreted methods go through
+ * codecall() as usual.  A method with an instruction that has neither
+ * (floating point arithmetic, switches, object instructions) is left to
+ * the interpreter.  Compiled methods are copied into a code cache that
+ * is kept executable and is made writable only while a method is added.
+ */
+#if defined(__x86_64__) && !defined(_WIN32)
 
-/* lload_3: load long from local variable */
-static int
-oplload_3(Frame *frame)
-{
-	Value v;
+enum {
+	RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7, R12 = 12, R13 = 13,
+};
 
-	v = frame_localload(frame, 3);
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
+/* condition codes of the jcc instruction */
+enum {
+	CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF,
+};
 
-/* lmul: multiply long */
-static int
-oplmul(Frame *frame)
+#define SLOT(k)         ((I4)(k) * (I4)sizeof(Value))
+
+/* method being compiled */
+typedef struct Jit {
+	U1     *buf;                    /* machine code */
+	size_t  len;                    /* bytes of machine code */
+	size_t  size;                   /* bytes allocated for machine code */
+	int     full;                   /* whether the machine code did not fit */
+	size_t *mpc;                    /* offset of the code of each instruction */
+	struct {
+		size_t  at;             /* offset of the rel32 operand of a jump */
+		I4      target;         /* index of the instruction it jumps to */
+	}      *fix;
+	size_t  nfix;
+	struct {
+		size_t  at;             /* offset of the rel32 operand of a jump */
+		U4      pc;             /* instruction index where the interpreter resumes */
+	}      *exit;                   /* jumps out of a trace */
+	size_t  nexit;
+} Jit;
+
+static U1 *jitcache = NULL;             /* executable memory for compiled methods */
+static size_t jitused = 0;              /* bytes of the code cache in use */
+
+/* emit bytes; if they do not fit, emit nothing and mark the compilation as failed */
+static void
+jitbytes(Jit *jit, int n, ...)
 {
-	Value v1, v2;
+	va_list ap;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l *= v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	if (jit->full || jit->len + n > jit->size) {
+		jit->full = 1;
+		return;
+	}
+	va_start(ap, n);
+	while (n-- > 0)
+		jit->buf[jit->len++] = (U1)va_arg(ap, int);
+	va_end(ap);
 }
 
-/* lneg: negate long */
-static int
-oplneg(Frame *frame)
+/* emit 32-bit immediate */
+static void
+jitimm32(Jit *jit, U4 x)
 {
-	Value v;
-
-	v = frame_stackpop(frame);
-	v.l = -v.l;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	jitbytes(jit, 4, x & 0xFF, (x >> 8) & 0xFF, (x >> 16) & 0xFF, x >> 24);
 }
 
-/* lookupswitch: access jump table by key match and jump */
-static int
-oplookupswitch(Frame *frame)
+/* emit 64-bit immediate */
+static void
+jitimm64(Jit *jit, U8 x)
 {
-	int32_t def, npairs, match, offset, j;
-	U4 a, b, c, d, baseaddr, targetaddr;
-	Value v;
-
-	baseaddr = frame->pc - 1;
-	while (frame->pc % 4)
-		frame->pc++;
-	v = frame_stackpop(frame);
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	def = (a << 24) | (b << 16) | (c << 8) | d;
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	npairs = (a << 24) | (b << 16) | (c << 8) | d;
-	targetaddr = baseaddr + def;
-	for (j = 0; j <= npairs; j++) {
-		a = frame->code->code[frame->pc++];
-		b = frame->code->code[frame->pc++];
-		c = frame->code->code[frame->pc++];
-		d = frame->code->code[frame->pc++];
-		match = (a << 24) | (b << 16) | (c << 8) | d;
-		a = frame->code->code[frame->pc++];
-		b = frame->code->code[frame->pc++];
-		c = frame->code->code[frame->pc++];
-		d = frame->code->code[frame->pc++];
-		offset = (a << 24) | (b << 16) | (c << 8) | d;
-		if (v.i == match) {
-			targetaddr = baseaddr + offset;
-			break;
-		}
-	}
-	frame->pc = targetaddr;
-	return NO_RETURN;
+	jitimm32(jit, (U4)x);
+	jitimm32(jit, (U4)(x >> 32));
 }
 
-/* lor: boolean OR long */
-static int
-oplor(Frame *frame)
+/* emit instruction with opcode op (one or two bytes) on register reg and memory at [base + disp] */
+static void
+jitmem(Jit *jit, int w, int op, int reg, int base, I4 disp)
 {
-	Value v1, v2;
+	U1 rex;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l |= v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	rex = 0x40 | (w ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((base & 8) ? 0x01 : 0);
+	if (rex != 0x40)
+		jitbytes(jit, 1, rex);
+	if (op > 0xFF)
+		jitbytes(jit, 1, op >> 8);
+	jitbytes(jit, 2, op & 0xFF, 0x80 | (reg & 7) << 3 | (base & 7));
+	if ((base & 7) == 4)
+		jitbytes(jit, 1, 0x24);
+	jitimm32(jit, (U4)disp);
 }
 
-/* lrem: remainder long */
-static int
-oplrem(Frame *frame)
+/* emit "add rbx, n * sizeof(Value)", moving the top of the operand stack by n slots */
+static void
+jitsp(Jit *jit, int n)
 {
-	Value v1, v2;
-
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l = v1.l - (v1.l / v2.l) * v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	if (n == 0)
+		return;
+	jitbytes(jit, 3, 0x48, 0x81, 0xC3);
+	jitimm32(jit, (U4)SLOT(n));
 }
 
-/* lstore: store long into local variable */
-static int
-oplstore(Frame *frame)
+/* emit jump to instruction, conditional unless cc is negative */
+static void
+jitjump(Jit *jit, int cc, I4 target)
 {
-	Value v;
-	U2 i;
-
-	i = frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	frame_localstore(frame, i, v);
-	frame_localstore(frame, i + 1, v);
-	return NO_RETURN;
+	if (cc < 0)
+		jitbytes(jit, 1, 0xE9);
+	else
+		jitbytes(jit, 2, 0x0F, 0x80 | cc);
+	jit->fix[jit->nfix].at = jit->len;
+	jit->fix[jit->nfix++].target = target;
+	jitimm32(jit, 0);
 }
-
-/* lstore_0: store long into local variable */
-static int
-oplstore_0(Frame *frame)
-{
-	Value v;
-
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 0, v);
-	frame_localstore(frame, 1, v);
-	return NO_RETURN;
+
+/* emit code writing the depth of the operand stack back to the frame */
+static void
+jitsave(Jit *jit)
+{
+	jitbytes(jit, 3, 0x48, 0x89, 0xD8);                             /* mov rax, rbx */
+	jitmem(jit, 1, 0x2B, RAX, R13, offsetof(Frame, stack));        /* sub rax, [r13 + stack] */
+	jitbytes(jit, 4, 0x48, 0xC1, 0xF8, 0x03);                       /* sar rax, 3 */
+	jitmem(jit, 1, 0x89, RAX, R13, offsetof(Frame, nstack));       /* mov [r13 + nstack], rax */
 }
 
-/* lstore_1: store long into local variable */
-static int
-oplstore_1(Frame *frame)
+/* emit code returning ret from the compiled method */
+static void
+jitreturn(Jit *jit, int ret)
 {
-	Value v;
+	jitsave(jit);
+	jitbytes(jit, 1, 0xB8);                                         /* mov eax, ret */
+	jitimm32(jit, (U4)ret);
+	jitbytes(jit, 8, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B); /* pop r14, r13, r12, rbp, rbx */
+	jitbytes(jit, 1, 0xC3);                                         /* ret */
+}
 
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 1, v);
-	frame_localstore(frame, 2, v);
-	return NO_RETURN;
+/* emit code running instruction out of line with opstack() */
+static void
+jitcall(Jit *jit, Instr *ins)
+{
+	jitsave(jit);
+	jitbytes(jit, 3, 0x4C, 0x89, 0xEF);                             /* mov rdi, r13 */
+	jitbytes(jit, 2, 0x48, 0xBE);                                   /* mov rsi, ins */
+	jitimm64(jit, (U8)(uintptr_t)ins);
+	jitbytes(jit, 2, 0x48, 0xB8);                                   /* mov rax, opstack */
+	jitimm64(jit, (U8)(uintptr_t)opstack);
+	jitbytes(jit, 2, 0xFF, 0xD0);                                   /* call rax */
+	jitmem(jit, 1, 0x8B, RAX, R13, offsetof(Frame, nstack));       /* mov rax, [r13 + nstack] */
+	jitmem(jit, 1, 0x8B, RBX, R13, offsetof(Frame, stack));        /* mov rbx, [r13 + stack] */
+	jitbytes(jit, 4, 0x48, 0x8D, 0x1C, 0xC3);                       /* lea rbx, [rbx + rax * 8] */
 }
 
-/* lstore_2: store long into local variable */
-static int
-oplstore_2(Frame *frame)
+/* emit code leaving in rax the elements of the array and in rcx the index, both under n slots */
+static void
+jitelem(Jit *jit, int n)
 {
-	Value v;
+	jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(n));                       /* mov rax, arrayref */
+	jitmem(jit, 1, 0x8D, RAX, RAX, HEAP_HEADER);                    /* lea rax, [rax + header] */
+	jitmem(jit, 1, 0x63, RCX, RBX, SLOT(n + 1));                   /* movsxd rcx, index */
+}
 
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 2, v);
-	frame_localstore(frame, 3, v);
-	return NO_RETURN;
+/*
+ * emit the write barrier of the overwrite of the element of the array
+ * on the top of the operand stack, or of its field at offset off if off
+ * is not negative, while marking concurrently
+ */
+static void
+jitoverwrite(Jit *jit, I4 off)
+{
+	size_t skip;
+
+	jitbytes(jit, 2, 0x48, 0xB8);                                   /* mov rax, &heapmarking */
+	jitimm64(jit, (U8)(uintptr_t)&heapmarking);
+	jitbytes(jit, 5, 0x83, 0x38, 0x00, 0x74, 0);                    /* cmp dword [rax], 0; jz skip */
+	skip = jit->len;
+	jitmem(jit, 1, 0x8B, RDI, RBX, 0);                              /* mov rdi, objectref */
+	if (off >= 0) {
+		jitbytes(jit, 1, 0xBE);                                 /* mov esi, off */
+		jitimm32(jit, (U4)off);
+		jitbytes(jit, 2, 0x48, 0xB8);                           /* mov rax, heap_overwritefield */
+		jitimm64(jit, (U8)(uintptr_t)heap_overwritefield);
+	} else {
+		jitmem(jit, 1, 0x63, RSI, RBX, SLOT(1));               /* movsxd rsi, index */
+		jitbytes(jit, 2, 0x48, 0xB8);                           /* mov rax, heap_overwrite */
+		jitimm64(jit, (U8)(uintptr_t)heap_overwrite);
+	}
+	jitbytes(jit, 2, 0xFF, 0xD0);                                   /* call rax */
+	jit->buf[skip - 1] = (U1)(jit->len - skip);
 }
 
-/* lstore_3: store long into local variable */
-static int
-oplstore_3(Frame *frame)
+/* emit code expanding the compressed reference in eax into rax */
+static void
+jitdecompress(Jit *jit)
 {
-	Value v;
+	size_t skip;
 
-	v = frame_stackpop(frame);
-	frame_localstore(frame, 3, v);
-	frame_localstore(frame, 4, v);
-	return NO_RETURN;
+	jitbytes(jit, 5, 0x48, 0x85, 0xC0, 0x74, 0);                    /* test rax, rax; jz skip */
+	skip = jit->len;
+	if (heapshift > 0)
+		jitbytes(jit, 4, 0x48, 0xC1, 0xE0, heapshift);          /* shl rax, heapshift */
+	jitbytes(jit, 2, 0x48, 0xBA);                                   /* mov rdx, heapbase */
+	jitimm64(jit, (U8)(uintptr_t)heapbase);
+	jitbytes(jit, 3, 0x48, 0x01, 0xD0);                             /* add rax, rdx */
+	jit->buf[skip - 1] = (U1)(jit->len - skip);
 }
 
-/* lsub: subtract long */
-static int
-oplsub(Frame *frame)
+/* emit code leaving in esi the reference in rdx, compressed */
+static void
+jitcompress(Jit *jit)
 {
-	Value v1, v2;
+	size_t skip;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l -= v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	jitbytes(jit, 8, 0x48, 0x89, 0xD6, 0x48, 0x85, 0xF6, 0x74, 0);  /* mov rsi, rdx; test rsi, rsi; jz skip */
+	skip = jit->len;
+	jitbytes(jit, 2, 0x48, 0xBF);                                   /* mov rdi, heapbase */
+	jitimm64(jit, (U8)(uintptr_t)heapbase);
+	jitbytes(jit, 3, 0x48, 0x29, 0xFE);                             /* sub rsi, rdi */
+	if (heapshift > 0)
+		jitbytes(jit, 4, 0x48, 0xC1, 0xEE, heapshift);          /* shr rsi, heapshift */
+	jit->buf[skip - 1] = (U1)(jit->len - skip);
 }
 
-/* lxor: boolean XOR long */
-static int
-oplxor(Frame *frame)
+/* emit the write barrier of the store of the reference in rdx into the array or instance on the top of the operand stack */
+static void
+jitbarrier(Jit *jit)
 {
-	Value v1, v2;
+	size_t skip[3];
+	int i;
 
-	v2 = frame_stackpop(frame);
-	v1 = frame_stackpop(frame);
-	v1.l ^= v2.l;
-	frame_stackpush(frame, v1);
-	return NO_RETURN;
+	jitmem(jit, 1, 0x8B, RAX, RBX, 0);                              /* mov rax, arrayref */
+	jitmem(jit, 0, 0xF6, 0, RAX, offsetof(Heap, flags));            /* test byte [rax + flags], ... */
+	jitbytes(jit, 3, HEAP_YOUNG | HEAP_DIRTY, 0x75, 0);             /* ... HEAP_YOUNG | HEAP_DIRTY; jnz skip */
+	skip[0] = jit->len;
+	jitbytes(jit, 5, 0x48, 0x85, 0xD2, 0x74, 0);                    /* test rdx, rdx; jz skip */
+	skip[1] = jit->len;
+	jitmem(jit, 0, 0xF6, 0, RDX, offsetof(Heap, flags));            /* test byte [rdx + flags], ... */
+	jitbytes(jit, 3, HEAP_YOUNG, 0x74, 0);                          /* ... HEAP_YOUNG; jz skip */
+	skip[2] = jit->len;
+	jitbytes(jit, 3, 0x48, 0x89, 0xC7);                             /* mov rdi, rax */
+	jitbytes(jit, 2, 0x48, 0xB8);                                   /* mov rax, heap_remember */
+	jitimm64(jit, (U8)(uintptr_t)heap_remember);
+	jitbytes(jit, 2, 0xFF, 0xD0);                                   /* call rax */
+	for (i = 0; i < 3; i++)
+		jit->buf[skip[i] - 1] = (U1)(jit->len - skip[i]);
+}
+
+/* emit code popping the operands of a conditional branch and comparing them; return the condition code of the jump */
+static int
+jitcompare(Jit *jit, U2 op)
+{
+	static const U1 cc[] = {CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE};
+
+	switch (op) {
+	case IFNULL: case IFNONNULL:
+		jitsp(jit, -1);
+		jitmem(jit, 1, 0x83, 7, RBX, 0);                        /* cmp qword [rbx], 0 */
+		jitbytes(jit, 1, 0);
+		return (op == IFNULL) ? CC_E : CC_NE;
+	case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+		jitsp(jit, -1);
+		jitmem(jit, 0, 0x83, 7, RBX, 0);                        /* cmp dword [rbx], 0 */
+		jitbytes(jit, 1, 0);
+		return cc[op - IFEQ];
+	default:
+		jitsp(jit, -2);
+		jitmem(jit, op >= IF_ACMPEQ, 0x8B, RAX, RBX, 0);
+		jitmem(jit, op >= IF_ACMPEQ, 0x3B, RAX, RBX, SLOT(1));  /* cmp rax, [rbx + 8] */
+		return (op >= IF_ACMPEQ) ? cc[op - IF_ACMPEQ] : cc[op - IF_ICMPEQ];
+	}
 }
 
-/* multianewarray: create new multidimensional array */
+/* emit code of instruction; return -1 if it has no template */
 static int
-opmultianewarray(Frame *frame)
+jitinstr(Jit *jit, Instr *ins)
 {
 	Value v;
-	Heap *h;
-	char *type;
-	int32_t *sizes;
-	U1 i, dimension;
-	U2 index;
-	size_t s;
+	U2 op;
 
-	index = frame->code->code[frame->pc++] << 8;
-	index = frame->code->code[frame->pc++];
-	dimension = frame->code->code[frame->pc++];
-	sizes = ecalloc(dimension, sizeof *sizes);
-	type = class_getclassname(frame->class, index);
-	switch (*type) {
-	case TYPE_REFERENCE:
-	case TYPE_ARRAY:
-		s = sizeof (void *);
+	/* the quickened field accesses keep the width of their field */
+	op = (ins->op == LDC_STRING || (ins->op >= GETFIELD_BYTE && ins->op <= PUTSTATIC_WIDE)) ? ins->op : opfold(ins->op);
+	switch (op) {
+	case NOP:
 		break;
-	case TYPE_DOUBLE:
-	case TYPE_LONG:
-		s = sizeof (int64_t);
+	case BIPUSH:
+		jitmem(jit, 0, 0xC7, 0, RBX, 0);                        /* mov dword [rbx], i */
+		jitimm32(jit, (U4)ins->i);
+		jitsp(jit, 1);
 		break;
-	default:
-		s = sizeof (int32_t);
+	case LCONST_0: case LCONST_1:
+	case LDC: case LDC_W: case LDC2_W:
+		v = ins->v;
+		if (op == LCONST_0 || op == LCONST_1)
+			v.l = op - LCONST_0;
+		jitbytes(jit, 2, 0x48, 0xB8);                           /* mov rax, v */
+		jitimm64(jit, (U8)v.l);
+		jitmem(jit, 1, 0x89, RAX, RBX, 0);                      /* mov [rbx], rax */
+		jitsp(jit, (op == LDC || op == LDC_W) ? 1 : 2);
 		break;
-	}
-	for (i = 0; i < dimension; i++) {
-		v = frame_stackpop(frame);
-		if (v.i < 0) {
-			// TODO: throw NegativeArraySizeException
+	case ILOAD: case FLOAD: case ALOAD: case LLOAD: case DLOAD:
+		jitmem(jit, 1, 0x8B, RAX, R12, SLOT(ins->u));          /* mov rax, local */
+		jitmem(jit, 1, 0x89, RAX, RBX, 0);                      /* mov [rbx], rax */
+		jitsp(jit, (op == LLOAD || op == DLOAD) ? 2 : 1);
+		break;
+	case ISTORE: case FSTORE: case ASTORE: case LSTORE: case DSTORE:
+		jitsp(jit, (op == LSTORE || op == DSTORE) ? -2 : -1);
+		jitmem(jit, 1, 0x8B, RAX, RBX, 0);                      /* mov rax, [rbx] */
+		jitmem(jit, 1, 0x89, RAX, R12, SLOT(ins->u));          /* mov local, rax */
+		break;
+	case IALOAD: case BALOAD: case CALOAD: case SALOAD: case FALOAD:
+		jitelem(jit, -2);
+		jitbytes(jit, 3, 0x8B, 0x04, 0x88);                     /* mov eax, [rax + rcx * 4] */
+		jitmem(jit, 0, 0x89, RAX, RBX, SLOT(-2));
+		jitsp(jit, -1);
+		break;
+	case LALOAD: case DALOAD: case AALOAD:
+		jitelem(jit, -2);
+		if (op == AALOAD && heapbase != NULL) {
+			jitbytes(jit, 3, 0x8B, 0x04, 0x88);             /* mov eax, [rax + rcx * 4] */
+			jitdecompress(jit);
+		} else {
+			jitbytes(jit, 4, 0x48, 0x8B, 0x04, 0xC8);       /* mov rax, [rax + rcx * 8] */
 		}
-		if (v.i == 0) {
-			// TODO: handle zero size
+		jitmem(jit, 1, 0x89, RAX, RBX, SLOT(-2));
+		if (op == AALOAD)
+			jitsp(jit, -1);
+		break;
+	case IASTORE: case BASTORE: case CASTORE: case SASTORE: case FASTORE:
+		jitsp(jit, -3);
+		jitelem(jit, 0);
+		jitmem(jit, 0, 0x8B, RDX, RBX, SLOT(2));               /* mov edx, value */
+		jitbytes(jit, 3, 0x89, 0x14, 0x88);                     /* mov [rax + rcx * 4], edx */
+		break;
+	case LASTORE: case DASTORE: case AASTORE:
+		jitsp(jit, (op == AASTORE) ? -3 : -4);
+		if (op == AASTORE)
+			jitoverwrite(jit, -1);
+		jitelem(jit, 0);
+		jitmem(jit, 1, 0x8B, RDX, RBX, SLOT(2));               /* mov rdx, value */
+		if (op == AASTORE && heapbase != NULL) {
+			jitcompress(jit);
+			jitbytes(jit, 3, 0x89, 0x34, 0x88);             /* mov [rax + rcx * 4], esi */
+		} else {
+			jitbytes(jit, 4, 0x48, 0x89, 0x14, 0xC8);       /* mov [rax + rcx * 8], rdx */
 		}
-		sizes[dimension - i - 1] = v.i;
-	}
-	h = array_new(sizes, dimension, s);
-	if (h == NULL) {
-		// TODO: throw error
-	}
-	v.v = h;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
-}
-
-/* newarray: create new array */
-static int
-opnewarray(Frame *frame)
-{
-	Value v;
-	U1 type;
-	Heap *h;
-	size_t s;
-
-	type = frame->code->code[frame->pc++];
-	v = frame_stackpop(frame);
-	switch (type) {
-	case T_LONG:
-		s = sizeof (int64_t);
+		if (op == AASTORE)
+			jitbarrier(jit);
 		break;
-	case T_DOUBLE:
-		s = sizeof (double);
+	case GETFIELD_BYTE: case GETFIELD_CHAR: case GETFIELD_SHORT:
+	case GETFIELD_INT: case GETFIELD_LONG: case GETFIELD_REF:
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-1));               /* mov rax, objectref */
+		switch (op) {
+		case GETFIELD_BYTE:
+			jitmem(jit, 0, 0x0FBE, RAX, RAX, HEAP_HEADER + ins->i);    /* movsx eax, byte [rax + off] */
+			break;
+		case GETFIELD_CHAR:
+			jitmem(jit, 0, 0x0FB7, RAX, RAX, HEAP_HEADER + ins->i);    /* movzx eax, word [rax + off] */
+			break;
+		case GETFIELD_SHORT:
+			jitmem(jit, 0, 0x0FBF, RAX, RAX, HEAP_HEADER + ins->i);    /* movsx eax, word [rax + off] */
+			break;
+		case GETFIELD_INT:
+			jitmem(jit, 0, 0x8B, RAX, RAX, HEAP_HEADER + ins->i);      /* mov eax, [rax + off] */
+			break;
+		case GETFIELD_REF:
+			if (heapbase != NULL) {
+				jitmem(jit, 0, 0x8B, RAX, RAX, HEAP_HEADER + ins->i);
+				jitdecompress(jit);
+				break;
+			}
+			/* FALLTHROUGH */
+		default:
+			jitmem(jit, 1, 0x8B, RAX, RAX, HEAP_HEADER + ins->i);      /* mov rax, [rax + off] */
+			break;
+		}
+		jitmem(jit, 1, 0x89, RAX, RBX, SLOT(-1));
+		if (op == GETFIELD_LONG)
+			jitsp(jit, 1);
 		break;
-	case T_FLOAT:
-		s = sizeof (float);
+	case PUTFIELD_BYTE: case PUTFIELD_SHORT: case PUTFIELD_INT:
+	case PUTFIELD_LONG: case PUTFIELD_REF:
+		jitsp(jit, (op == PUTFIELD_LONG) ? -3 : -2);
+		if (op == PUTFIELD_REF)
+			jitoverwrite(jit, ins->i);
+		jitmem(jit, 1, 0x8B, RAX, RBX, 0);                      /* mov rax, objectref */
+		jitmem(jit, 1, 0x8B, RDX, RBX, SLOT(1));               /* mov rdx, value */
+		switch (op) {
+		case PUTFIELD_BYTE:
+			jitmem(jit, 0, 0x88, RDX, RAX, HEAP_HEADER + ins->i);      /* mov [rax + off], dl */
+			break;
+		case PUTFIELD_SHORT:
+			jitbytes(jit, 1, 0x66);
+			jitmem(jit, 0, 0x89, RDX, RAX, HEAP_HEADER + ins->i);      /* mov [rax + off], dx */
+			break;
+		case PUTFIELD_INT:
+			jitmem(jit, 0, 0x89, RDX, RAX, HEAP_HEADER + ins->i);      /* mov [rax + off], edx */
+			break;
+		case PUTFIELD_REF:
+			if (heapbase != NULL) {
+				jitcompress(jit);
+				jitmem(jit, 0, 0x89, RSI, RAX, HEAP_HEADER + ins->i);  /* mov [rax + off], esi */
+				break;
+			}
+			/* FALLTHROUGH */
+		default:
+			jitmem(jit, 1, 0x89, RDX, RAX, HEAP_HEADER + ins->i);      /* mov [rax + off], rdx */
+			break;
+		}
+		if (op == PUTFIELD_REF)
+			jitbarrier(jit);
 		break;
-	default:
-		s = sizeof (int32_t);
+	case GETSTATIC_QUICK: case GETSTATIC_WIDE:
+		jitbytes(jit, 2, 0x48, 0xB8);                           /* mov rax, address */
+		jitimm64(jit, (U8)(uintptr_t)ins->p);
+		jitmem(jit, 1, 0x8B, RAX, RAX, 0);                      /* mov rax, [rax] */
+		jitmem(jit, 1, 0x89, RAX, RBX, 0);                      /* mov [rbx], rax */
+		jitsp(jit, (op == GETSTATIC_WIDE) ? 2 : 1);
 		break;
+	case PUTSTATIC_QUICK: case PUTSTATIC_WIDE:
+		jitsp(jit, (op == PUTSTATIC_WIDE) ? -2 : -1);
+		jitmem(jit, 1, 0x8B, RDX, RBX, 0);                      /* mov rdx, [rbx] */
+		jitbytes(jit, 2, 0x48, 0xB8);                           /* mov rax, address */
+		jitimm64(jit, (U8)(uintptr_t)ins->p);
+		jitmem(jit, 1, 0x89, RDX, RAX, 0);                      /* mov [rax], rdx */
+		break;
+	case ARRAYLENGTH:
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-1));
+		jitmem(jit, 0, 0x8B, RAX, RAX, offsetof(Heap, nmemb));
+		jitmem(jit, 0, 0x89, RAX, RBX, SLOT(-1));
+		break;
+	case POP:
+		jitsp(jit, -1);
+		break;
+	case POP2:
+		jitsp(jit, -2);
+		break;
+	case DUP:
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-1));
+		jitmem(jit, 1, 0x89, RAX, RBX, 0);
+		jitsp(jit, 1);
+		break;
+	case DUP2:
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-2));
+		jitmem(jit, 1, 0x89, RAX, RBX, 0);
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-1));
+		jitmem(jit, 1, 0x89, RAX, RBX, SLOT(1));
+		jitsp(jit, 2);
+		break;
+	case DUP_X1:
+	case SWAP:
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-1));
+		jitmem(jit, 1, 0x8B, RCX, RBX, SLOT(-2));
+		jitmem(jit, 1, 0x89, RAX, RBX, SLOT(-2));
+		jitmem(jit, 1, 0x89, RCX, RBX, SLOT(-1));
+		if (op == DUP_X1) {
+			jitmem(jit, 1, 0x89, RAX, RBX, 0);
+			jitsp(jit, 1);
+		}
+		break;
+	case IADD: case ISUB: case IAND: case IOR: case IXOR:
+	case LADD: case LSUB: case LAND: case LOR: case LXOR:
+		jitsp(jit, (op & 1) ? -2 : -1);
+		jitmem(jit, op & 1, 0x8B, RAX, RBX, 0);
+		jitmem(jit, op & 1,
+		       (op <= LADD) ? 0x01 : (op <= LSUB) ? 0x29 : (op <= LAND) ? 0x21 : (op <= LOR) ? 0x09 : 0x31,
+		       RAX, RBX, SLOT((op & 1) ? -2 : -1));            /* op [second operand], rax */
+		break;
+	case IMUL: case LMUL:
+		jitsp(jit, (op == LMUL) ? -2 : -1);
+		jitmem(jit, op == LMUL, 0x8B, RAX, RBX, SLOT((op == LMUL) ? -2 : -1));
+		jitmem(jit, op == LMUL, 0x0FAF, RAX, RBX, 0);          /* imul rax, [rbx] */
+		jitmem(jit, op == LMUL, 0x89, RAX, RBX, SLOT((op == LMUL) ? -2 : -1));
+		break;
+	case IDIV: case IREM: case LDIV: case LREM:
+		jitsp(jit, (op & 1) ? -2 : -1);
+		jitmem(jit, op & 1, 0x8B, RAX, RBX, SLOT((op & 1) ? -2 : -1));
+		if (op & 1)
+			jitbytes(jit, 2, 0x48, 0x99);                   /* cqo */
+		else
+			jitbytes(jit, 1, 0x99);                         /* cdq */
+		jitmem(jit, op & 1, 0xF7, 7, RBX, 0);                   /* idiv [rbx] */
+		jitmem(jit, op & 1, 0x89, (op <= LDIV) ? RAX : RDX, RBX, SLOT((op & 1) ? -2 : -1));
+		break;
+	case INEG:
+		jitmem(jit, 0, 0xF7, 3, RBX, SLOT(-1));                 /* neg dword [rbx - 8] */
+		break;
+	case LNEG:
+		jitmem(jit, 1, 0xF7, 3, RBX, SLOT(-2));
+		break;
+	case ISHL: case LSHL: case ISHR: case LSHR: case IUSHR: case LUSHR:
+		jitsp(jit, -1);
+		jitmem(jit, 0, 0x8B, RCX, RBX, 0);                      /* mov ecx, [rbx] */
+		jitmem(jit, op & 1, 0xD3,
+		       (op <= LSHL) ? 4 : (op <= LSHR) ? 7 : 5,
+		       RBX, SLOT((op & 1) ? -2 : -1));                  /* shl/sar/shr [value], cl */
+		break;
+	case IINC:
+		jitmem(jit, 0, 0x81, 0, R12, SLOT(ins->u));            /* add dword local, i */
+		jitimm32(jit, (U4)ins->i);
+		break;
+	case I2L:
+		jitmem(jit, 1, 0x63, RAX, RBX, SLOT(-1));              /* movsxd rax, [rbx - 8] */
+		jitmem(jit, 1, 0x89, RAX, RBX, SLOT(-1));
+		jitsp(jit, 1);
+		break;
+	case L2I:
+		jitsp(jit, -1);
+		break;
+	case I2B: case I2C: case I2S:
+		jitmem(jit, 0, (op == I2B) ? 0x0FBE : (op == I2C) ? 0x0FB7 : 0x0FBF, RAX, RBX, SLOT(-1));
+		jitmem(jit, 0, 0x89, RAX, RBX, SLOT(-1));
+		break;
+	case LCMP:
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-4));
+		jitmem(jit, 1, 0x3B, RAX, RBX, SLOT(-2));              /* cmp rax, [rbx - 16] */
+		jitbytes(jit, 3, 0x0F, 0x9F, 0xC1);                     /* setg cl */
+		jitbytes(jit, 3, 0x0F, 0x9C, 0xC0);                     /* setl al */
+		jitbytes(jit, 3, 0x0F, 0xB6, 0xC9);                     /* movzx ecx, cl */
+		jitbytes(jit, 3, 0x0F, 0xB6, 0xC0);                     /* movzx eax, al */
+		jitbytes(jit, 2, 0x29, 0xC1);                           /* sub ecx, eax */
+		jitmem(jit, 0, 0x89, RCX, RBX, SLOT(-4));
+		jitsp(jit, -3);
+		break;
+	case IFEQ: case IFNE: case IFLT: case IFGE: case IFGT: case IFLE:
+	case IF_ICMPEQ: case IF_ICMPNE: case IF_ICMPLT:
+	case IF_ICMPGE: case IF_ICMPGT: case IF_ICMPLE:
+	case IF_ACMPEQ: case IF_ACMPNE: case IFNULL: case IFNONNULL:
+		jitjump(jit, jitcompare(jit, op), ins->i);
+		break;
+	case GOTO:
+		jitjump(jit, -1, ins->i);
+		break;
+	case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN:
+		jitreturn(jit, RETURN_OPERAND);
+		break;
+	case RETURN:
+		jitreturn(jit, RETURN_VOID);
+		break;
+	case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+	case INVOKESTATIC: case INVOKESPECIAL: case INVOKEVIRTUAL:
+	case NEW: case NEWARRAY: case MULTIANEWARRAY: case LDC_STRING: case ACONST_NULL:
+		jitcall(jit, ins);
+		break;
+	default:
+		return -1;
 	}
-	if (v.i < 0) {
-		// TODO: throw NegativeArraySizeException
-	}
-	if (v.i == 0) {
-		// TODO: handle zero size
-	}
-	h = array_new(&v.i, 1, s);
-	v.v = h;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+	return 0;
 }
 
-/* nop: do nothing */
-static int
-opnop(Frame *frame)
-{
-	(void)frame;
-	errx(EXIT_FAILURE, "instruction %02x not implemented (yet)", frame->code->code[frame->pc - 1]);
-	return NO_RETURN;
+/* emit code saving registers and loading the frame, its local variables and its operand stack */
+static void
+jitprologue(Jit *jit)
+{
+	jitbytes(jit, 8, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56); /* push rbx, rbp, r12, r13, r14 */
+	jitbytes(jit, 3, 0x49, 0x89, 0xFD);                             /* mov r13, rdi */
+	jitmem(jit, 1, 0x8B, R12, R13, offsetof(Frame, local));        /* mov r12, [r13 + local] */
+	jitmem(jit, 1, 0x8B, RAX, R13, offsetof(Frame, nstack));       /* mov rax, [r13 + nstack] */
+	jitmem(jit, 1, 0x8B, RBX, R13, offsetof(Frame, stack));        /* mov rbx, [r13 + stack] */
+	jitbytes(jit, 4, 0x48, 0x8D, 0x1C, 0xC3);                       /* lea rbx, [rbx + rax * 8] */
+}
+
+/* copy compiled code into the code cache; return its address, or NULL if the cache is full */
+static void *
+jitinstall(Jit *jit)
+{
+	void *p;
+	int fd;
+
+	if (jitcache == NULL) {
+		/* POSIX has no anonymous mappings, map private copy of /dev/zero instead */
+		if ((fd = open("/dev/zero", O_RDWR)) == -1)
+			err(EXIT_FAILURE, "/dev/zero");
+		jitcache = mmap(NULL, JITCACHE, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+		if (jitcache == MAP_FAILED)
+			err(EXIT_FAILURE, "mmap");
+		close(fd);
+	}
+	if (jitused + jit->len > JITCACHE)
+		return NULL;
+	if (mprotect(jitcache, JITCACHE, PROT_READ | PROT_WRITE) == -1)
+		err(EXIT_FAILURE, "mprotect");
+	memcpy(jitcache + jitused, jit->buf, jit->len);
+	if (mprotect(jitcache, JITCACHE, PROT_READ | PROT_EXEC) == -1)
+		err(EXIT_FAILURE, "mprotect");
+	p = jitcache + jitused;
+	jitused = (jitused + jit->len + 15) & ~(size_t)15;
+	return p;
 }
 
-/* pop: pop the top operand stack value */
-static int
-oppop(Frame *frame)
-{
-	frame_stackpop(frame);
-	return NO_RETURN;
+/* compile method into the code cache */
+static void
+jitcompile(Code_attribute *code)
+{
+	Jit jit;
+	void *p;
+	size_t i;
+	U4 pc;
+	I4 rel;
+
+	jit.size = 64 + code->ninstr * 96;
+	jit.buf = emalloc(jit.size);
+	jit.mpc = emalloc(code->ninstr * sizeof *jit.mpc);
+	jit.fix = emalloc(code->ninstr * sizeof *jit.fix);
+	jit.exit = NULL;
+	jit.len = jit.nfix = jit.nexit = 0;
+	jit.full = 0;
+	jitprologue(&jit);
+	for (pc = 0; pc < code->ninstr; pc++) {
+		jit.mpc[pc] = jit.len;
+		if (jitinstr(&jit, &code->instr[pc]) == -1 || jit.full)
+			goto done;
+	}
+	for (i = 0; i < jit.nfix; i++) {
+		rel = (I4)(jit.mpc[jit.fix[i].target] - (jit.fix[i].at + 4));
+		memcpy(jit.buf + jit.fix[i].at, &rel, sizeof rel);
+	}
+	if ((p = jitinstall(&jit)) != NULL)
+		code->jitcode = (int (*)(Frame *))p;
+done:
+	free(jit.buf);
+	free(jit.mpc);
+	free(jit.fix);
 }
 
-/* pop: pop the top one or two operand stack values */
-static int
-oppop2(Frame *frame)
+/* emit jump, on condition cc, out of a trace into the interpreter at instruction pc */
+static void
+jitexit(Jit *jit, int cc, U4 pc)
 {
-	frame_stackpop(frame);
-	frame_stackpop(frame);
-	return NO_RETURN;
+	jitbytes(jit, 2, 0x0F, 0x80 | cc);
+	jit->exit[jit->nexit].at = jit->len;
+	jit->exit[jit->nexit++].pc = pc;
+	jitimm32(jit, 0);
 }
 
-/* putstatic: set static field in class */
+/*
+ * Emit the method called by the invoke instruction ins, at index pc of
+ * the method containing the loop of a trace, from the instructions seg
+ * it ran while the trace was recorded.  The locals and the operand
+ * stack of the inlined method are put on the machine stack.  Only a
+ * call that runs straight through, without conditional branches or
+ * instructions that need a frame of their own, is inlined; for any
+ * other, nothing is emitted and -1 is returned.  An inlined
+ * invokevirtual is guarded by the class of the receiver it was recorded
+ * with.
+ */
 static int
-opputstatic(Frame *frame)
+traceinline(Jit *jit, Instr *ins, U4 pc, ClassFile *receiver, Traceentry *seg, size_t nseg)
 {
-	CONSTANT_Fieldref_info *fieldref;
-	CP *cp;
-	Value v;
-	U2 i;
+	Callsite *site;
+	ClassFile *class;
+	Code_attribute *code;
+	Instr *p;
+	size_t i, len, nexit;
+	I4 size;
+	U2 a, k, n, op;
+
+	site = ins->p;
+	code = site->code;
+	if (ins->op == INVOKEVIRTUAL_QUICK)
+		virtualselect(site, receiver, &class, &code);
+	if (code == NULL || nseg == 0 || !isreturn(seg[nseg - 1].ins->op))
+		return -1;
+	for (i = 0; i < nseg; i++) {
+		p = seg[i].ins;
+		if (p < code->instr || p >= code->instr + code->ninstr)
+			return -1;
+		for (k = 0; k < oplength(p->op); k++) {
+			op = opfold(p[k].op);
+			if ((isbranch(op) && op != GOTO) || (isreturn(op) && i + 1 < nseg))
+				return -1;
+			switch (p[k].op) {
+			case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+			case NEW: case NEW_QUICK: case NEWARRAY: case MULTIANEWARRAY:
+			case LDC_STRING: case ACONST_NULL:
+			case INVOKESTATIC: case INVOKESPECIAL: case INVOKEVIRTUAL:
+			case INVOKESTATIC_QUICK: case INVOKEVIRTUAL_QUICK:
+			case INVOKESTATIC_NATIVE: case INVOKEVIRTUAL_NATIVE:
+				return -1;
+			}
+		}
+	}
+	n = site->nret;
+	size = (SLOT(code->max_locals + code->max_stack + 2) + 15) & ~15;
+	len = jit->len;
+	nexit = jit->nexit;
+	if (ins->op == INVOKEVIRTUAL_QUICK) {
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-site->nargs));    /* mov rax, receiver */
+		jitbytes(jit, 5, 0x48, 0x85, 0xC0, 0x74, 0x07);         /* test rax, rax; jz over next */
+		jitmem(jit, 1, 0x8B, RAX, RAX, offsetof(Heap, class)); /* mov rax, [rax + class] */
+		jitbytes(jit, 2, 0x48, 0xB9);                           /* mov rcx, receiver class */
+		jitimm64(jit, (U8)(uintptr_t)receiver);
+		jitbytes(jit, 3, 0x48, 0x39, 0xC8);                     /* cmp rax, rcx */
+		jitexit(jit, CC_NE, pc);
+	}
+	jitbytes(jit, 3, 0x48, 0x81, 0xEC);                             /* sub rsp, size */
+	jitimm32(jit, (U4)size);
+	jitmem(jit, 1, 0x89, R12, RSP, size - SLOT(2));                /* save local variables */
+	for (a = 0; a < site->nargs; a++) {
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(a - site->nargs));
+		jitmem(jit, 1, 0x89, RAX, RSP, SLOT(a));
+	}
+	jitsp(jit, -site->nargs);
+	jitmem(jit, 1, 0x89, RBX, RSP, size - SLOT(1));                /* save operand stack */
+	jitbytes(jit, 3, 0x49, 0x89, 0xE4);                             /* mov r12, rsp */
+	jitmem(jit, 1, 0x8D, RBX, RSP, SLOT(code->max_locals));        /* lea rbx, [rsp + max_locals] */
+	for (i = 0; i + 1 < nseg; i++) {
+		for (k = 0, p = seg[i].ins; k < oplength(p->op); k++) {
+			if (opfold(p[k].op) != GOTO && (jitinstr(jit, &p[k]) == -1 || jit->full)) {
+				jit->len = len;
+				jit->nexit = nexit;
+				return -1;
+			}
+		}
+	}
+	if (n > 0)
+		jitmem(jit, 1, 0x8B, RAX, RBX, SLOT(-n));              /* mov rax, return value */
+	jitmem(jit, 1, 0x8B, RBX, RSP, size - SLOT(1));                /* restore operand stack */
+	jitmem(jit, 1, 0x8B, R12, RSP, size - SLOT(2));                /* restore local variables */
+	jitbytes(jit, 3, 0x48, 0x81, 0xC4);                             /* add rsp, size */
+	jitimm32(jit, (U4)size);
+	if (n > 0) {
+		jitmem(jit, 1, 0x89, RAX, RBX, 0);
+		jitsp(jit, n);
+	}
+	return jit->full ? -1 : 0;
+}
 
-	v = frame_stackpop(frame);
-	i = frame->code->code[frame->pc++] << 8;
-	i |= frame->code->code[frame->pc++];
-	fieldref = &frame->class->constant_pool[i]->info.fieldref_info;
-	cp = resolvefield(frame->class, fieldref, NULL);
-	if (cp != NULL) {
-		switch (cp->tag) {
-		case CONSTANT_Integer:
-			memcpy(&cp->info.integer_info.bytes, &v.i, 4);
-			break;
-		case CONSTANT_Long:
-			memcpy(&cp->info.long_info.high_bytes, (&v.l) + 0, 4);
-			memcpy(&cp->info.long_info.low_bytes, (&v.l) + 4, 4);
-			break;
-		case CONSTANT_Float:
-			memcpy(&cp->info.float_info.bytes, &v.f, 4);
-			break;
-		case CONSTANT_Double:
-			memcpy(&cp->info.double_info.high_bytes, (&v.d) + 0, 4);
-			memcpy(&cp->info.double_info.low_bytes, (&v.d) + 4, 4);
-			break;
+/*
+ * Compile the trace of a loop, recorded while running it on frame,
+ * into the code cache.  The trace runs the path recorded through the
+ * loop over and over; each conditional branch becomes a guard that
+ * leaves the trace, back into the interpreter, when the branch does not
+ * go the way it went while recording.
+ */
+static void
+tracecompile(Trace *trace, Frame *frame, Traceentry *entries, size_t n)
+{
+	Jit jit;
+	Instr *code, *ins;
+	void *p;
+	size_t i, j, top, nins;
+	U4 pc, next, k, len;
+	I4 rel;
+	U2 op;
+	int cc;
+
+	code = frame->code->instr;
+	for (nins = i = 0; i < n; i++)
+		nins += oplength(entries[i].ins->op);
+	jit.size = 64 + nins * 160;
+	jit.buf = emalloc(jit.size);
+	jit.exit = emalloc(nins * sizeof *jit.exit);
+	jit.mpc = NULL;
+	jit.fix = NULL;
+	jit.len = jit.nfix = jit.nexit = 0;
+	jit.full = 0;
+	jitprologue(&jit);
+	top = jit.len;
+	for (i = 0; i < n; i = j) {
+		/* the instructions run by a method called from the loop follow the call */
+		for (j = i + 1; j < n && entries[j].inlined; j++)
+			;
+		ins = entries[i].ins;
+		pc = ins - code;
+		next = (j < n) ? (U4)(entries[j].ins - code) : trace->head;
+		len = oplength(ins->op);
+		for (k = 0; k < len; k++, ins++, pc++) {
+			op = opfold(ins->op);
+			if (op == GOTO)
+				continue;
+			if (isbranch(op) && op != JSR) {
+				cc = jitcompare(&jit, op);
+				if ((U4)ins->i == pc + 1)
+					continue;
+				if ((k + 1 < len ? pc + 1 : next) == (U4)ins->i)
+					jitexit(&jit, cc ^ 1, pc + 1);
+				else
+					jitexit(&jit, cc, ins->i);
+				continue;
+			}
+			if ((ins->op == INVOKESTATIC_QUICK || ins->op == INVOKEVIRTUAL_QUICK) &&
+			    traceinline(&jit, ins, pc, entries[i].receiver, entries + i + 1, j - i - 1) == 0)
+				continue;
+			if (jitinstr(&jit, ins) == -1 || jit.full)
+				goto done;
 		}
 	}
-	return NO_RETURN;
+	rel = (I4)(top - (jit.len + 5));
+	jitbytes(&jit, 1, 0xE9);                                        /* jmp top */
+	jitimm32(&jit, (U4)rel);
+	for (i = 0; i < jit.nexit && !jit.full; i++) {
+		rel = (I4)(jit.len - (jit.exit[i].at + 4));
+		memcpy(jit.buf + jit.exit[i].at, &rel, sizeof rel);
+		jitbytes(&jit, 1, 0x66);                                /* mov word [r13 + pc], pc */
+		jitmem(&jit, 0, 0xC7, 0, R13, offsetof(Frame, pc));
+		jitbytes(&jit, 2, jit.exit[i].pc & 0xFF, jit.exit[i].pc >> 8);
+		jitreturn(&jit, NO_RETURN);
+	}
+	if (!jit.full && (p = jitinstall(&jit)) != NULL)
+		trace->jitcode = (int (*)(Frame *))p;
+done:
+	free(jit.buf);
+	free(jit.exit);
 }
 
-/* ret: return from subroutine */
-static int
-opret(Frame *frame)
-{
-	Value v;
-	U2 i;
+#undef SLOT
+
+#else
 
-	i = frame->code->code[frame->pc++];
-	v = frame_localload(frame, i);
-	frame->pc = v.i;
-	return RETURN_VOID;
+/* no compiler for this machine; every method is interpreted */
+static void
+jitcompile(Code_attribute *code)
+{
+	(void)code;
 }
 
-/* return: return void from method */
-static int
-opreturn(Frame *frame)
+/* no compiler for this machine; every loop is interpreted */
+static void
+tracecompile(Trace *trace, Frame *frame, Traceentry *entries, size_t n)
 {
+	(void)trace;
 	(void)frame;
-	return RETURN_VOID;
+	(void)entries;
+	(void)n;
 }
 
-/* sipush: push short */
-static int
-opsipush(Frame *frame)
-{
-	Value v;
-	U2 u;
+#endif
 
-	u = frame->code->code[frame->pc++] << 8;
-	u |= frame->code->code[frame->pc++];
-	v.i = (int16_t)u;
-	frame_stackpush(frame, v);
-	return NO_RETURN;
+/* count a call of code, compiling it once it gets hot */
+static void
+codecount(Code_attribute *code)
+{
+	if (!interponly && oppairs == NULL && code->verified && code->jitcode == NULL && ++code->ncalls == JITTHRESHOLD)
+		jitcompile(code);
 }
 
-/* access jump table by index and jump */
+/* run code of method, in a new frame, with the arguments taken from the operand stack of frame */
 static int
-optableswitch(Frame *frame)
+coderun(ClassFile *class, Frame *frame, Code_attribute *code, U2 nargs, U2 nret)
 {
-	int32_t def, high, low, j, n;
-	U4 a, b, c, d, baseaddr, targetaddr;
-	Value v;
-
-	baseaddr = frame->pc - 1;
-	while (frame->pc % 4)
-		frame->pc++;
-	v = frame_stackpop(frame);
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	def = (a << 24) | (b << 16) | (c << 8) | d;
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	low = (a << 24) | (b << 16) | (c << 8) | d;
-	a = frame->code->code[frame->pc++];
-	b = frame->code->code[frame->pc++];
-	c = frame->code->code[frame->pc++];
-	d = frame->code->code[frame->pc++];
-	high = (a << 24) | (b << 16) | (c << 8) | d;
-	targetaddr = baseaddr + def;
-	for (j = low; j <= high; j++) {
-		a = frame->code->code[frame->pc++];
-		b = frame->code->code[frame->pc++];
-		c = frame->code->code[frame->pc++];
-		d = frame->code->code[frame->pc++];
-		n = (a << 24) | (b << 16) | (c << 8) | d;
-		if (v.i == j) {
-			targetaddr = baseaddr + n;
-			break;
-		}
+	Frame *newframe;
+	int ret;
+
+	/* the arguments on the operand stack become the first local variables of the new frame */
+	if (frame)
+		frame->nstack -= nargs;
+	newframe = frame_push(code, class, frame ? frame->stack + frame->nstack : NULL, nargs,
+	                      code->max_locals, code->max_stack);
+	if (newframe == NULL)
+		errx(EXIT_FAILURE, "stack overflow");
+	if (code->jitcode != NULL)
+		ret = code->jitcode(newframe);
+	else if (code->rinstr != NULL)
+		ret = rinterpret(newframe);
+	else
+		ret = interpret(newframe);
+	if (ret == RETURN_OPERAND && frame) {
+		newframe->nstack -= nret;
+		memmove(frame->stack + frame->nstack, newframe->stack + newframe->nstack, nret * sizeof *frame->stack);
+		frame->nstack += nret;
 	}
-	frame->pc = targetaddr;
-	return NO_RETURN;
+	frame_pop();
+	return 0;
+}
+
+/* count and run code of method with the arguments taken from the operand stack of frame */
+static int
+codecall(ClassFile *class, Frame *frame, Code_attribute *code, U2 nargs, U2 nret)
+{
+	codecount(code);
+	return coderun(class, frame, code, nargs, nret);
 }
 
 /* call method */
 int
 methodcall(ClassFile *class, Frame *frame, char *name, char *descriptor, U2 flags)
 {
-	static int(*instrtab[])(Frame *) = {
-		/*
-		 * some functions are used in more than one instructions,
-		 * for example, there is no opareturn, opdreturn or oplreturn,
-		 * there is only opireturn, that implements all function that
-		 * return something.
-		 */
-		[NOP]             = opnop,
-		[ACONST_NULL]     = opaconst_null,
-		[ICONST_M1]       = opiconst_m1,
-		[ICONST_0]        = opiconst_0,
-		[ICONST_1]        = opiconst_1,
-		[ICONST_2]        = opiconst_2,
-		[ICONST_3]        = opiconst_3,
-		[ICONST_4]        = opiconst_4,
-		[ICONST_5]        = opiconst_5,
-		[LCONST_0]        = oplconst_0,
-		[LCONST_1]        = oplconst_1,
-		[FCONST_0]        = opfconst_0,
-		[FCONST_1]        = opfconst_1,
-		[FCONST_2]        = opfconst_2,
-		[DCONST_0]        = opdconst_0,
-		[DCONST_1]        = opdconst_1,
-		[BIPUSH]          = opbipush,
-		[SIPUSH]          = opsipush,
-		[LDC]             = opldc,
-		[LDC_W]           = opldc_w,
-		[LDC2_W]          = opldc2_w,
-		[ILOAD]           = opiload,
-		[LLOAD]           = oplload,
-		[FLOAD]           = opiload,
-		[DLOAD]           = oplload,
-		[ALOAD]           = opiload,
-		[ILOAD_0]         = opiload_0,
-		[ILOAD_1]         = opiload_1,
-		[ILOAD_2]         = opiload_2,
-		[ILOAD_3]         = opiload_3,
-		[LLOAD_0]         = oplload_0,
-		[LLOAD_1]         = oplload_1,
-		[LLOAD_2]         = oplload_2,
-		[LLOAD_3]         = oplload_3,
-		[FLOAD_0]         = opiload_0,
-		[FLOAD_1]         = opiload_1,
-		[FLOAD_2]         = opiload_2,
-		[FLOAD_3]         = opiload_3,
-		[DLOAD_0]         = oplload_0,
-		[DLOAD_1]         = oplload_1,
-		[DLOAD_2]         = oplload_2,
-		[DLOAD_3]         = oplload_3,
-		[ALOAD_0]         = opiload_0,
-		[ALOAD_1]         = opiload_1,
-		[ALOAD_2]         = opiload_2,
-		[ALOAD_3]         = opiload_3,
-		[IALOAD]          = opiaload,
-		[LALOAD]          = oplaload,
-		[FALOAD]          = opfaload,
-		[DALOAD]          = opdaload,
-		[AALOAD]          = opaaload,
-		[BALOAD]          = opiaload,
-		[CALOAD]          = opiaload,
-		[SALOAD]          = opiaload,
-		[ISTORE]          = opistore,
-		[LSTORE]          = oplstore,
-		[FSTORE]          = opistore,
-		[DSTORE]          = oplstore,
-		[ASTORE]          = opistore,
-		[ISTORE_0]        = opistore_0,
-		[ISTORE_1]        = opistore_1,
-		[ISTORE_2]        = opistore_2,
-		[ISTORE_3]        = opistore_3,
-		[LSTORE_0]        = oplstore_0,
-		[LSTORE_1]        = oplstore_1,
-		[LSTORE_2]        = oplstore_2,
-		[LSTORE_3]        = oplstore_3,
-		[FSTORE_0]        = opistore_0,
-		[FSTORE_1]        = opistore_1,
-		[FSTORE_2]        = opistore_2,
-		[FSTORE_3]        = opistore_3,
-		[DSTORE_0]        = oplstore_0,
-		[DSTORE_1]        = oplstore_1,
-		[DSTORE_2]        = oplstore_2,
-		[DSTORE_3]        = oplstore_3,
-		[ASTORE_0]        = opistore_0,
-		[ASTORE_1]        = opistore_1,
-		[ASTORE_2]        = opistore_2,
-		[ASTORE_3]        = opistore_3,
-		[IASTORE]         = opiastore,
-		[LASTORE]         = oplastore,
-		[FASTORE]         = opfastore,
-		[DASTORE]         = opdastore,
-		[AASTORE]         = opaastore,
-		[BASTORE]         = opiastore,
-		[CASTORE]         = opiastore,
-		[SASTORE]         = opiastore,
-		[POP]             = oppop,
-		[POP2]            = oppop2,
-		[DUP]             = opdup,
-		[DUP_X1]          = opdup_x1,
-		[DUP_X2]          = opdup_x2,
-		[DUP2]            = opdup2,
-		[DUP2_X1]         = opdup2_x1,
-		[DUP2_X2]         = opdup2_x2,
-		[SWAP]            = opswap,
-		[IADD]            = opiadd,
-		[LADD]            = opladd,
-		[FADD]            = opfadd,
-		[DADD]            = opdadd,
-		[ISUB]            = opisub,
-		[LSUB]            = oplsub,
-		[FSUB]            = opfsub,
-		[DSUB]            = opdsub,
-		[IMUL]            = opimul,
-		[LMUL]            = oplmul,
-		[FMUL]            = opfmul,
-		[DMUL]            = opdmul,
-		[IDIV]            = opidiv,
-		[LDIV]            = opldiv,
-		[FDIV]            = opfdiv,
-		[DDIV]            = opddiv,
-		[IREM]            = opirem,
-		[LREM]            = oplrem,
-		[FREM]            = opfrem,
-		[DREM]            = opdrem,
-		[INEG]            = opineg,
-		[LNEG]            = oplneg,
-		[FNEG]            = opfneg,
-		[DNEG]            = opdneg,
-		[ISHL]            = opishl,
-		[LSHL]            = oplshl,
-		[ISHR]            = opishr,
-		[LSHR]            = oplshr,
-		[IUSHR]           = opiushr,
-		[LUSHR]           = oplushr,
-		[IAND]            = opiand,
-		[LAND]            = opland,
-		[IOR]             = opior,
-		[LOR]             = oplor,
-		[IXOR]            = opixor,
-		[LXOR]            = oplxor,
-		[IINC]            = opiinc,
-		[I2L]             = opi2l,
-		[I2F]             = opi2f,
-		[I2D]             = opi2d,
-		[L2I]             = opl2i,
-		[L2F]             = opl2f,
-		[L2D]             = opl2d,
-		[F2I]             = opf2i,
-		[F2L]             = opf2l,
-		[F2D]             = opf2d,
-		[D2I]             = opd2i,
-		[D2L]             = opd2l,
-		[D2F]             = opd2f,
-		[I2B]             = opi2b,
-		[I2C]             = opi2c,
-		[I2S]             = opi2s,
-		[LCMP]            = oplcmp,
-		[FCMPL]           = opfcmpl,
-		[FCMPG]           = opfcmpg,
-		[DCMPL]           = opdcmpl,
-		[DCMPG]           = opdcmpg,
-		[IFEQ]            = opifeq,
-		[IFNE]            = opifne,
-		[IFLT]            = opiflt,
-		[IFGE]            = opifge,
-		[IFGT]            = opifgt,
-		[IFLE]            = opifle,
-		[IF_ICMPEQ]       = opif_icmpeq,
-		[IF_ICMPNE]       = opif_icmpne,
-		[IF_ICMPLT]       = opif_icmplt,
-		[IF_ICMPGE]       = opif_icmpge,
-		[IF_ICMPGT]       = opif_icmpgt,
-		[IF_ICMPLE]       = opif_icmple,
-		[IF_ACMPEQ]       = opif_acmpeq,
-		[IF_ACMPNE]       = opif_acmpne,
-		[GOTO]            = opgoto,
-		[JSR]             = opjsr,
-		[RET]             = opret,
-		[TABLESWITCH]     = optableswitch,
-		[LOOKUPSWITCH]    = oplookupswitch,
-		[IRETURN]         = opireturn,
-		[LRETURN]         = opireturn,
-		[FRETURN]         = opireturn,
-		[DRETURN]         = opireturn,
-		[ARETURN]         = opireturn,
-		[RETURN]          = opreturn,
-		[GETSTATIC]       = opgetstatic,
-		[PUTSTATIC]       = opputstatic,
-		[GETFIELD]        = opnop,
-		[PUTFIELD]        = opnop,
-		[INVOKEVIRTUAL]   = opinvokevirtual,
-		[INVOKESPECIAL]   = opnop,
-		[INVOKESTATIC]    = opinvokestatic,
-		[INVOKEINTERFACE] = opnop,
-		[INVOKEDYNAMIC]   = opnop,
-		[NEW]             = opnop,
-		[NEWARRAY]        = opnewarray,
-		[ANEWARRAY]       = opnop,
-		[ARRAYLENGTH]     = oparraylength,
-		[ATHROW]          = opnop,
-		[CHECKCAST]       = opnop,
-		[INSTANCEOF]      = opnop,
-		[MONITORENTER]    = opnop,
-		[MONITOREXIT]     = opnop,
-		[WIDE]            = opnop,
-		[MULTIANEWARRAY]  = opmultianewarray,
-		[IFNULL]          = opifnull,
-		[IFNONNULL]       = opifnonnull,
-		[GOTO_W]          = opgoto_w,
-		[JSR_W]           = opjsr_w,
-	};
-	Attribute *cattr;       /* Code_attribute */
-	Code_attribute *code;
-	Frame *newframe;
 	Method *method;
-	Value v;
-	char *s;
-	U2 i;
-	int ret = NO_RETURN;
 
 	if ((method = class_getmethod(class, name, descriptor)) == NULL)
 		return -1;
 	if ((flags != ACC_NONE) && !(method->access_flags & flags))
 		return -1;
-	if ((cattr = class_getattr(method->attributes, method->attributes_count, Code)) == NULL)
+	if (method->code == NULL)
 		err(EXIT_FAILURE, "could not find code for method %s", name);
-	code = &cattr->info.code;
-	if ((newframe = frame_push(code, class, code->max_locals, code->max_stack)) == NULL)
-		err(EXIT_FAILURE, "out of memory");
-	if (frame) {
-		s = descriptor;
-		i = 0;
-		while (*s && *s != ')') {
-			v = frame_stackpop(frame);
-			frame_localstore(newframe, i++, v);
-			switch (*(++s)) {
-			case TYPE_REFERENCE:
-				while (*s && *s != TYPE_TERMINAL) {
-					s++;
-				}
-				if (*s == TYPE_TERMINAL) {
-					s++;
-				}
-				break;
-			case TYPE_ARRAY:
-				while (*s == TYPE_ARRAY) {
-					s++;
-				}
-				if (*s == TYPE_REFERENCE) {
-					while (*s && *s != TYPE_TERMINAL) {
-						s++;
-					}
-					if (*s == TYPE_TERMINAL) {
-						s++;
-					}
-				} else {
-					s++;
-				}
-				break;
-			case TYPE_DOUBLE:
-			case TYPE_LONG:
-				frame_localstore(newframe, i++, v);
-				/* FALLTHROUGH */
-			default:
-				s++;
+	return codecall(class, frame, method->code, method->sig.nslots, method->sig.nret);
+}
+
+/* report hit and miss counts of the inline cache of each invokevirtual call site */
+static void
+icreport(void)
+{
+	Attribute *cattr;
+	Method *method;
+	Callsite *site;
+	char *state, *name;
+	U2 i;
+
+	(void)fflush(stdout);
+	for (site = callsites; site != NULL; site = site->next) {
+		if (site->caller == NULL)
+			continue;
+		name = "?";
+		for (i = 0; i < site->caller->methods_count; i++) {
+			method = site->caller->methods[i];
+			cattr = class_getattr(method->attributes, method->attributes_count, Code);
+			if (cattr != NULL && &cattr->info.code == site->callercode) {
+				name = class_getutf8(site->caller, method->name_index);
 				break;
 			}
 		}
+		if (site->ncache > NCACHE)
+			state = "megamorphic";
+		else if (site->ncache > 1)
+			state = "polymorphic";
+		else
+			state = "monomorphic";
+		fprintf(stderr, "%s.%s:%lu: %s%s: %lu hits, %lu misses, %s\n",
+		        class_getclassname(site->caller, site->caller->this_class),
+		        name, (unsigned long)site->callerpc,
+		        site->name, site->descriptor,
+		        site->hits, site->misses, state);
 	}
-	while (newframe->pc < code->code_length) {
-		if ((ret = (*instrtab[code->code[newframe->pc++]])(newframe)) != NO_RETURN) {
-			break;
-		}
-	}
-	if (ret == RETURN_OPERAND) {
-		v = frame_stackpop(newframe);
-		frame_stackpush(frame, v);
+}
+
+/* compare counts of instruction pairs, for sorting them in decreasing order */
+static int
+paircmp(const void *a, const void *b)
+{
+	unsigned long x, y;
+
+	x = *(*(unsigned long **)a);
+	y = *(*(unsigned long **)b);
+	return (x < y) - (x > y);
+}
+
+/* report the executed instruction pairs, most frequent first */
+static void
+pairreport(void)
+{
+	unsigned long **pairs;
+	size_t i, j, n;
+
+	(void)fflush(stdout);
+	pairs = ecalloc(CODE_LAST * CODE_LAST, sizeof *pairs);
+	n = 0;
+	for (i = 0; i < CODE_LAST; i++)
+		for (j = 0; j < CODE_LAST; j++)
+			if (oppairs[i][j] > 0)
+				pairs[n++] = &oppairs[i][j];
+	qsort(pairs, n, sizeof *pairs, paircmp);
+	for (i = 0; i < n; i++) {
+		j = pairs[i] - oppairs[0];
+		fprintf(stderr, "%12lu %s %s\n", *pairs[i],
+		        class_getmnemonic(j / CODE_LAST),
+		        class_getmnemonic(j % CODE_LAST));
 	}
-	frame_pop();
-	return 0;
+	free(pairs);
 }
 
 /* load and initialize main class, then call main method */
@@ -2796,22 +5886,37 @@ java(int argc, char *argv[])
 	Frame *frame;
 	Heap *h;
 	Value v;
+	size_t n;
 	int i;
 
+	if (frame_init(stacksize) == -1)
+		err(EXIT_FAILURE, "could not allocate stack");
+	if (heap_init(heapsize, nurserysize, gcmode, gcthreads, compressedrefs, gcroots) == -1)
+		err(EXIT_FAILURE, "could not allocate heap");
 	class = classload(argv[0]);
 	argc--;
 	argv++;
-	frame = frame_push(NULL, NULL, 0, 1);
-	v.v = array_new(&argc, 1, sizeof (void *));
+	if ((frame = frame_push(NULL, NULL, NULL, 0, 0, 1)) == NULL)
+		errx(EXIT_FAILURE, "stack overflow");
+	if ((v.v = array_new(&argc, 1, HEAP_REFSIZE, 1)) == NULL)
+		errx(EXIT_FAILURE, "out of memory");
+	frame_stackpush(frame, v);
 	for (i = 0; i < argc; i++) {
-		h = array_new((int32_t[]){0}, 1, 0);
-		h->obj = argv[i];
-		((void **)v.v->obj)[i] = h;
+		n = strlen(argv[i]) + 1;
+		if ((h = heap_alloc(n, 1)) == NULL)
+			errx(EXIT_FAILURE, "out of memory");
+		memcpy(HEAP_DATA(h), argv[i], n);
+		HEAP_BARRIER(v.v, i, h);
+		heap_store(v.v, i, h);
 	}
-	frame_stackpush(frame, v);
 	if (methodcall(class, frame, "main", "([Ljava/lang/String;)V", (ACC_PUBLIC | ACC_STATIC)) == -1)
 		errx(EXIT_FAILURE, "could not find main method");
-	// TODO: free heap
+	if (icstats)
+		icreport();
+	if (oppairs != NULL)
+		pairreport();
+	frame_del();
+	heap_del();
 }
 
 /* java: launches a java application */
@@ -2819,6 +5924,8 @@ int
 main(int argc, char *argv[])
 {
 	char *cpath = NULL;
+	char *ep;
+	long n;
 	int i;
 
 	setprogname(argv[0]);
@@ -2828,6 +5935,36 @@ main(int argc, char *argv[])
 			if (++i >= argc)
 				usage();
 			cpath = argv[i];
+		} else if (strcmp(argv[i], "-Xcompressedrefs") == 0) {
+			compressedrefs = 1;
+		} else if (strcmp(argv[i], "-Xconcurrentgc") == 0) {
+			gcmode = GC_CONCURRENT;
+		} else if (strncmp(argv[i], "-Xgcthreads", 11) == 0) {
+			n = strtol(argv[i] + 11, &ep, 10);
+			if (n < 1 || n > GCTHREADSMAX || *ep != '\0')
+				usage();
+			gcthreads = n;
+		} else if (strcmp(argv[i], "-Xint") == 0) {
+			interponly = 1;
+		} else if (strcmp(argv[i], "-Xicstats") == 0) {
+			icstats = 1;
+		} else if (strcmp(argv[i], "-Xoppairs") == 0) {
+			oppairs = ecalloc(CODE_LAST, sizeof *oppairs);
+		} else if (strncmp(argv[i], "-Xmn", 4) == 0) {
+			if ((nurserysize = getsize(argv[i] + 4)) == 0)
+				usage();
+		} else if (strncmp(argv[i], "-Xmx", 4) == 0) {
+			if ((heapsize = getsize(argv[i] + 4)) == 0)
+				usage();
+		} else if (strcmp(argv[i], "-Xparallelgc") == 0) {
+			gcmode = GC_PARALLEL;
+		} else if (strcmp(argv[i], "-Xreg") == 0) {
+			regtier = 1;
+		} else if (strncmp(argv[i], "-Xss", 4) == 0) {
+			if ((stacksize = getsize(argv[i] + 4)) == 0)
+				usage();
+		} else if (strcmp(argv[i], "-Xtos") == 0) {
+			tos = 1;
 		} else {
 			usage();
 		}
@@ -1,65 +1,112 @@
+#ifdef __linux__
+#define _GNU_SOURCE             /* for sched_getaffinity() */
+#endif
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "class.h"
 #include "memory.h"
 #include "util.h"
 
+/* size of frame header, rounded to a whole number of values */
+#define FRAMESIZE       ((sizeof (Frame) + sizeof (Value) - 1) / sizeof (Value) * sizeof (Value))
+
 static Frame *framestack = NULL;
-static Heap *heap = NULL;
 
-/* allocate frame; push it onto framestack; and return it */
+/*
+ * Frames are allocated by bumping pointers into a single region,
+ * the stack of the (only) virtual machine thread.  The local
+ * variables of a frame, followed by its operand stack, grow up from
+ * the bottom of the region; frame headers grow down from its top.
+ * The local variables of a called method begin at the arguments on
+ * the operand stack of the calling frame, so the arguments become
+ * the first local variables without being copied.
+ */
+static Value *vmstack = NULL;           /* base of the frame stack region */
+static Value *vmstacktop = NULL;        /* first free slot in the region */
+static Value *vmstackend = NULL;        /* end of the region */
+
+/* allocate the frame stack region of size bytes; return -1 on error */
+int
+frame_init(size_t size)
+{
+	free(vmstack);
+	if (size < FRAMESIZE)
+		size = FRAMESIZE;
+	size /= sizeof *vmstack;
+	if ((vmstack = malloc(size * sizeof *vmstack)) == NULL)
+		return -1;
+	vmstacktop = vmstack;
+	vmstackend = vmstack + size;
+	framestack = NULL;
+	return 0;
+}
+
+/*
+ * allocate frame on the frame stack; push it onto framestack; and return it, or NULL on overflow;
+ * if args is not NULL, it points to the nargs arguments on top of the operand stack of the topmost frame,
+ * which become the first local variables of the new frame
+ */
 Frame *
-frame_push(Code_attribute *code, ClassFile *class, U2 max_locals, U2 max_stack)
-{
-	Frame *frame = NULL;
-	Value *local = NULL;
-	Value *stack = NULL;
-
-	frame = malloc(sizeof *frame);
-	local = calloc(max_locals, sizeof *local);
-	stack = calloc(max_stack, sizeof *stack);
-	if (frame == NULL || (max_locals && local == NULL) || (max_stack && stack == NULL)) {
-		free(frame);
-		free(local);
-		free(stack);
+frame_push(Code_attribute *code, ClassFile *class, Value *args, U2 nargs, U2 max_locals, U2 max_stack)
+{
+	Frame *frame;
+	Value *local, *limit;
+
+	if (vmstacktop == NULL)
 		return NULL;
+	limit = (framestack != NULL ? (Value *)framestack : vmstackend) - FRAMESIZE / sizeof *limit;
+	if (args == NULL) {
+		local = vmstacktop;
+		nargs = 0;
+	} else {
+		local = args;
 	}
+	if (max_locals < nargs)
+		max_locals = nargs;
+	if (limit < local || (size_t)(limit - local) < (size_t)max_locals + max_stack)
+		return NULL;
+	frame = (Frame *)limit;
+	frame->base = vmstacktop;
+	frame->stack = local + max_locals;
+	vmstacktop = frame->stack + max_stack;
+	memset(local + nargs, 0, (max_locals - nargs) * sizeof *local);
 	frame->pc = 0;
 	frame->code = code;
 	frame->class = class;
 	frame->local = local;
-	frame->stack = stack;
 	frame->max_locals = max_locals;
-	frame->max_stack = max_stack ;
+	frame->max_stack = max_stack;
 	frame->nstack = 0;
 	frame->next = framestack;
 	framestack = frame;
 	return frame;
 }
 
-/* pop and free frame from framestack; return -1 on error */
+/* pop frame from framestack, releasing its space on the frame stack; return -1 on error */
 int
 frame_pop(void)
 {
-	Frame *frame;
-
 	if (framestack == NULL)
 		return -1;
-	frame = framestack;
-	framestack = frame->next;
-	free(frame->local);
-	free(frame->stack);
-	free(frame);
+	vmstacktop = framestack->base;
+	framestack = framestack->next;
 	return 0;
 }
 
-/* pop and free all frames from framestack */
+/* pop all frames from framestack and free the frame stack region */
 void
 frame_del(void)
 {
-	while (framestack) {
-		frame_pop();
-	}
+	framestack = NULL;
+	free(vmstack);
+	vmstack = vmstacktop = vmstackend = NULL;
 }
 
 /* push value onto frame's operand stack */
@@ -70,13 +117,12 @@ frame_stackpush(Frame *frame, Value value)
 	frame->stack[frame->nstack++] = value;
 }
 
-/* push value onto frame's operand stack */
+/* pop value from frame's operand stack; natives called from unverified code rely on its check */
 Value
 frame_stackpop(Frame *frame)
 {
-	// TODO: handle error when --frame->nstack == 0
 	if (frame->nstack == 0)
-		errx(EXIT_FAILURE, "ASDA");
+		errx(EXIT_FAILURE, "operand stack underflow");
 	return frame->stack[--frame->nstack];
 }
 
@@ -94,82 +140,1107 @@ frame_localload(Frame *frame, U2 i)
 	return frame->local[i];
 }
 
-/* allocate entry in heap */
-Heap *
-heap_alloc(int32_t nmemb, size_t size)
+/*
+ * Objects are garbage collected in two generations.  Each object is a
+ * single block: a small header, followed by the elements of the object
+ * if it is an array.  New objects are allocated in the young
+ * generation, the nursery: a region in which objects are allocated by
+ * bumping a pointer, and a bitmap of the addresses at which they begin.
+ * When the nursery is full, the virtual machine collects it at its next
+ * safe point: the young objects reachable from the frame stack, from
+ * the roots given by the virtual machine, and from the old objects
+ * recorded by the write barrier are promoted by copying them into the
+ * old generation, and the references to them are updated; the other
+ * young objects are dropped, as the nursery is emptied.  A young object
+ * that looks referenced from a frame scanned conservatively cannot be
+ * moved, and is promoted where it is instead: it is pinned, and the
+ * nursery is allocated around it until it is freed.  Large arrays are
+ * allocated in the old generation directly.
+ *
+ * Old objects are allocated apart, and listed in an array which is
+ * sorted by address when the whole heap is collected, so that the
+ * values of the frames scanned conservatively can be looked up in it.
+ * When the old generation grows past a threshold, a young collection is
+ * followed by a mark-sweep collection of the whole heap.  The threshold
+ * is then set to twice the size of the surviving objects, but never
+ * above the maximum heap size less the size of the young generation.
+ *
+ * The write barrier records each old array in which a reference to a
+ * young object is stored: the array's header is marked dirty (the
+ * header is the array's card) and the array is remembered until the
+ * next young collection.
+ *
+ * In the parallel and concurrent modes, the old generation is marked by
+ * a pool of marker threads.  Each marker has its own mark stack; a
+ * marker out of work steals half the stack of another, and marking ends
+ * when all markers are out of work at once.  The mark of an object is a
+ * byte of its own, set without synchronization: two markers may both
+ * claim an object and scan it twice, which is harmless.  In the parallel
+ * mode, the virtual machine waits for the markers.  In the concurrent
+ * mode, it runs while they mark from a snapshot of the heap taken when
+ * the roots were scanned: objects allocated in the old generation
+ * meanwhile are marked at once, and the write barrier logs each
+ * reference overwritten in an array, so that the object it referred to
+ * is marked at the remark, which stops the virtual machine to mark from
+ * the log and to sweep.  The markers are paused while the young
+ * generation is collected.
+ *
+ * In the compressed mode, the references stored in arrays are 32-bit
+ * offsets from the base of a region reserved for the whole heap,
+ * shifted by the alignment of objects if the region is larger than 4
+ * gigabytes.  The nursery is at the bottom of the region, past the
+ * offset 0, which stands for null; old objects are allocated above it
+ * by bumping a pointer, or from lists of the blocks freed by the
+ * collector: one list for each small size, and one for larger blocks,
+ * which are split to fit.  The free blocks are merged with their
+ * neighbours after each sweep.
+ */
+#define HEAPALIGN       sizeof (Value)          /* alignment of objects in the nursery */
+#define HEAPMIN         ((size_t)4 << 20)       /* size of the old generation at the first collection */
+#define REGIONMAX       ((size_t)32 << 30)      /* maximum size of the region of a heap with compressed references */
+#define NFREE           64                      /* number of lists of small free blocks, one per size */
+#define REGIONSTEP      ((size_t)1 << 20)       /* size by which the usable part of the region grows */
+
+/* block of the region freed by the collector */
+typedef struct Free {
+	struct Free    *next;
+	size_t          size;
+} Free;
+
+static Heap **objects = NULL;           /* objects of the old generation allocated apart */
+static size_t nobjects = 0;
+static size_t objectmax = 0;
+static char *nursery = NULL;            /* region of the young generation */
+static char *nurserytop = NULL;         /* next address of the nursery to be allocated */
+static char *nurseryend = NULL;         /* end of the nursery */
+static U1 *nurserymap = NULL;           /* bit of each aligned address of the nursery, set where an object begins */
+static char *regiontop = NULL;          /* next address of the region to be allocated */
+static char *regionuse = NULL;          /* end of the usable part of the region */
+static char *regionend = NULL;          /* end of the region */
+static Free *freesmall[NFREE];          /* free blocks of the region of each small size, in units of HEAPALIGN */
+static Free *freelarge = NULL;          /* larger free blocks of the region */
+static Heap **pinned = NULL;            /* old objects promoted in place in the nursery, sorted by address */
+static size_t npinned = 0;
+static size_t pinnedmax = 0;
+static size_t pinnext = 0;              /* first pinned object above nurserytop */
+static Heap **markstack = NULL;         /* marked objects whose elements are yet to be scanned */
+static size_t nmark = 0;
+static size_t markmax = 0;
+static Heap **remembered = NULL;        /* old arrays holding references to young objects */
+static size_t nremembered = 0;
+static size_t remembermax = 0;
+static size_t heapused = 0;             /* size of allocated objects */
+static size_t youngused = 0;            /* size of young objects */
+static size_t youngmax = 0;             /* maximum size of young objects */
+static size_t heapnext = HEAPMIN;       /* size of the old generation at the next full collection */
+static size_t heapmax = SIZE_MAX;       /* maximum size of the heap */
+static int minor = 0;                   /* whether the young generation is being collected */
+static int gcmode = GC_SERIAL;          /* how the old generation is marked */
+
+/* marker thread */
+typedef struct Marker {
+	pthread_t       thread;
+	pthread_mutex_t lock;           /* protects the stack, which other markers steal from */
+	Heap          **stack;          /* marked objects whose elements are yet to be scanned */
+	size_t          n;
+	size_t          max;
+} Marker;
+
+static Marker *markers = NULL;
+static int nmarkers = 0;
+static pthread_mutex_t gclock = PTHREAD_MUTEX_INITIALIZER;      /* protects the state of the markers */
+static pthread_cond_t gccond = PTHREAD_COND_INITIALIZER;        /* signaled when the state of the markers changes */
+static int marking = 0;                 /* whether the markers should mark */
+static int markexit = 0;                /* whether the markers should exit */
+static volatile int markpause = 0;      /* whether the markers should stop for the virtual machine */
+static volatile int markdone = 0;       /* whether the markers ran out of work */
+static int nrunning = 0;                /* markers marking */
+static int nidle = 0;                   /* markers marking, but waiting for work */
+
+static void *markermain(void *arg);
+static void markersdel(void);
+static Heap **satb = NULL;              /* objects whose references were overwritten while marking concurrently */
+static size_t nsatb = 0;
+static size_t satbmax = 0;
+int heapmarking = 0;                    /* whether the markers run concurrently with the virtual machine */
+char *heapbase = NULL;                  /* base of the region of compressed references, or NULL */
+int heapshift = 0;                      /* shift of compressed references */
+static void (*heaproots)(void) = NULL;  /* function passing the roots outside the frame stack to heap_root() */
+
+/* get size of entry, counting its header and data, rounded to the alignment of objects */
+static size_t
+heapsize(Heap *entry)
+{
+	return (HEAP_HEADER + (size_t)entry->nmemb * entry->size + HEAPALIGN - 1) / HEAPALIGN * HEAPALIGN;
+}
+
+/* get number of references held by entry, in the elements of an array or the fields of an instance */
+static int32_t
+heaprefs(Heap *entry)
+{
+	if (!(entry->flags & HEAP_REFS))
+		return 0;
+	return (entry->class != NULL) ? (int32_t)entry->class->nrefs : entry->nmemb;
+}
+
+/* get offset in the data of entry of the i-th reference it holds */
+static size_t
+heapref(Heap *entry, int32_t i)
+{
+	return (entry->class != NULL) ? entry->class->refs[i] : (size_t)i * HEAP_REFSIZE;
+}
+
+/* push entry onto the stack of *p, of *n entries and room for *max; exit on error */
+static void
+heappush(Heap ***p, size_t *n, size_t *max, Heap *entry)
+{
+	Heap **s;
+	size_t m;
+
+	if (*n == *max) {
+		m = *max == 0 ? 256 : *max * 2;
+		if ((s = realloc(*p, m * sizeof *s)) == NULL)
+			err(EXIT_FAILURE, "realloc");
+		*p = s;
+		*max = m;
+	}
+	(*p)[(*n)++] = entry;
+}
+
+/* compare the addresses of two objects, for qsort(3) and bsearch(3) */
+static int
+heapcmp(const void *a, const void *b)
+{
+	uintptr_t x, y;
+
+	x = (uintptr_t)*(Heap *const *)a;
+	y = (uintptr_t)*(Heap *const *)b;
+	return (x > y) - (x < y);
+}
+
+/* set the bit of the nursery map where young entry begins, or clear it if set is zero */
+static void
+nurserybit(Heap *entry, int set)
+{
+	size_t i;
+
+	i = ((char *)entry - nursery) / HEAPALIGN;
+	if (set)
+		nurserymap[i / 8] |= 1 << i % 8;
+	else
+		nurserymap[i / 8] &= ~(1 << i % 8);
+}
+
+/* allocate zeroed young object of n bytes, around the pinned objects; or return NULL */
+static Heap *
+nurseryalloc(size_t n)
 {
-	Heap *entry = NULL;
-	void *obj = NULL;
+	Heap *entry;
+	char *end;
 
-	entry = malloc(sizeof *entry);
-	if (nmemb) {
-		obj = calloc(nmemb, size);
+	for (;;) {
+		end = pinnext < npinned ? (char *)pinned[pinnext] : nurseryend;
+		if ((size_t)(end - nurserytop) >= n)
+			break;
+		if (pinnext == npinned)
+			return NULL;
+		nurserytop = (char *)pinned[pinnext] + heapsize(pinned[pinnext]);
+		pinnext++;
 	}
-	if (entry == NULL || (nmemb && obj == NULL)) {
+	entry = (Heap *)nurserytop;
+	nurserytop += n;
+	memset(entry, 0, n);
+	nurserybit(entry, 1);
+	return entry;
+}
+
+/* get object in the nursery at address p, or NULL if p is not the address of an object in the nursery */
+static Heap *
+nurseryobject(void *p)
+{
+	size_t i;
+
+	if ((char *)p < nursery || (char *)p >= nurseryend || ((char *)p - nursery) % HEAPALIGN != 0)
+		return NULL;
+	i = ((char *)p - nursery) / HEAPALIGN;
+	return (nurserymap[i / 8] & (1 << i % 8)) ? p : NULL;
+}
+
+/* get object at address p, or NULL if p is not the address of an object; the old objects must be sorted */
+static Heap *
+heapobject(void *p)
+{
+	Heap **found;
+
+	if ((char *)p >= nursery && (char *)p < nurseryend)
+		return nurseryobject(p);
+	if (nobjects == 0)
+		return NULL;
+	found = bsearch(&p, objects, nobjects, sizeof *objects, heapcmp);
+	return (found != NULL) ? *found : NULL;
+}
+
+/* get the end of the usable part of the region needed for it to reach p */
+static char *
+regionstep(char *p)
+{
+	size_t n;
+
+	n = ((size_t)(p - heapbase) + REGIONSTEP - 1) / REGIONSTEP * REGIONSTEP;
+	return (n < (size_t)(regionend - heapbase)) ? heapbase + n : regionend;
+}
+
+/* free old object entry of n bytes */
+static void
+oldfree(Heap *entry, size_t n)
+{
+	Free *block;
+
+	if (heapbase == NULL) {
 		free(entry);
-		free(obj);
+		return;
+	}
+	block = (Free *)entry;
+	block->size = n;
+	if (n / HEAPALIGN < NFREE) {
+		block->next = freesmall[n / HEAPALIGN];
+		freesmall[n / HEAPALIGN] = block;
+	} else {
+		block->next = freelarge;
+		freelarge = block;
+	}
+}
+
+/* allocate zeroed old object of n bytes, in the region if references are compressed; or return NULL */
+static Heap *
+oldalloc(size_t n)
+{
+	Free *block, **p;
+	size_t k;
+	char *q;
+
+	if (heapbase == NULL)
+		return calloc(1, n);
+	block = NULL;
+	k = n / HEAPALIGN;
+	if (k < NFREE && freesmall[k] != NULL) {
+		block = freesmall[k];
+		freesmall[k] = block->next;
+	}
+	/* or split a larger block, whose rest must fit a free block */
+	for (k += sizeof (Free) / HEAPALIGN; block == NULL && k < NFREE; k++) {
+		if ((block = freesmall[k]) != NULL) {
+			freesmall[k] = block->next;
+		}
+	}
+	for (p = &freelarge; block == NULL && *p != NULL; p = &(*p)->next) {
+		if ((*p)->size == n || (*p)->size >= n + sizeof (Free)) {
+			block = *p;
+			*p = block->next;
+			break;
+		}
+	}
+	if (block != NULL) {
+		if (block->size > n) {
+			q = (char *)block + n;
+			oldfree((Heap *)q, block->size - n);
+		}
+	} else {
+		if ((size_t)(regionend - regiontop) < n)
+			return NULL;
+		/* the region is reserved inaccessible, and made usable as it is allocated */
+		if ((size_t)(regionuse - regiontop) < n) {
+			q = regionstep(regiontop + n);
+			if (mprotect(regionuse, q - regionuse, PROT_READ | PROT_WRITE) == -1)
+				return NULL;
+			regionuse = q;
+		}
+		block = (Free *)regiontop;
+		regiontop += n;
+	}
+	memset(block, 0, n);
+	return (Heap *)block;
+}
+
+/* get number of processors the process may run on, or 0 if unknown */
+static int
+ncpus(void)
+{
+#ifdef CPU_COUNT
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof set, &set) == 0)
+		return CPU_COUNT(&set);
+#endif
+#ifdef _SC_NPROCESSORS_ONLN
+	return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * set the maximum sizes of the heap and of its young generation, how
+ * the old generation is marked and by how many threads (by default, one
+ * per processor online), and the function passing the roots outside
+ * the frame stack; return -1 on error
+ */
+int
+heap_init(size_t max, size_t young, int mode, int threads, int compressed, void (*roots)(void))
+{
+	size_t region;
+	void *p;
+	int fd, k, e;
+
+	heapmax = max;
+	youngmax = (young < max / 2 ? young : max / 2) / HEAPALIGN * HEAPALIGN;
+	heapnext = HEAPMIN < max - youngmax ? HEAPMIN : max - youngmax;
+	heaproots = roots;
+	if (compressed) {
+		/* reserve twice the heap, for the blocks lost to fragmentation */
+		if (max > REGIONMAX / 2 - HEAPALIGN) {
+			errno = ENOMEM;
+			return -1;
+		}
+		region = max * 2 + HEAPALIGN;
+		heapshift = (region > (size_t)UINT32_MAX) ? 3 : 0;
+		/* POSIX has no anonymous mappings, map private copy of /dev/zero instead */
+		if ((fd = open("/dev/zero", O_RDWR)) == -1)
+			return -1;
+		p = mmap(NULL, region, PROT_NONE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED)
+			return -1;
+		heapbase = p;
+		nursery = heapbase + HEAPALIGN;
+		regiontop = nursery + youngmax;
+		regionend = heapbase + region;
+		regionuse = regionstep(regiontop);
+		if (mprotect(heapbase, regionuse - heapbase, PROT_READ | PROT_WRITE) == -1)
+			return -1;
+	} else if ((nursery = malloc(youngmax + HEAPALIGN)) == NULL) {
+		return -1;
+	}
+	if ((nurserymap = calloc(youngmax / HEAPALIGN / 8 + 1, 1)) == NULL)
+		return -1;
+	nurserytop = nursery;
+	nurseryend = nursery + youngmax;
+	gcmode = mode;
+	if (mode == GC_SERIAL)
+		return 0;
+	if (threads <= 0)
+		threads = ncpus();
+	if (threads <= 0)
+		threads = 1;
+	if (threads > GCTHREADSMAX)
+		threads = GCTHREADSMAX;
+	if ((markers = calloc(threads, sizeof *markers)) == NULL)
+		return -1;
+	for (k = 0; k < threads; k++) {
+		if ((e = pthread_mutex_init(&markers[k].lock, NULL)) != 0)
+			goto error;
+		if ((e = pthread_create(&markers[k].thread, NULL, markermain, &markers[k])) != 0) {
+			pthread_mutex_destroy(&markers[k].lock);
+			goto error;
+		}
+		nmarkers++;
+	}
+	return 0;
+error:
+	markersdel();
+	errno = e;
+	return -1;
+}
+
+/* allocate entry in heap, in the old generation if old is nonzero or if it is large; return NULL if it does not fit */
+static Heap *
+heapalloc(int32_t nmemb, size_t size, int old)
+{
+	Heap *entry;
+	size_t n;
+
+	if (nmemb < 0 || size > UINT8_MAX)
+		return NULL;
+	if ((size_t)nmemb > (heapmax - heapused) / (size ? size : 1))
 		return NULL;
+	n = (HEAP_HEADER + (size_t)nmemb * size + HEAPALIGN - 1) / HEAPALIGN * HEAPALIGN;
+	if (heapused + n > heapmax)
+		return NULL;
+	if (old || n > youngmax / 8 || youngused + n > youngmax || (entry = nurseryalloc(n)) == NULL) {
+		if ((entry = oldalloc(n)) == NULL)
+			return NULL;
+		heappush(&objects, &nobjects, &objectmax, entry);
+		entry->flags = 0;
+		entry->mark = heapmarking;
+	} else {
+		entry->flags = HEAP_YOUNG;
+		entry->mark = 0;
+		youngused += n;
 	}
 	entry->nmemb = nmemb;
-	entry->count = 0;
-	entry->obj = obj;
-	entry->prev = NULL;
-	entry->next = heap;
-	if (heap)
-		heap->prev = entry;
-	heap = entry;
-	return heap;
+	entry->size = size;
+	entry->class = NULL;
+	heapused += n;
+	return entry;
 }
 
-/* use entry in heap */
-void *
-heap_use(Heap *entry)
+/* allocate entry in heap; return NULL if it does not fit */
+Heap *
+heap_alloc(int32_t nmemb, size_t size)
 {
-	if (entry == NULL)
-		return NULL;
-	entry->count++;
-	return entry->obj;
+	return heapalloc(nmemb, size, 0);
+}
+
+/* allocate entry in the old generation of the heap, for an object living as long as the virtual machine; return NULL if it does not fit */
+Heap *
+heap_allocold(int32_t nmemb, size_t size)
+{
+	return heapalloc(nmemb, size, 1);
 }
 
-/* free entry in heap */
+/* test whether allocating size bytes more should be preceded by a collection, or the remark of a concurrent one */
 int
-heap_free(Heap *entry)
+heap_full(size_t size)
 {
-	if (entry == NULL)
-		return -1;
-	if (entry->count == 1) {
-		if (entry->nmemb) {
-			free(entry->obj);
+	if (size <= youngmax / 8 && youngused + size > youngmax)
+		return 1;
+	if (heapmarking)
+		return markdone || heapused + size > heapmax;
+	return heapused - youngused + size > heapnext;
+}
+
+/* remember old object entry, in which a reference to a young object has been stored */
+void
+heap_remember(Heap *entry)
+{
+	entry->flags |= HEAP_DIRTY;
+	heappush(&remembered, &nremembered, &remembermax, entry);
+}
+
+/* log old, whose reference is about to be overwritten while marking concurrently, if it is an unmarked old object */
+static void
+overwritten(Heap *old)
+{
+	if (old != NULL && !(old->flags & HEAP_YOUNG) && !old->mark)
+		heappush(&satb, &nsatb, &satbmax, old);
+}
+
+/* log the object referred to by element i of array entry, which is about to be overwritten while marking concurrently */
+void
+heap_overwrite(Heap *entry, int32_t i)
+{
+	overwritten(heap_load(entry, i));
+}
+
+/* log the object referred to by the field at offset off of instance entry, which is about to be overwritten while marking concurrently */
+void
+heap_overwritefield(Heap *entry, size_t off)
+{
+	overwritten(heap_getfield(entry, off));
+}
+
+/* promote young object entry into the old generation, if not yet promoted; return its new address */
+static Heap *
+promote(Heap *entry)
+{
+	Heap *old;
+	size_t n;
+
+	/* the class of a moved object, which is dead, holds its new address */
+	if (entry->flags & HEAP_MOVED) {
+		memcpy(&old, &entry->class, sizeof old);
+		return old;
+	}
+	n = heapsize(entry);
+	if ((old = oldalloc(n)) == NULL)
+		errx(EXIT_FAILURE, "out of memory");
+	memcpy(old, entry, n);
+	heappush(&objects, &nobjects, &objectmax, old);
+	youngused -= n;
+	old->flags &= ~HEAP_YOUNG;
+	old->mark = heapmarking;
+	entry->flags |= HEAP_MOVED;
+	memcpy(&entry->class, &old, sizeof old);
+	if (old->flags & HEAP_REFS)
+		heappush(&markstack, &nmark, &markmax, old);
+	return old;
+}
+
+/* mark entry, if it is an object */
+static void
+mark(Heap *entry)
+{
+	if (entry == NULL || entry->mark)
+		return;
+	entry->mark = 1;
+	if (entry->flags & HEAP_REFS)
+		heappush(&markstack, &nmark, &markmax, entry);
+}
+
+/* pass root *p to the collector, which may update it if the object it refers to is moved */
+void
+heap_root(Heap **p)
+{
+	if (!minor)
+		mark(*p);
+	else if (*p != NULL && ((*p)->flags & HEAP_YOUNG))
+		*p = promote(*p);
+}
+
+/* pass the i-th reference held by entry to the collector, as heap_root() passes a root */
+static void
+rootelem(Heap *entry, int32_t i)
+{
+	Heap *elem, *p;
+	size_t off;
+
+	off = heapref(entry, i);
+	p = elem = heap_getfield(entry, off);
+	heap_root(&p);
+	if (p != elem) {
+		heap_putfield(entry, off, p);
+	}
+}
+
+/* scan the references of the objects on the mark stack, and of those they lead to */
+static void
+scan(void)
+{
+	Heap *entry;
+	int32_t i, n;
+
+	while (nmark > 0) {
+		entry = markstack[--nmark];
+		n = heaprefs(entry);
+		for (i = 0; i < n; i++) {
+			rootelem(entry, i);
+		}
+	}
+}
+
+/*
+ * pass the references in the frames on the frame stack to the collector;
+ * the slots of a frame whose code was verified are passed as the type
+ * map of the instruction being run says; other frames are scanned
+ * conservatively, and the young objects they seem to refer to are
+ * pinned, promoted in place, as the slots cannot be updated; a frame's slots
+ * end where the local variables of the frame it called begin, as the
+ * arguments it passed are the callee's to scan; only the frames scanned
+ * conservatively are scanned if conservative is nonzero, and only the
+ * others if it is zero
+ */
+static void
+scanframes(int conservative)
+{
+	Frame *frame;
+	Code_attribute *code;
+	Heap *entry;
+	Value *slot, *end, *limit;
+	U1 *map;
+	size_t i;
+
+	limit = vmstacktop;
+	for (frame = framestack; frame != NULL; frame = frame->next) {
+		code = frame->code;
+		map = NULL;
+		if (code != NULL && code->refmap != NULL && frame->pc <= code->ninstr)
+			map = code->refmap + (size_t)(frame->pc > 0 ? frame->pc - 1 : 0) * REFMAPSIZE(code);
+		end = frame->stack + frame->nstack;
+		if (end > limit)
+			end = limit;
+		limit = frame->local;
+		if ((map == NULL) != (conservative != 0))
+			continue;
+		for (slot = frame->local, i = 0; slot < end; slot++, i++) {
+			if (map != NULL) {
+				if (map[i / 8] & (1 << i % 8)) {
+					heap_root(&slot->v);
+				}
+			} else if (!minor) {
+				mark(heapobject(slot->v));
+			} else if ((entry = nurseryobject(slot->v)) != NULL && (entry->flags & HEAP_YOUNG)) {
+				entry->flags &= ~HEAP_YOUNG;
+				entry->mark = heapmarking;
+				youngused -= heapsize(entry);
+				heappush(&pinned, &npinned, &pinnedmax, entry);
+				if (entry->flags & HEAP_REFS) {
+					heappush(&markstack, &nmark, &markmax, entry);
+				}
+			}
+		}
+	}
+}
+
+/* collect the young generation */
+static void
+collectyoung(void)
+{
+	Heap *entry;
+	int32_t i, n;
+	size_t j;
+
+	minor = 1;
+	/* objects seemingly referred to from frames without type maps must be promoted in place before others are moved */
+	scanframes(1);
+	scanframes(0);
+	if (heaproots != NULL)
+		heaproots();
+	for (j = 0; j < nremembered; j++) {
+		entry = remembered[j];
+		entry->flags &= ~HEAP_DIRTY;
+		n = heaprefs(entry);
+		for (i = 0; i < n; i++) {
+			rootelem(entry, i);
+		}
+	}
+	nremembered = 0;
+	scan();
+	/* the young objects not promoted are dropped with the rest of the nursery */
+	heapused -= youngused;
+	memset(nurserymap, 0, youngmax / HEAPALIGN / 8 + 1);
+	if (npinned > 0)
+		qsort(pinned, npinned, sizeof *pinned, heapcmp);
+	for (j = 0; j < npinned; j++)
+		nurserybit(pinned[j], 1);
+	nurserytop = nursery;
+	pinnext = 0;
+	youngused = 0;
+	minor = 0;
+}
+
+/* free the unmarked objects of the n old objects at list, pinned in the nursery if inplace is nonzero, clear the marks of the others, and compact list; return their number */
+static size_t
+sweep(Heap **list, size_t n, int inplace)
+{
+	Heap *entry;
+	size_t i, j, size;
+
+	for (i = j = 0; i < n; i++) {
+		entry = list[i];
+		if (entry->mark) {
+			entry->mark = 0;
+			list[j++] = entry;
+			continue;
 		}
-		if (entry->next) {
-			entry->next->prev = entry->prev;
+		size = heapsize(entry);
+		heapused -= size;
+		if (inplace)
+			nurserybit(entry, 0);
+		else
+			oldfree(entry, size);
+	}
+	return j;
+}
+
+/* push entry onto the stack of marker m */
+static void
+markerpush(Marker *m, Heap *entry)
+{
+	pthread_mutex_lock(&m->lock);
+	heappush(&m->stack, &m->n, &m->max, entry);
+	pthread_mutex_unlock(&m->lock);
+}
+
+/* pop entry from the stack of marker m, or steal half the stack of another marker; return NULL if there is no work */
+static Heap *
+markerpop(Marker *m)
+{
+	Marker *victim;
+	Heap *entry, **stolen;
+	size_t i, n;
+	int k;
+
+	entry = NULL;
+	pthread_mutex_lock(&m->lock);
+	if (m->n > 0)
+		entry = m->stack[--m->n];
+	pthread_mutex_unlock(&m->lock);
+	for (k = 1; entry == NULL && k < nmarkers; k++) {
+		victim = &markers[(m - markers + k) % nmarkers];
+		stolen = NULL;
+		pthread_mutex_lock(&victim->lock);
+		/* steal from the bottom of the stack, where the objects are older and likely lead to more */
+		if ((n = (victim->n + 1) / 2) > 0 && (stolen = malloc(n * sizeof *stolen)) != NULL) {
+			memcpy(stolen, victim->stack, n * sizeof *stolen);
+			memmove(victim->stack, victim->stack + n, (victim->n - n) * sizeof *stolen);
+			victim->n -= n;
 		}
-		if (entry->prev) {
-			entry->prev->next = entry->next;
-		} else {
-			heap = entry->next;
+		pthread_mutex_unlock(&victim->lock);
+		if (stolen == NULL)
+			continue;
+		entry = stolen[0];
+		for (i = 1; i < n; i++)
+			markerpush(m, stolen[i]);
+		free(stolen);
+	}
+	return entry;
+}
+
+/* test whether the stacks of all markers are empty; gclock must be held, with the markers out of work */
+static int
+markersempty(void)
+{
+	int k;
+
+	for (k = 0; k < nmarkers; k++)
+		if (markers[k].n > 0)
+			return 0;
+	return 1;
+}
+
+/* mark the objects referred to by entry, pushing those holding references onto the stack of marker m */
+static void
+markerscan(Marker *m, Heap *entry)
+{
+	Heap *elem;
+	int32_t i, n;
+
+	n = heaprefs(entry);
+	for (i = 0; i < n; i++) {
+		elem = heap_getfield(entry, heapref(entry, i));
+		if (elem == NULL || (elem->flags & HEAP_YOUNG) || elem->mark)
+			continue;
+		elem->mark = 1;
+		if (elem->flags & HEAP_REFS) {
+			markerpush(m, elem);
 		}
-		free(entry);
+	}
+}
+
+/* mark objects, as marker m, until all markers are out of work or the markers are paused */
+static void
+markerdrain(Marker *m)
+{
+	Heap *entry;
+
+	for (;;) {
+		if ((entry = markerpop(m)) != NULL) {
+			markerscan(m, entry);
+			if (markpause)
+				return;
+			continue;
+		}
+		pthread_mutex_lock(&gclock);
+		for (;;) {
+			if (markdone || markpause) {
+				pthread_mutex_unlock(&gclock);
+				return;
+			}
+			/* a marker is counted out of work only while it waits, not while it steals */
+			if (nidle + 1 == nrunning && markersempty()) {
+				markdone = 1;
+				pthread_cond_broadcast(&gccond);
+				pthread_mutex_unlock(&gclock);
+				return;
+			}
+			nidle++;
+			pthread_mutex_unlock(&gclock);
+			sched_yield();
+			pthread_mutex_lock(&gclock);
+			nidle--;
+			pthread_mutex_unlock(&gclock);
+			if ((entry = markerpop(m)) != NULL)
+				break;
+			pthread_mutex_lock(&gclock);
+		}
+		markerscan(m, entry);
+	}
+}
+
+/* run marker thread */
+static void *
+markermain(void *arg)
+{
+	Marker *m;
+
+	m = arg;
+	pthread_mutex_lock(&gclock);
+	for (;;) {
+		while (!markexit && (!marking || markpause || markdone))
+			pthread_cond_wait(&gccond, &gclock);
+		if (markexit)
+			break;
+		nrunning++;
+		pthread_mutex_unlock(&gclock);
+		markerdrain(m);
+		pthread_mutex_lock(&gclock);
+		nrunning--;
+		pthread_cond_broadcast(&gccond);
+	}
+	pthread_mutex_unlock(&gclock);
+	return NULL;
+}
+
+/* start the markers on the objects on the mark stack */
+static void
+markstart(void)
+{
+	size_t i;
+
+	for (i = 0; i < nmark; i++)
+		markerpush(&markers[i % nmarkers], markstack[i]);
+	nmark = 0;
+	pthread_mutex_lock(&gclock);
+	marking = 1;
+	markdone = 0;
+	markpause = 0;
+	pthread_cond_broadcast(&gccond);
+	pthread_mutex_unlock(&gclock);
+}
+
+/* wait for the markers to run out of work */
+static void
+markwait(void)
+{
+	pthread_mutex_lock(&gclock);
+	while (!markdone)
+		pthread_cond_wait(&gccond, &gclock);
+	marking = 0;
+	while (nrunning > 0)
+		pthread_cond_wait(&gccond, &gclock);
+	pthread_mutex_unlock(&gclock);
+}
+
+/* pause the markers, until markresume() is called */
+static void
+markstop(void)
+{
+	pthread_mutex_lock(&gclock);
+	markpause = 1;
+	while (nrunning > 0)
+		pthread_cond_wait(&gccond, &gclock);
+	pthread_mutex_unlock(&gclock);
+}
+
+/* resume the markers paused by markstop() */
+static void
+markresume(void)
+{
+	pthread_mutex_lock(&gclock);
+	markpause = 0;
+	pthread_cond_broadcast(&gccond);
+	pthread_mutex_unlock(&gclock);
+}
+
+/* merge the adjacent free blocks of the region, giving those at its top back to the bump pointer */
+static void
+regionmerge(void)
+{
+	Heap **blocks;
+	Free *block;
+	size_t n, max, i, k, size;
+
+	blocks = NULL;
+	n = max = 0;
+	for (k = 0; k < NFREE; k++)
+		for (block = freesmall[k]; block != NULL; block = block->next)
+			heappush(&blocks, &n, &max, (Heap *)block);
+	for (block = freelarge; block != NULL; block = block->next)
+		heappush(&blocks, &n, &max, (Heap *)block);
+	memset(freesmall, 0, sizeof freesmall);
+	freelarge = NULL;
+	if (n > 0)
+		qsort(blocks, n, sizeof *blocks, heapcmp);
+	for (i = 0; i < n; i = k) {
+		size = ((Free *)blocks[i])->size;
+		for (k = i + 1; k < n && (char *)blocks[i] + size == (char *)blocks[k]; k++)
+			size += ((Free *)blocks[k])->size;
+		if ((char *)blocks[i] + size == regiontop)
+			regiontop = (char *)blocks[i];
+		else
+			oldfree(blocks[i], size);
+	}
+	free(blocks);
+}
+
+/* sweep the old generation; exit if the heap is still full */
+static void
+sweepall(size_t size)
+{
+	nobjects = sweep(objects, nobjects, 0);
+	npinned = sweep(pinned, npinned, 1);
+	if (heapbase != NULL)
+		regionmerge();
+	/* the space of the pinned objects freed is reused after the next young collection */
+	for (pinnext = 0; pinnext < npinned; pinnext++)
+		if ((char *)pinned[pinnext] >= nurserytop)
+			break;
+	if (heapused + size > heapmax)
+		errx(EXIT_FAILURE, "out of memory");
+	heapnext = (heapused - youngused + size) * 2;
+	if (heapnext < HEAPMIN)
+		heapnext = HEAPMIN;
+	if (heapnext > heapmax - youngmax)
+		heapnext = heapmax - youngmax;
+}
+
+/* mark from the log of overwritten references, wait for the markers, and sweep, ending a concurrent collection */
+static void
+remark(size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < nsatb; i++) {
+		if (!satb[i]->mark) {
+			satb[i]->mark = 1;
+			if (satb[i]->flags & HEAP_REFS) {
+				heappush(&markstack, &nmark, &markmax, satb[i]);
+			}
+		}
+	}
+	nsatb = 0;
+	markstart();
+	markwait();
+	heapmarking = 0;
+	sweepall(size);
+}
+
+/*
+ * collect the young generation, then the whole heap if the old
+ * generation is full; exit if the heap is still full; in the concurrent
+ * mode, the whole heap is collected in the background, and the
+ * collection ends at a later call, once the markers are done
+ */
+void
+heap_collect(size_t size)
+{
+	Heap *entry;
+	int32_t i, n;
+
+	if (heapmarking) {
+		markstop();
+		if (size <= youngmax / 8 && youngused + size > youngmax)
+			collectyoung();
+		if (markdone || heapused + size > heapmax)
+			remark(size);
+		else
+			markresume();
+		return;
+	}
+	collectyoung();
+	if (heapused + size <= heapnext)
+		return;
+	if (nobjects > 0)
+		qsort(objects, nobjects, sizeof *objects, heapcmp);
+	scanframes(1);
+	scanframes(0);
+	if (heaproots != NULL)
+		heaproots();
+	switch (gcmode) {
+	case GC_SERIAL:
+		while (nmark > 0) {
+			entry = markstack[--nmark];
+			n = heaprefs(entry);
+			for (i = 0; i < n; i++) {
+				mark(heap_getfield(entry, heapref(entry, i)));
+			}
+		}
+		break;
+	case GC_PARALLEL:
+		markstart();
+		markwait();
+		break;
+	case GC_CONCURRENT:
+		heapmarking = 1;
+		markstart();
+		if (heapused + size <= heapmax)
+			return;
+		markstop();
+		remark(size);
+		return;
+	}
+	sweepall(size);
+}
+
+/* stop the marker threads and free them */
+static void
+markersdel(void)
+{
+	int m;
+
+	pthread_mutex_lock(&gclock);
+	markexit = 1;
+	pthread_cond_broadcast(&gccond);
+	pthread_mutex_unlock(&gclock);
+	for (m = 0; m < nmarkers; m++) {
+		pthread_join(markers[m].thread, NULL);
+		pthread_mutex_destroy(&markers[m].lock);
+		free(markers[m].stack);
+	}
+	free(markers);
+	markers = NULL;
+	nmarkers = 0;
+	markexit = 0;
+}
+
+/* free all entries in heap */
+void
+heap_del(void)
+{
+	size_t j;
+
+	markersdel();
+	heapmarking = 0;
+	if (heapbase != NULL) {
+		munmap(heapbase, regionend - heapbase);
+		memset(freesmall, 0, sizeof freesmall);
+		freelarge = NULL;
+		heapbase = regiontop = regionuse = regionend = NULL;
 	} else {
-		entry->count--;
+		for (j = 0; j < nobjects; j++)
+			free(objects[j]);
+		free(nursery);
 	}
-	return 0;
+	free(objects);
+	free(nurserymap);
+	free(pinned);
+	free(markstack);
+	free(remembered);
+	free(satb);
+	objects = pinned = markstack = remembered = satb = NULL;
+	nobjects = objectmax = npinned = pinnedmax = pinnext = 0;
+	nmark = markmax = nremembered = remembermax = nsatb = satbmax = 0;
+	nursery = nurserytop = nurseryend = NULL;
+	nurserymap = NULL;
+	heapused = youngused = 0;
 }
 
-/* recursivelly create multidimensional array */
+/* recursivelly create multidimensional array, whose innermost arrays hold references if refs is nonzero */
 Heap *
-array_new(int32_t *nmemb, U1 dimension, size_t size)
+array_new(int32_t *nmemb, U1 dimension, size_t size, int refs)
 {
-	Heap *h;
+	Heap *h, *elem;
 	int32_t i;
 
 	if (dimension == 1) {
-		h = heap_alloc(*nmemb, size);
+		if ((h = heap_alloc(*nmemb, size)) == NULL)
+			return NULL;
+		if (refs)
+			h->flags |= HEAP_REFS;
 	} else {
-		h = heap_alloc(*nmemb, sizeof (Heap *));
+		if ((h = heap_alloc(*nmemb, HEAP_REFSIZE)) == NULL)
+			return NULL;
+		h->flags |= HEAP_REFS;
 		for (i = 0; i < *nmemb; i++) {
-			((void **)h->obj)[i] = array_new(nmemb + 1, dimension - 1, size);
+			if ((elem = array_new(nmemb + 1, dimension - 1, size, refs)) == NULL)
+				return NULL;
+			HEAP_BARRIER(h, i, elem);
+			heap_store(h, i, elem);
 		}
 	}
 	return h;
 }
+
+/* create instance of class, with its fields zeroed */
+Heap *
+object_new(ClassFile *class)
+{
+	Heap *h;
+
+	if ((h = heap_alloc(class->instsize, 1)) == NULL)
+		return NULL;
+	h->class = class;
+	if (class->nrefs > 0)
+		h->flags |= HEAP_REFS;
+	return h;
+}
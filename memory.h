@@ -1,3 +1,44 @@
+/* state of an object for the garbage collector */
+enum {
+	HEAP_REFS       = 0x01,                 /* elements of array, or some fields of instance, are references */
+	HEAP_YOUNG      = 0x02,                 /* object is in the young generation */
+	HEAP_DIRTY      = 0x04,                 /* old object was remembered by the write barrier */
+	HEAP_MOVED      = 0x08,                 /* young object was promoted, class is its new address */
+};
+
+/* how the old generation is marked */
+enum {
+	GC_SERIAL,                              /* by the virtual machine */
+	GC_PARALLEL,                            /* by marker threads, while the virtual machine waits */
+	GC_CONCURRENT,                          /* by marker threads, while the virtual machine runs */
+};
+
+/* size of a reference stored in an array or a field */
+#define HEAP_REFSIZE    (heapbase != NULL ? sizeof (uint32_t) : sizeof (Heap *))
+
+/* write barrier of the store of reference v into element i of array h */
+#define HEAP_BARRIER(h, i, v) \
+	do { \
+		if (heapmarking) \
+			heap_overwrite((h), (i)); \
+		if (!((h)->flags & (HEAP_YOUNG | HEAP_DIRTY)) && (v) != NULL && ((v)->flags & HEAP_YOUNG)) \
+			heap_remember(h); \
+	} while (0)
+
+/* write barrier of the store of reference v into the field at offset off of instance h */
+#define HEAP_FIELDBARRIER(h, off, v) \
+	do { \
+		if (heapmarking) \
+			heap_overwritefield((h), (off)); \
+		if (!((h)->flags & (HEAP_YOUNG | HEAP_DIRTY)) && (v) != NULL && ((v)->flags & HEAP_YOUNG)) \
+			heap_remember(h); \
+	} while (0)
+
+#define GCTHREADSMAX    256     /* maximum marker threads of the parallel and concurrent collectors */
+
+/* size in bytes of the map of the slots holding references at an instruction of code */
+#define REFMAPSIZE(code)        (((size_t)(code)->max_locals + (code)->max_stack + 7) / 8)
+
 /* virtual machine frame structure */
 typedef struct Frame {
 	struct Frame           *next;
@@ -9,16 +50,74 @@ typedef struct Frame {
 	size_t                  nstack;         /* number of values on operand stack */
 	struct Code_attribute  *code;           /* array of instructions */
 	U2                      pc;             /* program counter */
+	union  Value           *base;           /* top of the frame stack before pushing the frame */
 } Frame;
 
-Frame *frame_push(Code_attribute *code, ClassFile *class, U2 max_locals, U2 max_stack);
+int frame_init(size_t size);
+Frame *frame_push(Code_attribute *code, ClassFile *class, Value *args, U2 nargs, U2 max_locals, U2 max_stack);
 int frame_pop(void);
 void frame_del(void);
 void frame_stackpush(Frame *frame, Value value);
 Value frame_stackpop(Frame *frame);
 void frame_localstore(Frame *frame, U2 i, Value v);
 Value frame_localload(Frame *frame, U2 i);
+int heap_init(size_t max, size_t young, int mode, int threads, int compressed, void (*roots)(void));
 Heap *heap_alloc(int32_t nmemb, size_t size);
-void *heap_use(Heap *entry);
-int heap_free(Heap *heap);
-Heap *array_new(int32_t *nmemb, U1 dimension, size_t size);
+Heap *heap_allocold(int32_t nmemb, size_t size);
+int heap_full(size_t size);
+void heap_remember(Heap *entry);
+void heap_overwrite(Heap *entry, int32_t i);
+void heap_overwritefield(Heap *entry, size_t off);
+void heap_root(Heap **p);
+void heap_collect(size_t size);
+void heap_del(void);
+Heap *array_new(int32_t *nmemb, U1 dimension, size_t size, int refs);
+Heap *object_new(struct ClassFile *class);
+
+extern int heapmarking;
+extern char *heapbase;
+extern int heapshift;
+
+/* get reference stored in element i of array h, which is compressed if heapbase is not NULL */
+static inline Heap *
+heap_load(Heap *h, int32_t i)
+{
+	uint32_t r;
+
+	if (heapbase == NULL)
+		return ((Heap **)HEAP_DATA(h))[i];
+	r = ((uint32_t *)HEAP_DATA(h))[i];
+	return (r != 0) ? (Heap *)(heapbase + ((uintptr_t)r << heapshift)) : NULL;
+}
+
+/* store reference v into element i of array h, compressing it if heapbase is not NULL */
+static inline void
+heap_store(Heap *h, int32_t i, Heap *v)
+{
+	if (heapbase == NULL)
+		((Heap **)HEAP_DATA(h))[i] = v;
+	else
+		((uint32_t *)HEAP_DATA(h))[i] = (v != NULL) ? (uint32_t)(((char *)v - heapbase) >> heapshift) : 0;
+}
+
+/* get reference stored in the field at offset off of instance h, which is compressed if heapbase is not NULL */
+static inline Heap *
+heap_getfield(Heap *h, size_t off)
+{
+	uint32_t r;
+
+	if (heapbase == NULL)
+		return *(Heap **)((char *)HEAP_DATA(h) + off);
+	r = *(uint32_t *)((char *)HEAP_DATA(h) + off);
+	return (r != 0) ? (Heap *)(heapbase + ((uintptr_t)r << heapshift)) : NULL;
+}
+
+/* store reference v into the field at offset off of instance h, compressing it if heapbase is not NULL */
+static inline void
+heap_putfield(Heap *h, size_t off, Heap *v)
+{
+	if (heapbase == NULL)
+		*(Heap **)((char *)HEAP_DATA(h) + off) = v;
+	else
+		*(uint32_t *)((char *)HEAP_DATA(h) + off) = (v != NULL) ? (uint32_t)(((char *)v - heapbase) >> heapshift) : 0;
+}
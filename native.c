@@ -1,4 +1,3 @@
-#include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,99 +5,95 @@
 #include "memory.h"
 #include "native.h"
 
-static void
-natprintln(Frame *frame, char *type)
-{
-	Value vfp, v;
-
-	v = frame_stackpop(frame);
-	if (strcmp(type, "()V") == 0) {
-		fprintf((FILE *)v.v->obj, "\n");
-	} else {
-		vfp = frame_stackpop(frame);
-		if (strcmp(type, "(Ljava/lang/String;)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%s\n", (char *)v.v->obj);
-		else if (strcmp(type, "(B)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
-		else if (strcmp(type, "(C)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%c\n", v.i);
-		else if (strcmp(type, "(D)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%.16g\n", v.d);
-		else if (strcmp(type, "(F)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%.16g\n", v.f);
-		else if (strcmp(type, "(I)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
-		else if (strcmp(type, "(J)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%lld\n", (long long int)v.l);
-		else if (strcmp(type, "(S)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
-		else if (strcmp(type, "(Z)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d\n", v.i);
-	}
+#define NATIVEHASH      64      /* size of the hash table of native methods, a power of two */
+
+/* define print function for one argument of one operand stack slot, formatted with fmt */
+#define PRINTFUNC(fn, field, fmt)                       \
+static void                                             \
+fn(Frame *frame)                                        \
+{                                                       \
+	Value vfp, v;                                   \
+	v = frame_stackpop(frame);                      \
+	vfp = frame_stackpop(frame);                    \
+	fprintf((FILE *)*(void **)HEAP_DATA(vfp.v), fmt, field);        \
 }
 
+/* define print function for one long or double argument, formatted with fmt */
+#define PRINTWIDEFUNC(fn, field, fmt)                   \
+static void                                             \
+fn(Frame *frame)                                        \
+{                                                       \
+	Value vfp, v;                                   \
+	v = frame_stackpop(frame);                      \
+	v = frame_stackpop(frame);                      \
+	vfp = frame_stackpop(frame);                    \
+	fprintf((FILE *)*(void **)HEAP_DATA(vfp.v), fmt, field);        \
+}
+
+PRINTFUNC(natprintstring, v.v != NULL ? (char *)HEAP_DATA(v.v) : "null", "%s")
+PRINTFUNC(natprintint, v.i, "%d")
+PRINTFUNC(natprintchar, v.i, "%c")
+PRINTFUNC(natprintfloat, v.f, "%.16g")
+PRINTWIDEFUNC(natprintlong, (long long int)v.l, "%lld")
+PRINTWIDEFUNC(natprintdouble, v.d, "%.16g")
+PRINTFUNC(natprintlnstring, v.v != NULL ? (char *)HEAP_DATA(v.v) : "null", "%s\n")
+PRINTFUNC(natprintlnint, v.i, "%d\n")
+PRINTFUNC(natprintlnchar, v.i, "%c\n")
+PRINTFUNC(natprintlnfloat, v.f, "%.16g\n")
+PRINTWIDEFUNC(natprintlnlong, (long long int)v.l, "%lld\n")
+PRINTWIDEFUNC(natprintlndouble, v.d, "%.16g\n")
+
+/* println()V: print line terminator */
 static void
-natprint(Frame *frame, char *type)
+natprintlnvoid(Frame *frame)
 {
-	Value vfp, v;
-
-	v = frame_stackpop(frame);
-	if (strcmp(type, "()V") != 0) {
-		vfp = frame_stackpop(frame);
-		if (strcmp(type, "(Ljava/lang/String;)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%s", (char *)v.v->obj);
-		else if (strcmp(type, "(B)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d", v.i);
-		else if (strcmp(type, "(C)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%c", v.i);
-		else if (strcmp(type, "(D)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%.16g", v.d);
-		else if (strcmp(type, "(F)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%.16g", v.f);
-		else if (strcmp(type, "(I)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d", v.i);
-		else if (strcmp(type, "(J)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%lld", (long long int)v.l);
-		else if (strcmp(type, "(S)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d", v.i);
-		else if (strcmp(type, "(Z)V") == 0)
-			fprintf((FILE *)vfp.v->obj, "%d", v.i);
-	}
+	Value vfp;
+
+	vfp = frame_stackpop(frame);
+	fprintf((FILE *)*(void **)HEAP_DATA(vfp.v), "\n");
 }
 
+/* charAt(I)C */
 static void
-natstringcharat(Frame *frame, char *type)
+natstringcharat(Frame *frame)
 {
 	Value index, receiver, result;
 	const char *str;
 
 	// TODO(max): UTF-16 index
-	assert(strcmp(type, "(I)C") == 0);
 	index = frame_stackpop(frame);
 	receiver = frame_stackpop(frame);
-	str = (char *)receiver.v->obj;
+	str = (char *)HEAP_DATA(receiver.v);
 	result.i = str[index.i];
 	frame_stackpush(frame, result);
 }
 
+/* length()I */
 static void
-natstringlength(Frame *frame, char *type)
+natstringlength(Frame *frame)
 {
 	Value receiver, result;
 	const char *str;
 
 	// TODO(max): UTF-16
-	assert(strcmp(type, "()I") == 0);
 	receiver = frame_stackpop(frame);
-	str = (char *)receiver.v->obj;
+	str = (char *)HEAP_DATA(receiver.v);
 	result.i = strlen(str);
 	frame_stackpush(frame, result);
 }
 
+/* <init>()V: initialize object, which has nothing to initialize */
+static void
+natobjectinit(Frame *frame)
+{
+	(void)frame_stackpop(frame);
+}
+
 static struct {
 	char *name;
 	JavaClass jclass;
 } jclasstab[] = {
+	{"java/lang/Object",    LANG_OBJECT},
 	{"java/lang/System",    LANG_SYSTEM},
 	{"java/lang/String",    LANG_STRING},
 	{"java/io/PrintStream", IO_PRINTSTREAM},
@@ -106,24 +101,61 @@ static struct {
 };
 
 static struct Native {
+	JavaClass jclass;
 	const char *name;
-	void (*method)(Frame *frame, char *type);
-} *nativetab[] = {
-	[IO_PRINTSTREAM] = (struct Native[]){
-		{"print", natprint},
-		{"println", natprintln},
-		{NULL, NULL},
-	},
-	[LANG_STRING] = (struct Native[]){
-		{"charAt", natstringcharat},
-		{"length", natstringlength},
-		{NULL, NULL},
-	},
-	[LANG_SYSTEM] = (struct Native[]){
-		{NULL, NULL},
-	},
+	const char *descr;
+	NativeMethod *method;
+} nativetab[] = {
+	{IO_PRINTSTREAM, "print",   "(Ljava/lang/String;)V",    natprintstring},
+	{IO_PRINTSTREAM, "print",   "(B)V",                     natprintint},
+	{IO_PRINTSTREAM, "print",   "(C)V",                     natprintchar},
+	{IO_PRINTSTREAM, "print",   "(D)V",                     natprintdouble},
+	{IO_PRINTSTREAM, "print",   "(F)V",                     natprintfloat},
+	{IO_PRINTSTREAM, "print",   "(I)V",                     natprintint},
+	{IO_PRINTSTREAM, "print",   "(J)V",                     natprintlong},
+	{IO_PRINTSTREAM, "print",   "(S)V",                     natprintint},
+	{IO_PRINTSTREAM, "print",   "(Z)V",                     natprintint},
+	{IO_PRINTSTREAM, "println", "()V",                      natprintlnvoid},
+	{IO_PRINTSTREAM, "println", "(Ljava/lang/String;)V",    natprintlnstring},
+	{IO_PRINTSTREAM, "println", "(B)V",                     natprintlnint},
+	{IO_PRINTSTREAM, "println", "(C)V",                     natprintlnchar},
+	{IO_PRINTSTREAM, "println", "(D)V",                     natprintlndouble},
+	{IO_PRINTSTREAM, "println", "(F)V",                     natprintlnfloat},
+	{IO_PRINTSTREAM, "println", "(I)V",                     natprintlnint},
+	{IO_PRINTSTREAM, "println", "(J)V",                     natprintlnlong},
+	{IO_PRINTSTREAM, "println", "(S)V",                     natprintlnint},
+	{IO_PRINTSTREAM, "println", "(Z)V",                     natprintlnint},
+	{LANG_STRING,    "charAt",  "(I)C",                     natstringcharat},
+	{LANG_STRING,    "length",  "()I",                      natstringlength},
+	{LANG_OBJECT,    "<init>",  "()V",                      natobjectinit},
 };
 
+/* hash table of native methods, holding index into nativetab + 1, 0 if empty */
+static unsigned char nativehash[NATIVEHASH];
+static int nativeready = 0;
+
+/* hash class, name and descriptor of native method, mixing the class into class_hash() */
+static uint32_t
+hashnative(JavaClass jclass, const char *name, const char *descr)
+{
+	return (class_hash(name, descr) ^ (uint32_t)jclass) * 16777619u;
+}
+
+/* fill hash table of native methods */
+static void
+nativeinit(void)
+{
+	size_t i, j;
+
+	for (i = 0; i < sizeof nativetab / sizeof *nativetab; i++) {
+		j = hashnative(nativetab[i].jclass, nativetab[i].name, nativetab[i].descr);
+		for (j &= NATIVEHASH - 1; nativehash[j] != 0; j = (j + 1) & (NATIVEHASH - 1))
+			;
+		nativehash[j] = i + 1;
+	}
+	nativeready = 1;
+}
+
 JavaClass
 native_javaclass(char *classname)
 {
@@ -156,16 +188,18 @@ native_javaobj(JavaClass jclass, char *objname, char *objtype)
 	return NULL;
 }
 
-int
-native_javamethod(Frame *frame, JavaClass jclass, char *name, char *type)
+NativeMethod *
+native_getmethod(JavaClass jclass, char *name, char *descr)
 {
-	U8 i;
+	struct Native *native;
+	size_t i;
 
-	for (i = 0; nativetab[jclass][i].name != NULL; i++) {
-		if (strcmp(name, nativetab[jclass][i].name) == 0) {
-			nativetab[jclass][i].method(frame, type);
-			return 0;
-		}
+	if (!nativeready)
+		nativeinit();
+	for (i = hashnative(jclass, name, descr) & (NATIVEHASH - 1); nativehash[i] != 0; i = (i + 1) & (NATIVEHASH - 1)) {
+		native = &nativetab[nativehash[i] - 1];
+		if (native->jclass == jclass && strcmp(name, native->name) == 0 && strcmp(descr, native->descr) == 0)
+			return native->method;
 	}
-	return -1;
+	return NULL;
 }
@@ -3,8 +3,11 @@ typedef enum JavaClass {
 	LANG_SYSTEM    = 0,
 	LANG_STRING    = 1,
 	IO_PRINTSTREAM = 2,
+	LANG_OBJECT    = 3,
 } JavaClass;
 
+typedef void NativeMethod(Frame *frame);
+
 JavaClass native_javaclass(char *classname);
 void *native_javaobj(JavaClass jclass, char *objname, char *objtype);
-int native_javamethod(Frame *frame, JavaClass jclass, char *name, char *type);
+NativeMethod *native_getmethod(JavaClass jclass, char *name, char *descr);
@@ -0,0 +1,46 @@
+class Point {
+	int x;
+	long y;
+	char c;
+	Point next;
+
+	Point(int x, long y, Point next) {
+		this.x = x;
+		this.y = y;
+		this.c = (char)('a' + x);
+		this.next = next;
+	}
+
+	long sum() {
+		return x + y;
+	}
+}
+
+class Point3 extends Point {
+	double z;
+
+	Point3(int x, long y, double z, Point next) {
+		super(x, y, next);
+		this.z = z;
+	}
+
+	long sum() {
+		return super.sum() + (long)z;
+	}
+}
+
+public class Fields {
+	public static void main(String[] args) {
+		Point list = null;
+		for (int i = 0; i < 5; i++) {
+			if (i % 2 == 0)
+				list = new Point(i, 100L * i, list);
+			else
+				list = new Point3(i, 100L * i, 10.5 * i, list);
+		}
+		for (Point p = list; p != null; p = p.next) {
+			System.out.println(p.c);
+			System.out.println(p.sum());
+		}
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * Allocate many short-lived arrays while keeping some of them alive,
+ * in an array of arrays and down a deep recursion, across collections.
+ * Run it with a small heap, so that it collects often, and with each
+ * collector:
+ *
+ *	make tests/Gc.j JAVAFLAGS="-Xmn1k -Xmx2m"
+ *	make tests/Gc.j JAVAFLAGS="-Xmn1k -Xmx2m -Xparallelgc"
+ *	make tests/Gc.j JAVAFLAGS="-Xmn1k -Xmx2m -Xconcurrentgc"
+ *	make tests/Gc.j JAVAFLAGS="-Xmn1k -Xmx2m -Xcompressedrefs"
+ *
+ * It prints 510690000, 5050 and kept.
+ */
+public class Gc {
+	static int[] fill(int n, int k) {
+		int[] a = new int[n];
+
+		for (int i = 0; i < n; i++)
+			a[i] = i * k;
+		return a;
+	}
+
+	static int rec(int d) {
+		if (d == 0) {
+			for (int i = 0; i < 2000; i++)
+				fill(50, i);
+			return 0;
+		}
+		int[] a = fill(2, d);
+		return rec(d - 1) + a[1];
+	}
+
+	public static void main(String[] args) {
+		String s = "kept";
+		int[][] kept = new int[64][1];
+		long sum = 0;
+
+		for (int i = 0; i < 200000; i++) {
+			int[] a = fill(i % 97 + 1, i);
+			if (i % 1000 == 0)
+				kept[i / 1000 % 64] = a;
+		}
+		for (int i = 0; i < kept.length; i++) {
+			int[] a = kept[i];
+			sum += a[a.length - 1];
+		}
+		System.out.println(sum);
+		System.out.println(rec(100));
+		System.out.println(s);
+	}
+}
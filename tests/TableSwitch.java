@@ -15,11 +15,83 @@ public class TableSwitch {
 		return -1;
 	}
 
+	public static int sparse(int n) {
+		switch (n) {
+		case Integer.MIN_VALUE:
+			return 1;
+		case -1000000:
+			return 2;
+		case -7:
+			return 3;
+		case 42:
+			return 4;
+		case 65536:
+			return 5;
+		case Integer.MAX_VALUE:
+			return 6;
+		}
+		return -1;
+	}
+
+	/* javac compiles a switch of two cases to a lookupswitch, even with contiguous keys */
+	public static int pair(int n) {
+		switch (n) {
+		case 0:
+			return 1;
+		case -1:
+			return 2;
+		}
+		return -1;
+	}
+
+	public static int top(int n) {
+		switch (n) {
+		case Integer.MAX_VALUE:
+			return 1;
+		case Integer.MAX_VALUE - 1:
+			return 2;
+		}
+		return -1;
+	}
+
+	public static int ends(int n) {
+		switch (n) {
+		case Integer.MAX_VALUE:
+			return 1;
+		case Integer.MIN_VALUE:
+			return 2;
+		}
+		return -1;
+	}
+
 	public static void main(String[] args) {
 		System.out.println(choose(-1));
 		System.out.println(choose(0));
 		System.out.println(choose(1));
 		System.out.println(choose(2));
 		System.out.println(choose(3));
+		System.out.println(sparse(Integer.MIN_VALUE));
+		System.out.println(sparse(Integer.MIN_VALUE + 1));
+		System.out.println(sparse(-1000000));
+		System.out.println(sparse(-7));
+		System.out.println(sparse(-6));
+		System.out.println(sparse(0));
+		System.out.println(sparse(42));
+		System.out.println(sparse(65536));
+		System.out.println(sparse(Integer.MAX_VALUE - 1));
+		System.out.println(sparse(Integer.MAX_VALUE));
+		System.out.println(pair(-2));
+		System.out.println(pair(-1));
+		System.out.println(pair(0));
+		System.out.println(pair(1));
+		System.out.println(top(Integer.MIN_VALUE));
+		System.out.println(top(Integer.MAX_VALUE - 2));
+		System.out.println(top(Integer.MAX_VALUE - 1));
+		System.out.println(top(Integer.MAX_VALUE));
+		System.out.println(ends(Integer.MIN_VALUE));
+		System.out.println(ends(Integer.MIN_VALUE + 1));
+		System.out.println(ends(0));
+		System.out.println(ends(Integer.MAX_VALUE - 1));
+		System.out.println(ends(Integer.MAX_VALUE));
 	}
 }